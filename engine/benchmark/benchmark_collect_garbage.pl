@@ -0,0 +1,65 @@
+% Copyright (c) 2023 Bank of Italy
+% Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+% Long chain regression benchmark for collect_garbage/2. For each starting height, a replica is initialized at that
+% height and receives a sequence of blocks, each with a full round of messages in the log. The average compaction
+% time per block, as recorded in gc_latest_compaction/3, should not depend on the starting height.
+% Run from the engine directory with:
+%   swipl -g run_benchmark -t halt benchmark/benchmark_collect_garbage.pl
+
+:- consult("../fbft-replica-engine.pl").
+
+benchmark_start_heights([0, 1000, 10000, 100000, 500000]).
+benchmark_blocks(100).
+benchmark_cluster_size(4).
+
+benchmark_block(Replica_id, N) :-
+  benchmark_cluster_size(Cluster_size),
+  Last_sender is Cluster_size-1,
+  format(string(Req_digest), "req_digest_~w", [N]),
+  msg_log_add_request(Replica_id, Req_digest, N),
+  msg_log_add_pre_prepare(Replica_id, 0, N, Req_digest, "block", 0, "sig"),
+  forall(
+    between(1, Last_sender, Sender_id),
+    msg_log_add_prepare(Replica_id, 0, N, Req_digest, Sender_id, "sig")
+  ),
+  forall(
+    between(0, Last_sender, Sender_id),
+    msg_log_add_commit(Replica_id, 0, N, "signature", Sender_id, "sig")
+  ),
+  set_last_rep(Replica_id, N),
+  add_checkpoint(Replica_id, N, Req_digest, N),
+  collect_garbage(N, Replica_id),
+  gc_latest_compaction(Replica_id, N, _).
+
+% Average and maximum compaction time in microseconds, over the configured number of blocks
+benchmark_chain(Start_height, Out_avg_us, Out_max_us) :-
+  Replica_id = 0,
+  benchmark_cluster_size(Cluster_size),
+  benchmark_blocks(Blocks),
+  init(Replica_id, Cluster_size, Start_height, "GENESIS_BLOCK_HASH", Start_height, 0, 60, "benchmark_collect_garbage_db", true),
+  First is Start_height+1,
+  Last is Start_height+Blocks,
+  findall(Duration,
+    (
+      between(First, Last, N),
+      benchmark_block(Replica_id, N),
+      gc_latest_compaction(Replica_id, N, Duration)
+    ),
+    Durations),
+  sum_list(Durations, Sum),
+  max_list(Durations, Max),
+  Out_avg_us is Sum*1000000/Blocks,
+  Out_max_us is Max*1000000.
+
+run_benchmark :-
+  benchmark_start_heights(Start_heights),
+  format("start_height\tavg_compaction_us\tmax_compaction_us~n"),
+  forall(
+    member(Start_height, Start_heights),
+    (
+      benchmark_chain(Start_height, Avg_us, Max_us),
+      format("~w\t~3f\t~3f~n", [Start_height, Avg_us, Max_us])
+    )
+  ),
+  delete_file("benchmark_collect_garbage_db").
@@ -0,0 +1,62 @@
+% Copyright (c) 2023 Bank of Italy
+% Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+% Measures the latency of a view change as the cluster size grows. For each cluster size, every replica has sent a
+% VIEW_CHANGE for view 1 carrying one prepared request. The benchmark times the primary of view 1 building the
+% NEW_VIEW (pre_SEND_NEW_VIEW), and a backup validating it (pre_PROCESS_NEW_VIEW).
+% Run from the engine directory with:
+%   swipl -g run_benchmark -t halt benchmark/benchmark_new_view.pl
+
+:- consult("../fbft-replica-engine.pl").
+
+benchmark_cluster_sizes([4, 7, 10, 16, 31, 64]).
+benchmark_iterations(100).
+
+% Replica_id is moved to view 1, with the VIEW_CHANGE messages of all the replicas in its log
+benchmark_setup_replica(Cluster_size, Replica_id) :-
+  set_view(Replica_id, 1),
+  set_active_view(Replica_id, false),
+  msg_log_add_request(Replica_id, "req_digest_1", 1),
+  P = [[1, "req_digest_1", 0]],
+  Q = [[1, "req_digest_1", "block_1", 0]],
+  Last_sender is Cluster_size-1,
+  forall(
+    between(0, Last_sender, Sender_id),
+    (
+      digest_view_change(1, 0, "GENESIS_BLOCK_HASH", P, Q, Sender_id, Vc_digest),
+      msg_log_add_view_change(Replica_id, Vc_digest, 1, 0, "GENESIS_BLOCK_HASH", P, Q, Sender_id, "sig")
+    )
+  ).
+
+% Average latency in microseconds of Goal, over the configured number of iterations
+benchmark_goal(Goal, Out_latency_us) :-
+  benchmark_iterations(Iterations),
+  statistics(cputime, T0),
+  forall(between(1, Iterations, _), once(Goal)),
+  statistics(cputime, T1),
+  Out_latency_us is (T1-T0)*1000000/Iterations.
+
+benchmark_view_change(Cluster_size, Out_send_us, Out_process_us) :-
+  Primary = 1, Backup = 2,
+  forall(
+    member(Replica_id, [Primary, Backup]),
+    init(Replica_id, Cluster_size, 0, "GENESIS_BLOCK_HASH", 0, 0, 60, "benchmark_new_view_db", true)
+  ),
+  benchmark_setup_replica(Cluster_size, Primary),
+  benchmark_setup_replica(Cluster_size, Backup),
+  once(pre_SEND_NEW_VIEW(Nu, Chi, Primary)),
+  msg_log_add_new_view(Backup, 1, Nu, Chi, "sig"),
+  benchmark_goal(pre_SEND_NEW_VIEW(_, _, Primary), Out_send_us),
+  benchmark_goal(pre_PROCESS_NEW_VIEW(_, Nu, Chi, Backup), Out_process_us).
+
+run_benchmark :-
+  benchmark_cluster_sizes(Cluster_sizes),
+  format("cluster_size\tsend_new_view_us\tprocess_new_view_us~n"),
+  forall(
+    member(Cluster_size, Cluster_sizes),
+    (
+      benchmark_view_change(Cluster_size, Send_us, Process_us),
+      format("~w\t~3f\t~3f~n", [Cluster_size, Send_us, Process_us])
+    )
+  ),
+  delete_file("benchmark_new_view_db").
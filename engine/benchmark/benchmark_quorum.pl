@@ -0,0 +1,59 @@
+% Copyright (c) 2023 Bank of Italy
+% Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+% Measures the latency of the prepared/4 and committed/4 quorum checks as the cluster size and the depth of the
+% message log grow. With the msg_log_prepare_count and msg_log_commit_count counters the latency should stay flat.
+% Run from the engine directory with:
+%   swipl -g run_benchmark -t halt benchmark/benchmark_quorum.pl
+
+:- consult("../fbft-replica-engine.pl").
+
+benchmark_cluster_sizes([4, 7, 10, 16, 31, 64]).
+benchmark_log_depths([1, 10, 100, 1000]).
+benchmark_iterations(10000).
+
+% Fills the message log of replica 0 with Depth committed requests, at view 0
+benchmark_setup(Cluster_size, Depth) :-
+  Replica_id = 0,
+  init(Replica_id, Cluster_size, 0, "GENESIS_BLOCK_HASH", 0, 0, 60, "benchmark_quorum_db", true),
+  Last_sender is Cluster_size-1,
+  forall(
+    between(1, Depth, N),
+    (
+      format(string(Req_digest), "req_digest_~w", [N]),
+      msg_log_add_request(Replica_id, Req_digest, N),
+      msg_log_add_pre_prepare(Replica_id, 0, N, Req_digest, "block", 0, "sig"),
+      forall(
+        between(1, Last_sender, Sender_id),
+        msg_log_add_prepare(Replica_id, 0, N, Req_digest, Sender_id, "sig")
+      ),
+      forall(
+        between(0, Last_sender, Sender_id),
+        msg_log_add_commit(Replica_id, 0, N, "signature", Sender_id, "sig")
+      )
+    )
+  ).
+
+% Average latency in microseconds of Goal, over the configured number of iterations
+benchmark_goal(Goal, Out_latency_us) :-
+  benchmark_iterations(Iterations),
+  statistics(cputime, T0),
+  forall(between(1, Iterations, _), once(Goal)),
+  statistics(cputime, T1),
+  Out_latency_us is (T1-T0)*1000000/Iterations.
+
+run_benchmark :-
+  benchmark_cluster_sizes(Cluster_sizes),
+  benchmark_log_depths(Depths),
+  format("cluster_size\tlog_depth\tprepared_us\tcommitted_us~n"),
+  forall(
+    ( member(Cluster_size, Cluster_sizes), member(Depth, Depths) ),
+    (
+      benchmark_setup(Cluster_size, Depth),
+      format(string(Req_digest), "req_digest_~w", [Depth]),
+      benchmark_goal(prepared(Req_digest, 0, Depth, 0), Prepared_us),
+      benchmark_goal(committed(Req_digest, 0, Depth, 0), Committed_us),
+      format("~w\t~w\t~3f\t~3f~n", [Cluster_size, Depth, Prepared_us, Committed_us])
+    )
+  ),
+  delete_file("benchmark_quorum_db").
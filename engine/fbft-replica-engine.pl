@@ -29,6 +29,9 @@
 % list library, see https://www.swi-prolog.org/pldoc/man?section=lists
 :- use_module(library(lists)).
 
+% aggregate library, see https://www.swi-prolog.org/pldoc/man?section=aggregate
+:- use_module(library(aggregate)).
+
 % sha library
 :- use_module(library(sha)).
 
@@ -38,33 +41,18 @@
 % persistence library
 :- use_module(library(persistency)).
 
-% subsets([1,2,3], X). Generates all the subsets of given set.
-% taken from: https://stackoverflow.com/questions/4912869/subsets-in-prolog
-% WARN: should be used with once() when not backtracking
-%   OR subset from library(lists) should be used instead in that case
-subsets([], []).
-subsets([E|Tail], [E|NTail]):-
-  subsets(Tail, NTail).
-subsets([_|Tail], NTail):-
-  subsets(Tail, NTail).
-
-% This helper function is used to filter out correct Nu that are too small for
-% the evaluation of the correct-chi predicate.
-filter_subsets_by_size(Max_nu, Sub, MinSize) :-
-  subsets(Max_nu, Sub),
-  proper_length(Sub, SubSize),
-  SubSize>=MinSize.
-
 % Assert a fact only once, avoiding duplicates, taken from: https://stackoverflow.com/questions/10437395/prolog-how-to-assert-make-a-database-only-once
 assertz_once(Fact) :- ( Fact, !; assertz(Fact) ).
 
 % Prints all the dynamic predicates, it is useful for debugging
 print_all_dynamics :-
-  nb_getval(request_buffer_len, L),
-  nb_getval(cluster_size, Cluster_size),
-  nb_getval(target_block_time, Target_block_time),
-  nb_getval(genesis_block_timestamp, Genesis_block_timestamp),
-  writef(":- constants.\n \nRequest_buffer_len=%w \nCluster_size=%w \nGenesis_block_timestamp=%w \nTarget_block_time=%w \n\n", [L, Cluster_size, Genesis_block_timestamp, Target_block_time]),
+  % The constants are global variables, each replica engine has its own and the calling engine may have none
+  writef(":- constants.\n \n"),
+  forall(
+    member(Constant, [request_buffer_len, cluster_size, genesis_block_timestamp, target_block_time]),
+    ( nb_current(Constant, Value) -> writef("%w=%w \n", [Constant, Value]) ; true )
+  ),
+  writef("\n"),
   listing(synthetic_time/2),
   listing(view/2),
   listing(active_view/1),
@@ -74,10 +62,14 @@ print_all_dynamics :-
   listing(val/2),
   listing(seqno/2),
   listing(checkpoint/4),
+  listing(gc_low_watermark/2),
+  listing(gc_latest_compaction/3),
   listing(msg_log_request/3),
   listing(msg_log_pre_prepare/7),
   listing(msg_log_prepare/6),
+  listing(msg_log_prepare_count/5),
   listing(msg_log_commit/6),
+  listing(msg_log_commit_count/4),
   listing(msg_log_commit_view_recovery/4),
   listing(msg_log_view_change/9),
   listing(msg_log_new_view/5),
@@ -117,6 +109,12 @@ digest_commit(V, N, Associated_commit_data, Sender_id, Digest) :-
   atom_json_dict(Json_string, Message, [as(string), tag(name)]),
   digest_from_string(Json_string, Digest).
 
+% digest_view_change_hook(V, Hi, C, Pi, Qi, Sender_id, Digest)
+% If asserted, it replaces the json digest of VIEW_CHANGE messages, e.g. with the native digest of the replica.
+:- dynamic digest_view_change_hook/7.
+
+digest_view_change(V, Hi, C, Pi, Qi, Sender_id, Digest) :-
+  digest_view_change_hook(V, Hi, C, Pi, Qi, Sender_id, Digest), !.
 digest_view_change(V, Hi, C, Pi, Qi, Sender_id, Digest) :-
   Message = view_change{view: V, hi: Hi, c: C, pi: Pi, qi: Qi, sender_id: Sender_id},
   atom_json_dict(Json_string, Message, [as(string), tag(name)]),
@@ -204,7 +202,11 @@ add_checkpoint(Replica_id, N, State_val, Last_rep_t) :-
 :- dynamic msg_log_request/3.
 
 msg_log_add_request(Replica_id, Req_digest, Req_timestamp) :-
-  assertz_once(msg_log_request(Replica_id, Req_digest, Req_timestamp)).
+  assertz_once(msg_log_request(Replica_id, Req_digest, Req_timestamp)),
+  forall(
+    msg_log_pre_prepare(Replica_id, V, N, Req_digest, _, _, _),
+    update_view_change_Pi_Qi_for(Replica_id, V, N, Req_digest)
+  ).
 
 % Returns the timestamp of the latest known request. This is used in the Replica code to automatically generate future requests
 get_latest_request_time(Replica_id, Max_t) :-
@@ -216,14 +218,23 @@ get_latest_request_time(Replica_id, Max_t) :-
   Out_t),
   max_list(Out_t, Max_t).
 
+% Returns the earliest timestamp of a logged request that is still in the future.
+% SEND_PRE_PREPARE only considers the requests whose timestamp has been reached, so the Replica
+% code wakes up at this time. Fails if there is no such request.
+get_next_request_time(Replica_id, Next_t) :-
+  get_synthetic_time(Replica_id, Current_time),
+  aggregate_all(min(T), (msg_log_request(Replica_id, _, T), T > Current_time), Next_t).
+
 % msg_log_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data, Sender_id, Sender_sig)
-% Associated_pre_prepare_data: string, contains a value sent by the primary in the PRE_PREPARE message, e.g the proposed block.
+% Associated_pre_prepare_data: string, contains a value sent by the primary in the PRE_PREPARE message, e.g the hash of the proposed block.
+%   The proposed block itself is kept outside the engine, in the block store of the replica.
 :- dynamic msg_log_pre_prepare/7.
 % msg_out_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data), with Sender_id = Replica_id
 :- dynamic msg_out_pre_prepare/5.
 
 msg_log_add_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data, Sender_id, Sender_sig) :-
-  assertz_once(msg_log_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data, Sender_id, Sender_sig)).
+  assertz_once(msg_log_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data, Sender_id, Sender_sig)),
+  update_view_change_Pi_Qi_for(Replica_id, V, N, Req_digest).
 
 msg_out_add_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data) :-
   assertz_once(msg_out_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data)).
@@ -233,8 +244,33 @@ msg_out_add_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_dat
 % msg_log_prepare(Replica_id, V, N, Req_digest), with Sender_id = Replica_id
 :- dynamic msg_out_prepare/4.
 
+% msg_log_prepare_count(Replica_id, V, N, Req_digest, Count)
+% Count: number, the distinct senders of a msg_log_prepare for (V, N, Req_digest). It is updated on insertion and
+% removal of prepare messages, so that prepared/4 checks the quorum with a lookup instead of scanning the log.
+:- dynamic msg_log_prepare_count/5.
+
 msg_log_add_prepare(Replica_id, V, N, Req_digest, Sender_id, Sender_sig) :-
-  assertz_once(msg_log_prepare(Replica_id, V, N, Req_digest, Sender_id, Sender_sig)).
+  (
+    msg_log_prepare(Replica_id, V, N, Req_digest, Sender_id, Sender_sig) -> true;
+    (
+      (
+        msg_log_prepare(Replica_id, V, N, Req_digest, Sender_id, _) -> true;
+        msg_log_prepare_count_incr(Replica_id, V, N, Req_digest)
+      ),
+      assertz(msg_log_prepare(Replica_id, V, N, Req_digest, Sender_id, Sender_sig)),
+      update_view_change_Pi_for(Replica_id, V, N, Req_digest)
+    )
+  ).
+
+msg_log_prepare_count_incr(Replica_id, V, N, Req_digest) :-
+  (
+    retract(msg_log_prepare_count(Replica_id, V, N, Req_digest, Count0)) -> Count is Count0+1;
+    Count = 1
+  ),
+  assertz(msg_log_prepare_count(Replica_id, V, N, Req_digest, Count)).
+
+get_msg_log_prepare_count(Replica_id, V, N, Req_digest, Out_count) :-
+  ( msg_log_prepare_count(Replica_id, V, N, Req_digest, Count) -> Out_count = Count; Out_count = 0 ).
 
 msg_out_add_prepare(Replica_id, V, N, Req_digest) :-
   assertz_once(msg_out_prepare(Replica_id, V, N, Req_digest)).
@@ -244,8 +280,31 @@ msg_out_add_prepare(Replica_id, V, N, Req_digest) :-
 % msg_out_commit(Replica_id, V, N, Associated_commit_data), with Sender_id = Replica_id
 :- dynamic msg_out_commit/4.
 
+% msg_log_commit_count(Replica_id, V, N, Count)
+% Count: number, the distinct senders of a msg_log_commit for (V, N), maintained like msg_log_prepare_count
+:- dynamic msg_log_commit_count/4.
+
 msg_log_add_commit(Replica_id, V, N, Associated_commit_data, Sender_id, Sender_sig) :-
-  assertz_once(msg_log_commit(Replica_id, V, N, Associated_commit_data, Sender_id, Sender_sig)).
+  (
+    msg_log_commit(Replica_id, V, N, Associated_commit_data, Sender_id, Sender_sig) -> true;
+    (
+      (
+        msg_log_commit(Replica_id, V, N, _, Sender_id, _) -> true;
+        msg_log_commit_count_incr(Replica_id, V, N)
+      ),
+      assertz(msg_log_commit(Replica_id, V, N, Associated_commit_data, Sender_id, Sender_sig))
+    )
+  ).
+
+msg_log_commit_count_incr(Replica_id, V, N) :-
+  (
+    retract(msg_log_commit_count(Replica_id, V, N, Count0)) -> Count is Count0+1;
+    Count = 1
+  ),
+  assertz(msg_log_commit_count(Replica_id, V, N, Count)).
+
+get_msg_log_commit_count(Replica_id, V, N, Out_count) :-
+  ( msg_log_commit_count(Replica_id, V, N, Count) -> Out_count = Count; Out_count = 0 ).
 
 msg_out_add_commit(Replica_id, V, N, Associated_commit_data) :-
   assertz_once(msg_out_commit(Replica_id, V, N, Associated_commit_data)).
@@ -296,9 +355,15 @@ msg_log_clear_where_view_less_than(Replica_id, V) :-
   foreach( msg_log_prepare(Replica_id, V1, T3, T4, T5, T6),
     ( V1<V -> retractall(msg_log_prepare(Replica_id, V1, T3, T4, T5, T6)); true)
   ),
+  foreach( msg_log_prepare_count(Replica_id, V1, T3, T4, T5),
+    ( V1<V -> retractall(msg_log_prepare_count(Replica_id, V1, T3, T4, T5)); true)
+  ),
   foreach( msg_log_commit(Replica_id, V1, T3, T4, T5, T6),
     ( V1<V -> retractall(msg_log_commit(Replica_id, V1, T3, T4, T5, T6)); true)
   ),
+  foreach( msg_log_commit_count(Replica_id, V1, T3, T4),
+    ( V1<V -> retractall(msg_log_commit_count(Replica_id, V1, T3, T4)); true)
+  ),
   foreach( msg_log_commit_view_recovery(Replica_id, V1, T3, T4),
     ( V1<V -> retractall(msg_log_commit(Replica_id, V1, T3, T4)); true)
   ),
@@ -313,7 +378,9 @@ msg_log_clear_all(Replica_id) :-
   retractall( msg_log_request(Replica_id,_,_) ),
   retractall( msg_log_pre_prepare(Replica_id, _, _, _, _, _, _) ),
   retractall( msg_log_prepare(Replica_id, _, _, _, _, _) ),
+  retractall( msg_log_prepare_count(Replica_id, _, _, _, _) ),
   retractall( msg_log_commit(Replica_id, _, _, _, _, _) ),
+  retractall( msg_log_commit_count(Replica_id, _, _, _) ),
   retractall( msg_log_commit_view_recovery(Replica_id, _, _, _)),
   retractall( msg_log_view_change(Replica_id, _, _, _, _, _, _, _, _) ),
   retractall( msg_log_new_view(Replica_id, _, _, _, _) ).
@@ -332,8 +399,35 @@ msg_out_clear_all(Replica_id) :-
  */
 
 % view_change_Pi(Replica_id, N, Req_digest, V)
+% Pi is kept up to date while the message log grows, see update_view_change_Pi_for, so that building a VIEW_CHANGE
+% only reads it. It is removed by collect_garbage together with the message log.
 :- dynamic view_change_Pi/4.
 
+% Called when the message log changes for (V, N, Req_digest): if the request is now prepared at view V according to
+% the log, it replaces the entries of Pi for N with a lower view, unless Pi already has one with a higher view
+update_view_change_Pi_for(Replica_id, V, N, Req_digest) :-
+  (
+    \+ view_change_Pi(Replica_id, N, Req_digest, V),
+    prepared_in_log(Req_digest, V, N, Replica_id),
+    \+ ( view_change_Pi(Replica_id, N, _, V2), V2 > V )
+    ->
+    (
+      debug(update_view_change_Pi, "update_view_change_Pi_for: Replica_id = ~w, N = ~w, M = ~w, V = ~w", [Replica_id, N, Req_digest, V]),
+      forall(
+        ( view_change_Pi(Replica_id, N, M1, V1), V1 < V ),
+        retract(view_change_Pi(Replica_id, N, M1, V1))
+      ),
+      assertz(view_change_Pi(Replica_id, N, Req_digest, V))
+    );
+    true
+  ).
+
+update_view_change_Pi_Qi_for(Replica_id, V, N, Req_digest) :-
+  update_view_change_Qi_for(Replica_id, V, N, Req_digest),
+  update_view_change_Pi_for(Replica_id, V, N, Req_digest).
+
+% Rebuilds Pi from the message log only. It is not used by the actions, but it is the reference against which the
+% incremental maintenance is checked.
 update_view_change_Pi(Replica_id) :-
   debug(update_view_change_Pi, "update_view_change_Pi: Retractall for Replica_id = ~w", [Replica_id]),
   retractall(view_change_Pi(Replica_id, _, _, _)),
@@ -354,8 +448,31 @@ update_view_change_Pi(Replica_id) :-
  */
 
 % view_change_Qi(Replica_id, N, Req_digest, Associated_pre_prepare_data, V)
+% Qi is kept up to date like Pi, see update_view_change_Qi_for
 :- dynamic view_change_Qi/5.
 
+% Called when the message log changes for (V, N, Req_digest): if the request is now pre-prepared at view V according
+% to the log, it replaces the entries of Qi for (N, Req_digest) with a lower view, unless Qi already has one with a
+% higher view
+update_view_change_Qi_for(Replica_id, V, N, Req_digest) :-
+  forall(
+    (
+      pre_prepared_in_log(Req_digest, V, N, Replica_id),
+      primary(V, P),
+      msg_log_pre_prepare(Replica_id, V, N, Req_digest, Associated_pre_prepare_data, P, _),
+      \+ view_change_Qi(Replica_id, N, Req_digest, Associated_pre_prepare_data, V),
+      \+ ( view_change_Qi(Replica_id, N, Req_digest, _, V2), V2 > V )
+    ),
+    (
+      forall(
+        ( view_change_Qi(Replica_id, N, Req_digest, B1, V1), V1 < V ),
+        retract(view_change_Qi(Replica_id, N, Req_digest, B1, V1))
+      ),
+      assertz(view_change_Qi(Replica_id, N, Req_digest, Associated_pre_prepare_data, V))
+    )
+  ).
+
+% Rebuilds Qi from the message log only, as update_view_change_Pi does for Pi
 update_view_change_Qi(Replica_id) :-
   retractall(view_change_Qi(Replica_id, _, _, _, _)),
   foreach(
@@ -474,26 +591,35 @@ in_wv(V, N, Replica_id) :-
   V #= View_i.
 
 % 5
+% Qi already holds the latest pre-prepared requests in the log, the second branch
+% only yields the ones not in Qi, so that each request is returned once
 pre_prepared(Req_digest, V, N, Replica_id) :-
   view_change_Qi(Replica_id, N, Req_digest, _, V);
+  pre_prepared_in_log(Req_digest, V, N, Replica_id),
+  \+ view_change_Qi(Replica_id, N, Req_digest, _, V).
+
+pre_prepared_in_log(Req_digest, V, N, Replica_id) :-
   primary(V, Primary_id),
   msg_log_request(Replica_id, Req_digest, _),
   msg_log_pre_prepare(Replica_id, V, N, Req_digest, _, Primary_id, _).
 
 % 6
+% As for pre_prepared, the second branch only yields the requests not in Pi
 prepared(Req_digest, V, N, Replica_id) :-
   view_change_Pi(Replica_id, N, Req_digest, V);
+  prepared_in_log(Req_digest, V, N, Replica_id),
+  \+ view_change_Pi(Replica_id, N, Req_digest, V).
+
+prepared_in_log(Req_digest, V, N, Replica_id) :-
   quorum_prepare(Quorum),
   pre_prepared(Req_digest, V, N, Replica_id),
-  findall(K, msg_log_prepare(Replica_id, V, N, Req_digest, K, _), Prepare_msgs),
-  proper_length(Prepare_msgs, Num_prepare_msgs), Num_prepare_msgs>=Quorum.
+  get_msg_log_prepare_count(Replica_id, V, N, Req_digest, Num_prepare_msgs), Num_prepare_msgs>=Quorum.
 
 % 7
 committed(Req_digest, V, N, Replica_id) :-
   prepared(Req_digest, V, N, Replica_id),
   quorum(Quorum),
-  findall(K, msg_log_commit(Replica_id, V, N, _, K, _), Commit_msgs),
-  proper_length(Commit_msgs, Num_commit_msgs), Num_commit_msgs>=Quorum.
+  get_msg_log_commit_count(Replica_id, V, N, Num_commit_msgs), Num_commit_msgs>=Quorum.
 
 % 8
 correct_view_change(M_v, M_h, M_P, M_Q) :-
@@ -508,15 +634,7 @@ correct_view_change(M_v, M_h, M_P, M_Q) :-
 % 10 - Correct Nu
 correct_nu_element(J, D, Replica_id) :-
   view(Replica_id, View_i),
-  primary(View_i, Primary_i),
-  msg_log_view_change(Replica_id, D, V, _, _, _, _, J, _),
-  once(
-  (
-    V #= View_i,
-    Replica_id #\= Primary_i
-  );
-  true
-  ).
+  msg_log_view_change(Replica_id, D, View_i, _, _, _, _, J, _).
 
 % This function returns the largest Nu set present in the message_log
 correct_nu_once(Nu, Replica_id) :-
@@ -526,12 +644,17 @@ correct_nu_once(Nu, Replica_id) :-
   NuSize>=Quorum,
   sort(UnsortedNu, Nu).
 
-% This function returns all the possible Nu sets that can be present in the message_log
-correct_nu_all(Nu, Replica_id) :-
+% This function checks a Nu set received in a NEW_VIEW directly, rather than enumerating the subsets of the
+% view change messages in the log: Nu must be a sorted set of view change messages from at least a quorum of
+% distinct senders, each one present in the message log for the current view
+correct_nu(Nu, Replica_id) :-
+  is_list(Nu),
   quorum(Quorum),
-  findall([J,D], correct_nu_element(J,D,Replica_id), Max_nu),
-  filter_subsets_by_size(Max_nu, UnsortedNu, Quorum),
-  sort(UnsortedNu, Nu).
+  sort(Nu, Sorted_nu), Sorted_nu == Nu,
+  proper_length(Nu, NuSize), NuSize>=Quorum,
+  findall(J, member([J,_], Nu), Senders),
+  sort(Senders, Distinct_senders), proper_length(Distinct_senders, NuSize),
+  forall(member(Element, Nu), (Element = [J,D], correct_nu_element(J, D, Replica_id))).
 
 nu_vset_i(Nu, Replica_id, V, Hi, C, Pi, Qi, Sender_id) :-
   findall(D, member([_,D], Nu), Vc_digests),
@@ -608,8 +731,10 @@ correct_chi(Chi, Nu, Replica_id) :-
 correct_new_view(Chi, Nu, Replica_id) :-
   view(Replica_id, View_i),
   msg_log_new_view(Replica_id, View_i, Nu, Chi, _),
-  correct_nu_all(Nu, Replica_id),
-  correct_chi(Chi, Nu, Replica_id).
+  correct_nu(Nu, Replica_id),
+  % Chi is computed once from Nu and unified with the one sent by the primary,
+  % the pre-prepare data of a "null" entry is left unbound by correct_chi
+  once(correct_chi(Chi, Nu, Replica_id)).
 
 /*
  * Actions
@@ -638,6 +763,9 @@ init_notx(Replica_id, Cluster_size,
   % Checkpoints
   retractall( checkpoint(Replica_id,_,_,_) ),
   assertz_once( checkpoint(Replica_id, Initial_block_height, Initial_block_hash, Initial_block_timestamp) ),
+  % Garbage collection
+  set_gc_low_watermark(Replica_id, Initial_block_height),
+  retractall( gc_latest_compaction(Replica_id, _, _) ),
   % Message Log
   msg_log_clear_all(Replica_id),
   % Message Out buffer
@@ -683,6 +811,12 @@ init(Replica_id, Cluster_size,
     Initial_block_height, Initial_block_hash, Initial_block_timestamp,
     Genesis_block_timestamp, Target_block_time, Db_filename, Db_reset) ).
 
+% Sets the size of the watermark window, i.e. how many heights above the latest checkpoint can be agreed on
+% at the same time. After init, a single height is in flight at a time.
+set_request_buffer_len(Request_buffer_len) :-
+  Request_buffer_len >= 1,
+  nb_setval(request_buffer_len, Request_buffer_len).
+
 % 1. RECEIVE-REQUEST
 
 apply_RECEIVE_REQUEST(Req_digest, Req_timestamp, Replica_id) :-
@@ -883,33 +1017,53 @@ effect_EXECUTE(Req_digest, N, State_val, Replica_id) :-
 
 % 11. COLLECT GARBAGE
 
+% gc_low_watermark(Replica_id, N)
+% N: number, the height up to which the message log has been compacted. Messages with a lower sequence number are
+% rejected by in_w, so each compaction only needs to visit the heights between the previous and the new watermark.
+:- dynamic gc_low_watermark/2.
+
+% gc_latest_compaction(Replica_id, N, Duration)
+% Duration: number, the wall clock seconds spent by the latest collect_garbage, run at height N
+:- dynamic gc_latest_compaction/3.
+
+set_gc_low_watermark(Replica_id, N) :-
+  retractall(gc_low_watermark(Replica_id, _)),
+  assertz(gc_low_watermark(Replica_id, N)).
+
+get_gc_low_watermark(Replica_id, Out_n) :-
+  ( gc_low_watermark(Replica_id, N) -> Out_n = N; Out_n = 0 ).
+
+set_gc_latest_compaction(Replica_id, N, Duration) :-
+  retractall(gc_latest_compaction(Replica_id, _, _)),
+  assertz(gc_latest_compaction(Replica_id, N, Duration)).
+
 collect_garbage(N, Replica_id) :-
+  get_time(T0),
   get_last_rep(Replica_id, Last_rep_t),
-  debug(collect_garbage, "collect_garbage: N=~w Replica_id=~w Last_rep_t=~w", [N, Replica_id, Last_rep_t]),
-  foreach(
-    (
-      N1 #>= 0, N1 #< N,
-      indomain(N1)
-    ),
+  get_gc_low_watermark(Replica_id, Low_watermark),
+  debug(collect_garbage, "collect_garbage: N=~w Replica_id=~w Last_rep_t=~w Low_watermark=~w", [N, Replica_id, Last_rep_t, Low_watermark]),
+  forall(
+    between(Low_watermark, N, N1),
     (
       debug(collect_garbage, "collect_garbage: N1=~w", [N1]),
-      retractall(checkpoint(Replica_id,N1,_,_)),
+      ( N1 < N -> retractall(checkpoint(Replica_id,N1,_,_)); true ),
       retractall(msg_log_pre_prepare(Replica_id,_,N1,_,_,_,_)),
       retractall(msg_log_prepare(Replica_id,_,N1,_,_,_)),
+      retractall(msg_log_prepare_count(Replica_id,_,N1,_,_)),
       retractall(msg_log_commit(Replica_id,_,N1,_,_,_)),
-      retractall(view_change_Pi(Replica_id,N1,_,_,_)),
-      retractall(view_change_Qi(Replica_id,N1,_,_,_,_))
+      retractall(msg_log_commit_count(Replica_id,_,N1,_)),
+      retractall(view_change_Pi(Replica_id,N1,_,_)),
+      retractall(view_change_Qi(Replica_id,N1,_,_,_))
     )
   ),
-  retractall(msg_log_pre_prepare(Replica_id,_,N,_,_,_,_)),
-  retractall(msg_log_prepare(Replica_id,_,N,_,_,_)),
-  retractall(msg_log_commit(Replica_id,_,N,_,_,_)),
-  retractall(view_change_Pi(Replica_id,N,_,_)),
-  retractall(view_change_Qi(Replica_id,N,_,_,_)),
+  ( N > Low_watermark -> set_gc_low_watermark(Replica_id, N); true ),
   foreach( msg_log_request(Replica_id, T2, T),
     ( (T =< Last_rep_t) -> retractall(msg_log_request(Replica_id, T2, T)); true)
   ),
-  roast_collect_garbage(Replica_id).
+  roast_collect_garbage(Replica_id),
+  get_time(T1),
+  Duration is T1-T0,
+  set_gc_latest_compaction(Replica_id, N, Duration).
 
 % 12. SEND VIEW-CHANGE
 
@@ -933,17 +1087,23 @@ pre_SEND_VIEW_CHANGE(V, Replica_id) :-
   debug(pre_SEND_VIEW_CHANGE, "pre_SEND_VIEW_CHANGE: Replica_id=~w, Timeout=~w, V=~w, Req_t=~w, Cur_t=~w", [Replica_id, Timeout, V, Req_timestamp, Current_timestamp]),
   Current_timestamp - Req_timestamp > Timeout.
 
+% Returns the time after which pre_SEND_VIEW_CHANGE holds, i.e. the timeout of the earliest request
+% still waiting for its reply. Fails if no request is waiting.
+get_view_change_deadline(Replica_id, Deadline) :-
+  timeout(Replica_id, Timeout),
+  get_last_rep(Replica_id, Last_rep_t),
+  aggregate_all(min(T), (msg_log_request(Replica_id, _, T), Last_rep_t < T), Req_timestamp),
+  Deadline is Req_timestamp + Timeout.
+
 apply_SEND_VIEW_CHANGE(V, Replica_id) :-
   debug(apply_SEND_VIEW_CHANGE, "apply_SEND_VIEW_CHANGE: V=~w Replica_id=~w", [V, Replica_id]),
   set_view(Replica_id, V),
   set_active_view(Replica_id, false),
   set_roast_active(Replica_id, false, false, false),
-  % Build Pi
-  update_view_change_Pi(Replica_id),
+  % Build Pi, it is maintained while the message log grows
   findall([N1,Req_digest1,V1], view_change_Pi(Replica_id, N1, Req_digest1, V1), Pi),
   debug(apply_SEND_VIEW_CHANGE, "apply_SEND_VIEW_CHANGE: Pi=~w", [Pi]),
-  % Build Qi
-  update_view_change_Qi(Replica_id),
+  % Build Qi, it is maintained while the message log grows
   findall([N2,Req_digest2, Associated_pre_prepare_data2, V2], view_change_Qi(Replica_id, N2, Req_digest2, Associated_pre_prepare_data2, V2), Qi),
   debug(apply_SEND_VIEW_CHANGE, "apply_SEND_VIEW_CHANGE: Qi=~w", [Qi]),
   % Build Hi
@@ -1053,8 +1213,12 @@ apply_PROCESS_NEW_VIEW(Hi, Chi, Replica_id) :-
   primary(V, Primary),
   set_active_view(Replica_id, true),
   view(Replica_id, V),
+  % Entries at or below the low watermark are already checkpointed here, and collect_garbage
+  % only sweeps above its previous run, so they would never be collected
+  get_h(Replica_id, H_i),
+  findall([N,D,B], (member([N,D,B], Chi), N > H_i), Chi_above_h),
   % Populate pre-prepare message log. Assuming the sender is the current primary.
-  foreach((member([N,D,B], Chi)), msg_log_add_pre_prepare(Replica_id, V, N, D, B, Primary, "SIG_IN_NEW_VIEW")),
+  foreach((member([N,D,B], Chi_above_h)), msg_log_add_pre_prepare(Replica_id, V, N, D, B, Primary, "SIG_IN_NEW_VIEW")),
   % set sequence number to the maximum
   findall(SeqNumber, msg_log_pre_prepare(Replica_id, V, SeqNumber, _, _, _, _), SeqNumbers),
   ( \+ length(SeqNumbers, 0) ->
@@ -1068,9 +1232,9 @@ apply_PROCESS_NEW_VIEW(Hi, Chi, Replica_id) :-
   (Primary \== Replica_id ->
     % sender id not known at this point
     (
-        foreach((member([N,D,_], Chi)),
+        foreach((member([N,D,_], Chi_above_h)),
             msg_log_add_prepare(Replica_id, V, N, D, Replica_id, "SIG_OWN_REPLICA")),
-        foreach((member([N,D,_], Chi)),
+        foreach((member([N,D,_], Chi_above_h)),
             msg_out_add_prepare(Replica_id, V, N, D))
     );
     true).
@@ -0,0 +1,80 @@
+% Copyright (c) 2023 Bank of Italy
+% Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+:- consult("test_00_utils.pl").
+
+:- begin_tests(test_action_11_collect_garbage).
+
+setup_test() :-
+  init_all.
+
+build_config(Config) :-
+  Config = _{
+    view0: 0,
+    req_timestamp: 34,
+    associated_data: "block",
+    signature: "sig"
+  }.
+
+add_messages_at(Replica_id, V, N, Config) :-
+  format(string(Req_digest), "req_digest_~w", [N]),
+  msg_log_add_pre_prepare(Replica_id, V, N, Req_digest, Config.associated_data, 0, Config.signature),
+  forall(
+    between(1,3,SenderId),
+    msg_log_add_prepare(Replica_id, V, N, Req_digest, SenderId, Config.signature)
+  ),
+  forall(
+    between(0,3,SenderId),
+    msg_log_add_commit(Replica_id, V, N, Config.associated_data, SenderId, Config.signature)
+  ).
+
+% the low watermark starts at the initial block height, and follows the compacted height
+test(test_action_11_collect_garbage_00, [setup((setup_test(), build_config(Config)))]) :-
+  TestReplicaId = 0,
+  V = Config.view0,
+  get_gc_low_watermark(TestReplicaId, Initial_watermark),
+  assertion( Initial_watermark == 0 ),
+  forall( between(1,3,N), add_messages_at(TestReplicaId, V, N, Config) ),
+  add_checkpoint(TestReplicaId, 2, "block_hash_2", Config.req_timestamp),
+  collect_garbage(2, TestReplicaId),
+  get_gc_low_watermark(TestReplicaId, Watermark),
+  assertion( Watermark == 2 ),
+  % messages up to the compacted height are removed, with their quorum counters
+  assertion( \+ msg_log_pre_prepare(TestReplicaId, _, 1, _, _, _, _) ),
+  assertion( \+ msg_log_prepare(TestReplicaId, _, 2, _, _, _) ),
+  assertion( \+ msg_log_commit_count(TestReplicaId, _, 2, _) ),
+  % the following ones are kept
+  assertion( msg_log_pre_prepare(TestReplicaId, V, 3, _, _, _, _) ),
+  get_msg_log_commit_count(TestReplicaId, V, 3, Count),
+  assertion( Count == 4 ),
+  % only the latest checkpoint is kept
+  findall(N, checkpoint(TestReplicaId, N, _, _), Checkpoints),
+  assertion( Checkpoints == [2] ),
+  % the compaction time is recorded
+  gc_latest_compaction(TestReplicaId, 2, Duration),
+  assertion( Duration >= 0 ),
+  !.
+
+% a replica initialized far in the chain starts compacting from its initial height
+test(test_action_11_collect_garbage_01, [setup(build_config(Config))]) :-
+  TestReplicaId = 0,
+  V = Config.view0,
+  Initial_block_height = 500000,
+  init(TestReplicaId, 4, Initial_block_height, "GENESIS_BLOCK_HASH", 0, 0, 60, "file", true),
+  get_gc_low_watermark(TestReplicaId, Initial_watermark),
+  assertion( Initial_watermark == Initial_block_height ),
+  N is Initial_block_height+1,
+  add_messages_at(TestReplicaId, V, N, Config),
+  add_checkpoint(TestReplicaId, N, "block_hash", Config.req_timestamp),
+  collect_garbage(N, TestReplicaId),
+  get_gc_low_watermark(TestReplicaId, Watermark),
+  assertion( Watermark == N ),
+  assertion( \+ msg_log_commit(TestReplicaId, _, N, _, _, _) ),
+  findall(H, checkpoint(TestReplicaId, H, _, _), Checkpoints),
+  assertion( Checkpoints == [N] ),
+  !.
+
+% Command to debug
+% guitracer, trace.
+
+:- end_tests(test_action_11_collect_garbage).
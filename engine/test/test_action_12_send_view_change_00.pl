@@ -180,4 +180,67 @@ test(test_send_view_change_00_08, [setup((setup(),build_config(Config)))]) :-
   assertion( \+ msg_log_pre_prepare(2, V, N, Config.req_digest_1, Config.proposed_block_1, 0, Config.sender_signature.0)),
   !.
 
+% Pi and Qi are maintained while the message log grows, and match the ones rebuilt from the log
+test(test_send_view_change_00_09, [setup((setup(),build_config(Config)))]) :-
+  V = Config.view0, N = Config.seqno1,
+  receive_req_all(Config.req_digest_1, Config.timestamp),
+  pre_prepare_all(Config.req_digest_1, Config.proposed_block_1, V, N),
+  V2 = Config.view4,
+  forall(
+    between(0,3,Replica_id),
+    set_view(Replica_id, V2)
+  ),
+  receive_req_all(Config.req_digest_2, Config.timestamp),
+  apply_RECEIVE_PRE_PREPARE(V2, N, Config.req_digest_2, Config.proposed_block_2, 0, Config.sender_signature.0, 2),
+  apply_SEND_PREPARE(Config.req_digest_2, V2, N, 2),
+  apply_RECEIVE_PREPARE(V2, N, Config.req_digest_2, 1, Config.sender_signature.1, 2),
+  apply_RECEIVE_PREPARE(V2, N, Config.req_digest_2, 3, Config.sender_signature.3, 2),
+  findall([N1,M1,V1], view_change_Pi(2, N1, M1, V1), Pi),
+  findall([N1,M1,B1,V1], view_change_Qi(2, N1, M1, B1, V1), Qi),
+  assertion( Pi == [[N,Config.req_digest_2,V2]]),
+  assertion( Qi == [[N,Config.req_digest_1,Config.proposed_block_1, V], [N,Config.req_digest_2,Config.proposed_block_2, V2]] ),
+  update_view_change_Pi(2),
+  update_view_change_Qi(2),
+  findall([N1,M1,V1], view_change_Pi(2, N1, M1, V1), Rebuilt_Pi),
+  findall([N1,M1,B1,V1], view_change_Qi(2, N1, M1, B1, V1), Rebuilt_Qi),
+  assertion( Rebuilt_Pi == Pi ),
+  assertion( Rebuilt_Qi == Qi ),
+  !.
+
+% Pi and Qi survive the removal of the lower views from the message log, so a second view change still carries them
+test(test_send_view_change_00_10, [setup((setup(),build_config(Config)))]) :-
+  V = Config.view0, N = Config.seqno1,
+  receive_req_all(Config.req_digest_1, Config.timestamp),
+  apply_RECEIVE_PRE_PREPARE(V, N, Config.req_digest_1, Config.proposed_block_1, 0, Config.sender_signature.0, 2),
+  apply_SEND_PREPARE(Config.req_digest_1, V, N, 2),
+  apply_RECEIVE_PREPARE(V, N, Config.req_digest_1, 1, Config.sender_signature.1, 2),
+  apply_RECEIVE_PREPARE(V, N, Config.req_digest_1, 3, Config.sender_signature.3, 2),
+  apply_SEND_VIEW_CHANGE(Config.view1, 2),
+  apply_SEND_VIEW_CHANGE(Config.view4, 2),
+  ExpectedPi = [[1, Config.req_digest_1, Config.view0]],
+  ExpectedQi = [[1, Config.req_digest_1, Config.proposed_block_1, Config.view0]],
+  assertion( msg_out_view_change(2, Config.view4, 0, "GENESIS_BLOCK_HASH", ExpectedPi, ExpectedQi) ),
+  !.
+
+% The deadlines computed for the Replica code match the time based preconditions
+test(test_send_view_change_00_11, [setup((setup(),build_config(Config)))]) :-
+  Replica_id = 2,
+  receive_req_all(Config.req_digest_1, Config.timestamp),
+  set_synthetic_time(Replica_id, 20),
+  get_next_request_time(Replica_id, Next_t),
+  assertion( Next_t == Config.timestamp ),
+  % The timeout of view 0 is half the target block time
+  get_view_change_deadline(Replica_id, Deadline),
+  assertion( Deadline =:= Config.timestamp + 30 ),
+  Before is Deadline - 1, After is Deadline + 1,
+  set_synthetic_time(Replica_id, Before),
+  assertion( \+ pre_SEND_VIEW_CHANGE(Config.view1, Replica_id) ),
+  set_synthetic_time(Replica_id, After),
+  assertion( pre_SEND_VIEW_CHANGE(Config.view1, Replica_id) ),
+  assertion( \+ get_next_request_time(Replica_id, _) ),
+  % Once the request has been replied, no view change is due
+  set_last_rep(Replica_id, Config.timestamp),
+  assertion( \+ get_view_change_deadline(Replica_id, _) ),
+  !.
+
 :- end_tests(test_action_12_send_view_change_00).
@@ -62,4 +62,16 @@ test(test_pre_process_new_view, [ setup(setup_test(TestReplicaId, Nu, Chi, H)) ]
   % assert that request_1 is present in prepare log
   assertion(msg_log_prepare(TestReplicaId, V, 1, "request_1_digest", TestReplicaId, _)).*/
 
+% test that the Chi entries already checkpointed are not logged again, collect_garbage would not remove them
+test(test_apply_process_new_view_below_h, [ setup(setup_test(TestReplicaId, _Nu, _Chi, _H)) ]) :-
+  add_checkpoint(TestReplicaId, 1, "block_hash_1", 1),
+  collect_garbage(1, TestReplicaId),
+  Chi = [[1, "request_1_digest", "BLOCK_1"], [2, "null", "null"]],
+  apply_PROCESS_NEW_VIEW(1, Chi, TestReplicaId),
+  !,
+  view(TestReplicaId, V),
+  assertion(\+ msg_log_pre_prepare(TestReplicaId, V, 1, _, _, _, _)),
+  assertion(\+ msg_log_prepare(TestReplicaId, V, 1, _, _, _)),
+  assertion(msg_log_pre_prepare(TestReplicaId, V, 2, "null", _, _, _)).
+
 :- end_tests(test_action_20_process_new_view).
@@ -50,6 +50,42 @@ test(test_aux_06_prepared_01, [setup((setup_test(), build_config(Config)))]) :-
   assertion( \+ prepared(Config.req_digest, V, N, TestReplicaId) ),
   !.
 
+% the same sender is counted once, even if it sends the prepare with different signatures
+test(test_aux_06_prepared_02, [setup((setup_test(), build_config(Config)))]) :-
+  V = Config.view0,
+  N = Config.seqno1,
+  TestReplicaId = 0,
+  msg_log_add_request(TestReplicaId, Config.req_digest, Config.req_timestamp),
+  msg_log_add_pre_prepare(TestReplicaId, V, N, Config.req_digest, Config.associated_data, TestReplicaId, Config.signatures.TestReplicaId),
+  forall(
+    between(1,3,SenderId),
+    msg_log_add_prepare(TestReplicaId, V, N, Config.req_digest, 1, Config.signatures.SenderId)
+  ),
+  get_msg_log_prepare_count(TestReplicaId, V, N, Config.req_digest, Count),
+  assertion( Count == 1 ),
+  assertion( \+ prepared(Config.req_digest, V, N, TestReplicaId) ),
+  !.
+
+% the prepare counter follows the message log when older views are cleared
+test(test_aux_06_prepared_03, [setup((setup_test(), build_config(Config)))]) :-
+  V = Config.view0,
+  N = Config.seqno1,
+  TestReplicaId = 0,
+  msg_log_add_request(TestReplicaId, Config.req_digest, Config.req_timestamp),
+  msg_log_add_pre_prepare(TestReplicaId, V, N, Config.req_digest, Config.associated_data, TestReplicaId, Config.signatures.TestReplicaId),
+  forall(
+    between(1,3,SenderId),
+    msg_log_add_prepare(TestReplicaId, V, N, Config.req_digest, SenderId, Config.signatures.SenderId)
+  ),
+  get_msg_log_prepare_count(TestReplicaId, V, N, Config.req_digest, Count_before),
+  assertion( Count_before == 3 ),
+  V1 is V+1,
+  msg_log_clear_where_view_less_than(TestReplicaId, V1),
+  get_msg_log_prepare_count(TestReplicaId, V, N, Config.req_digest, Count_after),
+  assertion( Count_after == 0 ),
+  assertion( \+ msg_log_prepare_count(TestReplicaId, _, _, _, _) ),
+  !.
+
 % Command to debug
 % guitracer, trace.
 
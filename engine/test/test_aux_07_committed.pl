@@ -60,6 +60,30 @@ test(test_aux_07_committed_01, [setup((setup_test(), build_config(Config)))]) :-
   assertion(\+committed(Config.req_digest, V, N, TestReplicaId)),
   !.
 
+% the commit counter follows the message log when it is garbage collected
+test(test_aux_07_committed_02, [setup((setup_test(), build_config(Config)))]) :-
+  V = Config.view0,
+  N = Config.seqno1,
+  PrimaryId = 0,
+  TestReplicaId = 1,
+  msg_log_add_request(TestReplicaId, Config.req_digest, Config.req_timestamp),
+  msg_log_add_pre_prepare(TestReplicaId, V, N, Config.req_digest, Config.associated_data, PrimaryId, Config.signatures.PrimaryId),
+  forall(
+    between(2,3,SenderId),
+    msg_log_add_prepare(TestReplicaId, V, N, Config.req_digest, SenderId, Config.signatures.SenderId)
+  ),
+  forall(
+    (between(0,3,SenderId),SenderId =\= TestReplicaId),
+    msg_log_add_commit(TestReplicaId, V, N, Config.associated_data, SenderId, Config.signatures.SenderId)
+  ),
+  get_msg_log_commit_count(TestReplicaId, V, N, Count_before),
+  assertion( Count_before == 3 ),
+  collect_garbage(N, TestReplicaId),
+  get_msg_log_commit_count(TestReplicaId, V, N, Count_after),
+  assertion( Count_after == 0 ),
+  assertion( \+ committed(Config.req_digest, V, N, TestReplicaId) ),
+  !.
+
 % Command to debug
 % guitracer, trace.
 
@@ -37,4 +37,16 @@ test(test_aux_08_correct_view_change_00, [setup(setup_test(_, _))]) :-
     P = [], Q = [],
     assertion(correct_view_change(V, H, P, Q)).
 
+% with a wider watermark window, the sets can hold the heights up to H+L
+test(test_aux_08_correct_view_change_03, [setup(setup_test(ReqDigest, AssociatedData))]) :-
+    V = 0, H = 0,
+    P = [[1, ReqDigest, V], [2, "req_digest_2", V]], Q = [[1, ReqDigest, AssociatedData, V], [2, "req_digest_2", "block_2", V]],
+    NewV #= V + 1,
+    assertion(\+correct_view_change(NewV, H, P, Q)),
+    set_request_buffer_len(2),
+    assertion(correct_view_change(NewV, H, P, Q)),
+    assertion(in_w(2, 0)),
+    assertion(\+in_w(3, 0)),
+    set_request_buffer_len(1).
+
 :- end_tests(test_aux_08_correct_view_change).
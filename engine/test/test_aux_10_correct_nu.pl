@@ -61,4 +61,29 @@ test(test_aux_10_correct_nu_01, [setup((setup_test(V),build_config(Config)))]) :
   assertion(\+correct_nu_once(_,TestReplicaId)).
 
 
+% a Nu received in a NEW_VIEW is checked for quorum size, membership and view consistency
+test(test_aux_10_correct_nu_02, [setup((setup_test(V),build_config(Config)))]) :-
+  TestReplicaId = 2,
+  C = "",
+  P = [], Q = [],
+  H = 0,
+  msg_log_add_view_change(TestReplicaId, Config.vcd0,  V, H,  C, P, Q, Config.r0, Config.sig0),
+  msg_log_add_view_change(TestReplicaId, Config.vcd1,  V, H,  C, P, Q, Config.r1, Config.sig1),
+  msg_log_add_view_change(TestReplicaId, Config.vcd2,  V, H,  C, P, Q, Config.r2, Config.sig2),
+  V2 is V+1,
+  msg_log_add_view_change(TestReplicaId, Config.vcd3,  V2, H,  C, P, Q, Config.r3, Config.sig3),
+  % a quorum of view change messages from the log
+  assertion(correct_nu([[Config.r0, Config.vcd0], [Config.r1, Config.vcd1], [Config.r2, Config.vcd2]], TestReplicaId)),
+  % less than a quorum
+  assertion(\+correct_nu([[Config.r0, Config.vcd0], [Config.r1, Config.vcd1]], TestReplicaId)),
+  % not sorted
+  assertion(\+correct_nu([[Config.r1, Config.vcd1], [Config.r0, Config.vcd0], [Config.r2, Config.vcd2]], TestReplicaId)),
+  % the same sender twice
+  assertion(\+correct_nu([[Config.r0, Config.vcd0], [Config.r0, Config.vcd1], [Config.r2, Config.vcd2]], TestReplicaId)),
+  % a view change message that is not in the log
+  assertion(\+correct_nu([[Config.r0, Config.vcd0], [Config.r1, Config.vcd1], [Config.r2, "vc_digest_unknown"]], TestReplicaId)),
+  % a view change message for another view
+  assertion(\+correct_nu([[Config.r0, Config.vcd0], [Config.r1, Config.vcd1], [Config.r3, Config.vcd3]], TestReplicaId)).
+
+
 :- end_tests(test_aux_10_correct_nu).
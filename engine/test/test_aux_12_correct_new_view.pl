@@ -52,4 +52,22 @@ test(test_aux_12_correct_new_view_00, [setup((setup_test(V),build_config(Config)
   msg_log_add_new_view(TestReplicaId, V, Nu, Chi, "dummy signature"),
   correct_new_view(Chi, Nu,TestReplicaId), !.
 
+test(test_aux_12_correct_new_view_01, [setup((setup_test(V),build_config(Config)))]) :-
+  TestReplicaId = 2,
+  checkpoint(TestReplicaId, _, CheckpointDigest, _),
+  C = CheckpointDigest,
+  % a request prepared at sequence number 2, while nothing is prepared at 1
+  N = 2,
+  P = [[N, Config.req_digest, V]], Q = [[N, Config.req_digest, Config.associated_data, V]],
+  H = 0,
+  msg_log_add_view_change(TestReplicaId, Config.vcd0,  V, H,  C, P, Q, Config.r0, Config.sig0),
+  msg_log_add_view_change(TestReplicaId, Config.vcd1,  V, H,  C, P, Q, Config.r1, Config.sig1),
+  msg_log_add_view_change(TestReplicaId, Config.vcd2,  V, H,  C, P, Q, Config.r2, Config.sig2),
+  msg_log_add_view_change(TestReplicaId, Config.vcd3,  V, H,  C, P, Q, Config.r3, Config.sig3),
+  Nu = [[Config.r0, Config.vcd0], [Config.r1, Config.vcd1], [Config.r2, Config.vcd2], [Config.r3, Config.vcd3]],
+  % the gap at sequence number 1 is filled with a "null" request
+  Chi = [[1, "null", "null"], [N, Config.req_digest, Config.associated_data]],
+  msg_log_add_new_view(TestReplicaId, V, Nu, Chi, "dummy signature"),
+  correct_new_view(Chi, Nu,TestReplicaId), !.
+
 :- end_tests(test_aux_12_correct_new_view).
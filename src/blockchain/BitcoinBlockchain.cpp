@@ -32,12 +32,62 @@ CBlock BitcoinBlockchain::GenerateBlock(uint32_t block_timestamp)
   return generateBlock(m_bitcoind, m_reward_address, block_timestamp);
 }
 
+CBlock BitcoinBlockchain::GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block)
+{
+  return generateBlockOnTopOf(m_bitcoind, m_reward_address, height, block_timestamp, parent_block);
+}
+
 bool BitcoinBlockchain::TestBlockValidity(const uint32_t height, const CBlock& block, bool check_signet_solution)
 {
   auto block_ser = HexSerializableCBlock(block);
   const uint32_t block_size_bytes = block_ser.GetHex().length() / 2;
   const std::string block_hash = block.GetBlockHeader().GetHash().ToString();
 
+  // Above the height following the bitcoind tip, the block builds on a proposed one that bitcoind
+  // does not know yet, and testblockvalidity would reject it. It is checked against its parent here,
+  // and bitcoind fully validates it when it is submitted.
+  if (height > m_bitcoind.getblockchaininfo()["blocks"].asUInt() + 1)
+  {
+    std::shared_ptr<const CBlock> p_parent_block = BlockStore::Instance().Get(block.hashPrevBlock.GetHex());
+    if (!p_parent_block)
+    {
+      BOOST_LOG_TRIVIAL(warning) << str(
+        boost::format("R%1% BitcoinBlockchain::TestBlockValidity the parent of candidate "
+        "block at height %2% with hash %3% is neither on the chain nor in the block store.")
+          % m_conf.id()
+          % height
+          % block_hash
+      );
+      return false;
+    }
+
+    try
+    {
+      checkBlockOnTopOf(m_bitcoind, height, block, *p_parent_block);
+    }
+    catch (const std::runtime_error& e)
+    {
+      BOOST_LOG_TRIVIAL(warning) << str(
+        boost::format("R%1% BitcoinBlockchain::TestBlockValidity for candidate "
+        "block at height %2% with hash %3% on top of a pending block raised %4%.")
+          % m_conf.id()
+          % height
+          % block_hash
+          % e.what()
+      );
+      return false;
+    }
+
+    BOOST_LOG_TRIVIAL(debug) << str(
+      boost::format("R%1% BitcoinBlockchain::TestBlockValidity candidate block at height %2% "
+        "with hash %3% is valid on top of a pending block.")
+        % m_conf.id()
+        % height
+        % block_hash
+    );
+    return true;
+  }
+
   BOOST_LOG_TRIVIAL(debug) << str(
     boost::format("R%1% BitcoinBlockchain::TestBlockValidity invoking for "
     "candidate block at height %2%, blocksize %3% bytes, block hash: %4%")
@@ -0,0 +1,92 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "blockchain.h"
+
+#include <limits>
+
+using namespace std;
+
+namespace itcoin {
+namespace blockchain {
+
+BlockStore& BlockStore::Instance()
+{
+  static BlockStore instance;
+  return instance;
+}
+
+std::shared_ptr<const CBlock> BlockStore::Put(uint32_t replica_id, uint32_t height, std::shared_ptr<const CBlock> block)
+{
+  const std::string block_hash = block->GetHash().GetHex();
+
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_blocks.find(block_hash);
+  if (it == m_blocks.end())
+  {
+    it = m_blocks.emplace(block_hash, Entry{block, height, {}}).first;
+    m_hashes_by_height.emplace(height, block_hash);
+  }
+  it->second.holders.insert(replica_id);
+  return it->second.block;
+}
+
+std::shared_ptr<const CBlock> BlockStore::Put(uint32_t replica_id, uint32_t height, const CBlock& block)
+{
+  {
+    // Avoid copying a block that is already in the store
+    std::lock_guard<std::mutex> lock(m_mutex);
+    auto it = m_blocks.find(block.GetHash().GetHex());
+    if (it != m_blocks.end())
+    {
+      it->second.holders.insert(replica_id);
+      return it->second.block;
+    }
+  }
+  return Put(replica_id, height, std::make_shared<const CBlock>(block));
+}
+
+std::shared_ptr<const CBlock> BlockStore::Get(const std::string& block_hash) const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto it = m_blocks.find(block_hash);
+  if (it == m_blocks.end())
+  {
+    return nullptr;
+  }
+  return it->second.block;
+}
+
+void BlockStore::Release(uint32_t replica_id, uint32_t height)
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  auto end = m_hashes_by_height.upper_bound(height);
+  for (auto it = m_hashes_by_height.begin(); it != end; )
+  {
+    auto block_it = m_blocks.find(it->second);
+    block_it->second.holders.erase(replica_id);
+    if (block_it->second.holders.empty())
+    {
+      m_blocks.erase(block_it);
+      it = m_hashes_by_height.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+}
+
+void BlockStore::ReleaseAll(uint32_t replica_id)
+{
+  Release(replica_id, std::numeric_limits<uint32_t>::max());
+}
+
+size_t BlockStore::size() const
+{
+  std::lock_guard<std::mutex> lock(m_mutex);
+  return m_blocks.size();
+}
+
+}
+}
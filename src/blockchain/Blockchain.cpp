@@ -3,6 +3,8 @@
 
 #include "blockchain.h"
 
+#include <stdexcept>
+
 namespace itcoin {
 namespace blockchain {
 
@@ -11,5 +13,10 @@ m_conf(conf)
 {
 }
 
+CBlock Blockchain::GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block)
+{
+  throw std::runtime_error("This blockchain cannot generate blocks on top of a pending block");
+}
+
 }
 }
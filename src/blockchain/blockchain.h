@@ -4,6 +4,13 @@
 #ifndef ITCOIN_BLOCKCHAIN_BLOCKCHAIN_H
 #define ITCOIN_BLOCKCHAIN_BLOCKCHAIN_H
 
+#include <map>
+#include <memory>
+#include <mutex>
+#include <set>
+#include <string>
+#include <unordered_map>
+
 #include <psbt.h>
 
 namespace itcoin {
@@ -26,6 +33,42 @@ class HexSerializableCBlock: public CBlock
     std::string GetHex() const;
 };
 
+// Content addressed store of the blocks referenced, by hash, from the FBFT engine.
+// The engine only keeps the block hash, messages resolve it here and share the
+// deserialized block instead of copying it. Each replica holds the blocks it has
+// put, and releases them once their height has been checkpointed.
+class BlockStore
+{
+  public:
+    // The store shared by the replicas of this process, as is the Prolog database
+    static BlockStore& Instance();
+
+    // Adds the block at the given height on behalf of replica_id, and returns the stored one
+    std::shared_ptr<const CBlock> Put(uint32_t replica_id, uint32_t height, std::shared_ptr<const CBlock> block);
+    std::shared_ptr<const CBlock> Put(uint32_t replica_id, uint32_t height, const CBlock& block);
+
+    // Returns nullptr if the block is not in the store
+    std::shared_ptr<const CBlock> Get(const std::string& block_hash) const;
+
+    // Releases the blocks held by replica_id up to the given height
+    void Release(uint32_t replica_id, uint32_t height);
+    // Releases all the blocks held by replica_id
+    void ReleaseAll(uint32_t replica_id);
+
+    size_t size() const;
+
+  private:
+    struct Entry {
+      std::shared_ptr<const CBlock> block;
+      uint32_t height;
+      std::set<uint32_t> holders;
+    };
+
+    mutable std::mutex m_mutex;
+    std::unordered_map<std::string, Entry> m_blocks;
+    std::multimap<uint32_t, std::string> m_hashes_by_height;
+};
+
 class Blockchain
 {
   public:
@@ -35,6 +78,13 @@ class Blockchain
     virtual bool TestBlockValidity(const uint32_t height, const CBlock&, bool check_signet_solution) = 0;
     virtual void SubmitBlock(const uint32_t height, const CBlock&) = 0;
 
+    // Whether blocks can be generated on top of a block that is proposed but not yet on the chain.
+    // This lets a primary propose more heights than the one above the chain tip.
+    virtual bool CanGenerateOnPendingBlock() const { return false; }
+    // Generates the block at the given height on top of parent_block, which may not be on the chain yet.
+    // Throws if the blockchain cannot generate on pending blocks.
+    virtual CBlock GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block);
+
   protected:
     const itcoin::FbftConfig& m_conf;
 };
@@ -45,8 +95,12 @@ class BitcoinBlockchain: public Blockchain
     BitcoinBlockchain(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind);
 
     CBlock GenerateBlock(uint32_t block_timestamp);
+    // Blocks whose parent is not on the chain of bitcoind yet, but in the BlockStore,
+    // are checked locally, see checkBlockOnTopOf in generate.h
     bool TestBlockValidity(const uint32_t height, const CBlock& block, bool check_signet_solution);
     void SubmitBlock(const uint32_t height, const CBlock& block);
+    bool CanGenerateOnPendingBlock() const { return true; }
+    CBlock GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block);
 
   protected:
     transport::BtcClient& m_bitcoind;
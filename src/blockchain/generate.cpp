@@ -20,6 +20,9 @@ namespace itcoin { namespace blockchain {
 
 const std::vector<unsigned char> WITNESS_COMMITMENT_HEADER = {0xaa, 0x21, 0xa9, 0xed};
 
+// As in the consensus parameters of every chain, signet included
+const uint64_t SUBSIDY_HALVING_INTERVAL = 210000;
+
 /**
  *
  * Get block template from the Bitcoin node with Signet and SegWit rules.
@@ -136,76 +139,15 @@ CScript GetWitnessScript(uint256 witnessRoot, uint256 witnessNonce)
   return CScript() << OP_RETURN << data;
 } // GetWitnessScript()
 
-CBlock generateBlock(transport::BtcClient& bitcoindClient, const std::string& address, uint32_t block_timestamp)
+/**
+ * Completes a block whose header fields are already set, with the coinbase
+ * transaction followed by the given transactions: appends the witness commitment
+ * and the SIGNET_HEADER to the coinbase, then mines the block.
+ */
+CBlock assembleBlock(CBlock block, CTransactionRef coinbaseTx, const Json::Value& transactionJson)
 {
-  // create block template - START
-  Json::Value blockTemplate;
-  std::string previousBlockHash;
-  {
-    blockTemplate = getSignetAndSegwitBlockTemplate(bitcoindClient);
-    previousBlockHash = utils::checkHash(blockTemplate["previousblockhash"].asString());
-
-    BOOST_LOG_TRIVIAL(trace) << "Block template: " << blockTemplate.toStyledString();
-  } // create block template - END
-
-  // build coinbase transaction - START
-  CTransactionRef coinbaseTx;
-  {
-    /*
-     * This code mimics:
-     *
-     * https://github.com/bancaditalia/itcoin-core/blob/2f37bb2000665da31e4f45ebcdbfd059b1f3b2df/contrib/signet/miner.py#L377
-     * https://github.com/bancaditalia/itcoin-core/blob/2f37bb2000665da31e4f45ebcdbfd059b1f3b2df/contrib/signet/miner.py#L130-L134
-     */
-    const uint64_t height = blockTemplate["height"].asUInt64();
-    const CAmount value = blockTemplate["coinbasevalue"].asUInt64();
-    const CScript scriptPubKey = getScriptPubKey(bitcoindClient, address);
-    coinbaseTx = buildCoinbaseTransaction(height, value, scriptPubKey);
-
-    BOOST_LOG_TRIVIAL(trace) << "coinbase tx hash: " << coinbaseTx->GetHash().GetHex();
-  } // build coinbase transaction - END
-
-  // create block - START
-  CBlock block;
+  // fill the transactions - START
   {
-    block.nVersion = blockTemplate["version"].asInt();
-
-    uint256 previousBlockHashInt256;
-    previousBlockHashInt256.SetHex(previousBlockHash);
-    block.hashPrevBlock = previousBlockHashInt256;
-
-    const uint32_t minTime = blockTemplate["mintime"].asUInt();
-    /*
-      A timestamp is accepted as valid if it is greater than the median timestamp of previous 11 blocks,
-      and less than the network-adjusted time + 2 hours.
-      "Network-adjusted time" is the median of the timestamps returned by all nodes connected to you.
-      As a result block timestamps are not exactly accurate, and they do not need to be.
-      Block times are accurate only to within an hour or two.
-      Whenever a node connects to another node, it gets a UTC timestamp from it, and stores its offset from node-local UTC.
-      The network-adjusted time is then the node-local UTC plus the median offset from all connected nodes.
-      Network time is never adjusted more than 70 minutes from local system time, however.
-
-      WAS:
-
-      const uint32_t curTime = blockTemplate["curtime"].asUInt();
-      block.nTime = curTime < minTime? minTime: curTime;
-    */
-    if (block_timestamp<minTime)
-    {
-      std::string error_msg = str(
-        boost::format("generate::generateBlock timestamp below minTime: %1%, block_timestamp %2%")
-          % minTime
-          % block_timestamp
-      );
-      throw std::runtime_error(error_msg);
-    }
-    block.nTime = block_timestamp;
-
-    block.nBits = utils::stoui(blockTemplate["bits"].asString(), nullptr, 16);
-    block.nNonce = 0;
-
-    const Json::Value transactionJson = blockTemplate["transactions"];
-
     // +1 because of the coinbase transaction
     block.vtx.resize(1 + transactionJson.size());
     block.vtx[0] = coinbaseTx;
@@ -225,7 +167,7 @@ CBlock generateBlock(transport::BtcClient& bitcoindClient, const std::string& ad
     }
 
     BOOST_LOG_TRIVIAL(trace) << "Block merkle root (function which includes signatures) after block creation: " << BlockMerkleRoot(block).GetHex();
-  } // create block - END
+  } // fill the transactions - END
 
   // append the witness commitment - START
   CScript newOutScript;
@@ -311,6 +253,198 @@ CBlock generateBlock(transport::BtcClient& bitcoindClient, const std::string& ad
   } // mine block - END
 
   return block;
+} // assembleBlock()
+
+CBlock generateBlock(transport::BtcClient& bitcoindClient, const std::string& address, uint32_t block_timestamp)
+{
+  // create block template - START
+  Json::Value blockTemplate;
+  std::string previousBlockHash;
+  {
+    blockTemplate = getSignetAndSegwitBlockTemplate(bitcoindClient);
+    previousBlockHash = utils::checkHash(blockTemplate["previousblockhash"].asString());
+
+    BOOST_LOG_TRIVIAL(trace) << "Block template: " << blockTemplate.toStyledString();
+  } // create block template - END
+
+  // build coinbase transaction - START
+  CTransactionRef coinbaseTx;
+  {
+    /*
+     * This code mimics:
+     *
+     * https://github.com/bancaditalia/itcoin-core/blob/2f37bb2000665da31e4f45ebcdbfd059b1f3b2df/contrib/signet/miner.py#L377
+     * https://github.com/bancaditalia/itcoin-core/blob/2f37bb2000665da31e4f45ebcdbfd059b1f3b2df/contrib/signet/miner.py#L130-L134
+     */
+    const uint64_t height = blockTemplate["height"].asUInt64();
+    const CAmount value = blockTemplate["coinbasevalue"].asUInt64();
+    const CScript scriptPubKey = getScriptPubKey(bitcoindClient, address);
+    coinbaseTx = buildCoinbaseTransaction(height, value, scriptPubKey);
+
+    BOOST_LOG_TRIVIAL(trace) << "coinbase tx hash: " << coinbaseTx->GetHash().GetHex();
+  } // build coinbase transaction - END
+
+  // create block header - START
+  CBlock block;
+  {
+    block.nVersion = blockTemplate["version"].asInt();
+
+    uint256 previousBlockHashInt256;
+    previousBlockHashInt256.SetHex(previousBlockHash);
+    block.hashPrevBlock = previousBlockHashInt256;
+
+    const uint32_t minTime = blockTemplate["mintime"].asUInt();
+    /*
+      A timestamp is accepted as valid if it is greater than the median timestamp of previous 11 blocks,
+      and less than the network-adjusted time + 2 hours.
+      "Network-adjusted time" is the median of the timestamps returned by all nodes connected to you.
+      As a result block timestamps are not exactly accurate, and they do not need to be.
+      Block times are accurate only to within an hour or two.
+      Whenever a node connects to another node, it gets a UTC timestamp from it, and stores its offset from node-local UTC.
+      The network-adjusted time is then the node-local UTC plus the median offset from all connected nodes.
+      Network time is never adjusted more than 70 minutes from local system time, however.
+
+      WAS:
+
+      const uint32_t curTime = blockTemplate["curtime"].asUInt();
+      block.nTime = curTime < minTime? minTime: curTime;
+    */
+    if (block_timestamp<minTime)
+    {
+      std::string error_msg = str(
+        boost::format("generate::generateBlock timestamp below minTime: %1%, block_timestamp %2%")
+          % minTime
+          % block_timestamp
+      );
+      throw std::runtime_error(error_msg);
+    }
+    block.nTime = block_timestamp;
+
+    block.nBits = utils::stoui(blockTemplate["bits"].asString(), nullptr, 16);
+    block.nNonce = 0;
+  } // create block header - END
+
+  return assembleBlock(block, coinbaseTx, blockTemplate["transactions"]);
 } // generateBlock()
 
+/**
+ * The block subsidy at the given height, derived from a block template for a
+ * lower (or the same) height: the template coinbase value minus the fees of the
+ * template transactions, halved once for every halving height in between.
+ */
+CAmount getSubsidyFromTemplate(const Json::Value& blockTemplate, uint64_t height)
+{
+  CAmount fees = 0;
+  const Json::Value transactionJson = blockTemplate["transactions"];
+  for (auto it = transactionJson.begin(); it != transactionJson.end(); ++it) {
+    fees += (*it)["fee"].asInt64();
+  }
+  const CAmount templateSubsidy = blockTemplate["coinbasevalue"].asInt64() - fees;
+
+  const uint64_t templateHeight = blockTemplate["height"].asUInt64();
+  const uint64_t halvings = height / SUBSIDY_HALVING_INTERVAL - templateHeight / SUBSIDY_HALVING_INTERVAL;
+  if (halvings >= 64) {
+    return 0;
+  }
+
+  return templateSubsidy >> halvings;
+} // getSubsidyFromTemplate()
+
+CBlock generateBlockOnTopOf(transport::BtcClient& bitcoindClient, const std::string& address,
+  uint32_t height, uint32_t block_timestamp, const CBlock& parentBlock)
+{
+  if (block_timestamp <= parentBlock.nTime)
+  {
+    std::string error_msg = str(
+      boost::format("generate::generateBlockOnTopOf timestamp not above the parent block timestamp: %1%, block_timestamp %2%")
+        % parentBlock.nTime
+        % block_timestamp
+    );
+    throw std::runtime_error(error_msg);
+  }
+
+  // The template is only used for the block subsidy, its transactions may already be in the parent block
+  const Json::Value blockTemplate = getSignetAndSegwitBlockTemplate(bitcoindClient);
+
+  // build coinbase transaction - START
+  CTransactionRef coinbaseTx;
+  {
+    const CAmount value = getSubsidyFromTemplate(blockTemplate, height);
+    const CScript scriptPubKey = getScriptPubKey(bitcoindClient, address);
+    coinbaseTx = buildCoinbaseTransaction(height, value, scriptPubKey);
+
+    BOOST_LOG_TRIVIAL(trace) << "coinbase tx hash: " << coinbaseTx->GetHash().GetHex();
+  } // build coinbase transaction - END
+
+  // create block header - START
+  CBlock block;
+  {
+    block.nVersion = parentBlock.nVersion;
+    block.hashPrevBlock = parentBlock.GetHash();
+    block.nTime = block_timestamp;
+    block.nBits = parentBlock.nBits;
+    block.nNonce = 0;
+  } // create block header - END
+
+  return assembleBlock(block, coinbaseTx, Json::Value(Json::arrayValue));
+} // generateBlockOnTopOf()
+
+void checkBlockOnTopOf(transport::BtcClient& bitcoindClient, uint32_t height, const CBlock& block, const CBlock& parentBlock)
+{
+  auto fail = [height](const std::string& reason) {
+    throw std::runtime_error(str(
+      boost::format("generate::checkBlockOnTopOf block at height %1% %2%")
+        % height
+        % reason
+    ));
+  };
+
+  // header - START
+  {
+    if (block.hashPrevBlock != parentBlock.GetHash()) {
+      fail("does not build on the given parent block");
+    }
+    if (parentBlock.vtx.empty() || parentBlock.vtx[0]->vin.empty() ||
+        parentBlock.vtx[0]->vin[0].scriptSig != getScriptBIP34CoinbaseHeight(height - 1)) {
+      fail("has a parent block that is not at the previous height");
+    }
+    if (block.nTime <= parentBlock.nTime) {
+      fail("has a timestamp not above the parent block timestamp");
+    }
+    if (block.nBits != parentBlock.nBits) {
+      fail("has a target different from the parent block one");
+    }
+  } // header - END
+
+  // coinbase transaction - START
+  {
+    if (block.vtx.size() != 1 || !block.vtx[0]->IsCoinBase()) {
+      fail("does not contain only the coinbase transaction");
+    }
+    const CTransaction& coinbaseTx = *block.vtx[0];
+    if (coinbaseTx.vin[0].scriptSig != getScriptBIP34CoinbaseHeight(height)) {
+      fail("has a coinbase transaction for a different height");
+    }
+    const Json::Value blockTemplate = getSignetAndSegwitBlockTemplate(bitcoindClient);
+    if (coinbaseTx.GetValueOut() > getSubsidyFromTemplate(blockTemplate, height)) {
+      fail("has a coinbase transaction paying more than the block subsidy");
+    }
+  } // coinbase transaction - END
+
+  // commitments - START
+  {
+    bool mutated = false;
+    if (block.hashMerkleRoot != BlockMerkleRoot(block, &mutated) || mutated) {
+      fail("has a wrong merkle root");
+    }
+    // The signet solution, if any, is appended after the SIGNET_HEADER
+    const CScript expectedOutScript = GetWitnessScript(BlockWitnessMerkleRoot(block), uint256(0)) << SIGNET_HEADER_VEC;
+    const CScript& outScript = block.vtx[0]->vout.back().scriptPubKey;
+    if (outScript.size() < expectedOutScript.size() ||
+        !std::equal(expectedOutScript.begin(), expectedOutScript.end(), outScript.begin())) {
+      fail("has a wrong witness commitment");
+    }
+  } // commitments - END
+} // checkBlockOnTopOf()
+
 }} // namespace itcoin::blockchain
@@ -38,6 +38,36 @@ const std::vector<unsigned char> SIGNET_HEADER_VEC = std::vector<unsigned char>{
  */
 CBlock generateBlock(transport::BtcClient& bitcoindClient, const std::string& address, uint32_t block_timestamp);
 
+/**
+ * This function generates a itcoin-flavoured signet block on top of parentBlock,
+ * which may not be on the chain of the node yet.
+ *
+ * Since the transactions of the node mempool may already be in parentBlock, the
+ * block only contains the coinbase transaction, which pays the block subsidy.
+ * The block version and target are the ones of parentBlock.
+ *
+ * @param bitcoindClient the JSON-RPC Bitcoin client wrapper
+ * @param address the reward address for the coinbase transaction
+ * @param height the height of the block, one above the parentBlock one
+ * @param parentBlock the block to build on
+ * @return the generated block
+ */
+CBlock generateBlockOnTopOf(transport::BtcClient& bitcoindClient, const std::string& address,
+  uint32_t height, uint32_t block_timestamp, const CBlock& parentBlock);
+
+/**
+ * Checks a block built on top of parentBlock, as generateBlockOnTopOf does, when
+ * parentBlock is not on the chain of the node yet and the node cannot test it.
+ *
+ * The header must link to parentBlock, the block must only contain a coinbase
+ * transaction for the given height paying at most the block subsidy, and the
+ * merkle root and the witness commitment must match. The signet solution is not
+ * checked.
+ *
+ * @throws std::runtime_error describing the first failed check
+ */
+void checkBlockOnTopOf(transport::BtcClient& bitcoindClient, uint32_t height, const CBlock& block, const CBlock& parentBlock);
+
 /**
  * Get the scriptPubKey of a Bitcoin address.
  *
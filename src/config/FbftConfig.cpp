@@ -22,6 +22,15 @@ namespace itcoin {
 
 const string DEFAULT_MINER_CONF_FILENAME = "miner.conf.json";
 const string DEFAULT_FBFT_DB_FILENAME = "miner.fbft.db";
+const string DEFAULT_FBFT_DIGEST_SCHEME = "prolog";
+const bool DEFAULT_FBFT_BATCH_APPLY = true;
+const string DEFAULT_FBFT_SCHEDULER = "priority";
+const uint32_t DEFAULT_FBFT_REQUEST_BUFFER_LEN = 1;
+const uint32_t DEFAULT_FBFT_FUTURE_MSG_WINDOW = 1;
+const uint32_t DEFAULT_FBFT_CRYPTO_THREADS = 0;
+const uint32_t DEFAULT_FBFT_VERIFICATION_CACHE_SIZE = 4096;
+const string DEFAULT_FBFT_SIGNATURE_SCHEME = "ecdsa";
+const bool DEFAULT_FBFT_MAC_AUTHENTICATORS = false;
 
 FbftConfig::FbftConfig(std::string datadir, std::string configFileName)
 {
@@ -34,6 +43,16 @@ FbftConfig::FbftConfig(std::string datadir, std::string configFileName)
   // Engine reset and database
   m_fbft_db_reset = false;
   m_fbft_db_filename = datadir + "/" + DEFAULT_FBFT_DB_FILENAME;
+  m_fbft_digest_scheme = DEFAULT_FBFT_DIGEST_SCHEME;
+  m_fbft_batch_apply = DEFAULT_FBFT_BATCH_APPLY;
+  m_fbft_scheduler = DEFAULT_FBFT_SCHEDULER;
+  m_fbft_scheduler_seed = std::nullopt;
+  m_fbft_request_buffer_len = DEFAULT_FBFT_REQUEST_BUFFER_LEN;
+  m_fbft_future_msg_window = DEFAULT_FBFT_FUTURE_MSG_WINDOW;
+  m_fbft_crypto_threads = DEFAULT_FBFT_CRYPTO_THREADS;
+  m_fbft_verification_cache_size = DEFAULT_FBFT_VERIFICATION_CACHE_SIZE;
+  m_fbft_signature_scheme = DEFAULT_FBFT_SIGNATURE_SCHEME;
+  m_fbft_mac_authenticators = DEFAULT_FBFT_MAC_AUTHENTICATORS;
 
   // Clear args
   gArgs.ClearArgs();
@@ -169,6 +188,70 @@ FbftConfig::FbftConfig(std::string datadir, std::string configFileName)
     BOOST_LOG_TRIVIAL(warning) << "Messages from this replica will also be sent to " << m_sniffer_dish_connection_string.value();
   }
 
+  // Select the message digest scheme. Replicas using different schemes cannot talk to each other, "native" is opt-in.
+  // The VIEW_CHANGE messages now carry block hashes, so their "prolog" digests differ from the previous releases ones.
+  if (!config["fbft_digest_scheme"].isNull()) {
+    m_fbft_digest_scheme = config["fbft_digest_scheme"].asString();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will use the " << m_fbft_digest_scheme << " message digests.";
+
+  // Select whether the active actions are applied in batches, false applies them one at a time
+  if (!config["fbft_batch_apply"].isNull()) {
+    m_fbft_batch_apply = config["fbft_batch_apply"].asBool();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will apply the active actions " << (m_fbft_batch_apply ? "in batches." : "one at a time.");
+
+  // Select the action scheduler, "random" keeps the behaviour of the previous releases
+  if (!config["fbft_scheduler"].isNull()) {
+    m_fbft_scheduler = config["fbft_scheduler"].asString();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will use the " << m_fbft_scheduler << " action scheduler.";
+
+  // A seed makes the random choices of the scheduler reproducible, e.g. in benchmarks
+  if (!config["fbft_scheduler_seed"].isNull()) {
+    m_fbft_scheduler_seed = config["fbft_scheduler_seed"].asUInt();
+    BOOST_LOG_TRIVIAL(debug) << "The action scheduler of this replica will be seeded with " << m_fbft_scheduler_seed.value() << ".";
+  }
+
+  // Select how many heights above the latest checkpoint can be in flight at the same time
+  if (!config["fbft_request_buffer_len"].isNull()) {
+    m_fbft_request_buffer_len = config["fbft_request_buffer_len"].asUInt();
+  }
+  if (m_fbft_request_buffer_len < 1) {
+    throw std::runtime_error("fbft_request_buffer_len must be at least 1");
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will keep up to " << m_fbft_request_buffer_len << " heights in flight.";
+
+  // Select how many heights above the watermark window the replica keeps the messages of, until they enter the window
+  if (!config["fbft_future_msg_window"].isNull()) {
+    m_fbft_future_msg_window = config["fbft_future_msg_window"].asUInt();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will keep the messages of up to " << m_fbft_future_msg_window << " heights above the watermark window.";
+
+  // Select how many worker threads verify and sign the messages, 0 keeps them on the consensus thread
+  if (!config["fbft_crypto_threads"].isNull()) {
+    m_fbft_crypto_threads = config["fbft_crypto_threads"].asUInt();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will verify and sign the messages with " << m_fbft_crypto_threads << " worker threads.";
+
+  // Select how many verified signatures are remembered, 0 verifies every message
+  if (!config["fbft_verification_cache_size"].isNull()) {
+    m_fbft_verification_cache_size = config["fbft_verification_cache_size"].asUInt();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will remember up to " << m_fbft_verification_cache_size << " verified signatures.";
+
+  // Select how the replicas sign the messages, see wallet::SIGNATURE_SCHEME
+  if (!config["fbft_signature_scheme"].isNull()) {
+    m_fbft_signature_scheme = config["fbft_signature_scheme"].asString();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will use the " << m_fbft_signature_scheme << " message signatures.";
+
+  // Select whether PRE_PREPAREs, PREPAREs and COMMITs carry MAC authenticators instead of signatures
+  if (!config["fbft_mac_authenticators"].isNull()) {
+    m_fbft_mac_authenticators = config["fbft_mac_authenticators"].asBool();
+  }
+  BOOST_LOG_TRIVIAL(debug) << "This replica will authenticate the normal case messages with " << (m_fbft_mac_authenticators ? "MAC authenticators." : "signatures.");
+
   // Read the replica config
   Json::Value replica_config_a = config["fbft_replica_set"];
   for ( unsigned int i = 0; i < replica_config_a.size(); ++i )
@@ -62,6 +62,16 @@ class FbftConfig
     void set_target_block_time(uint64_t target_block_time){m_target_block_time = target_block_time;}
     void set_fbft_db_reset(bool reset){ m_fbft_db_reset=reset; }
     void set_fbft_db_filename(std::string filename){ m_fbft_db_filename=filename; }
+    void set_fbft_digest_scheme(std::string digest_scheme){ m_fbft_digest_scheme=digest_scheme; }
+    void set_fbft_batch_apply(bool batch_apply){ m_fbft_batch_apply=batch_apply; }
+    void set_fbft_scheduler(std::string scheduler){ m_fbft_scheduler=scheduler; }
+    void set_fbft_scheduler_seed(std::optional<uint32_t> seed){ m_fbft_scheduler_seed=seed; }
+    void set_fbft_request_buffer_len(uint32_t request_buffer_len){ m_fbft_request_buffer_len=request_buffer_len; }
+    void set_fbft_future_msg_window(uint32_t future_msg_window){ m_fbft_future_msg_window=future_msg_window; }
+    void set_fbft_crypto_threads(uint32_t crypto_threads){ m_fbft_crypto_threads=crypto_threads; }
+    void set_fbft_verification_cache_size(uint32_t verification_cache_size){ m_fbft_verification_cache_size=verification_cache_size; }
+    void set_fbft_signature_scheme(std::string signature_scheme){ m_fbft_signature_scheme=signature_scheme; }
+    void set_fbft_mac_authenticators(bool mac_authenticators){ m_fbft_mac_authenticators=mac_authenticators; }
 
     // If set, zmq messages from this replica will also be sent to this dish
     const std::optional<std::string> sniffer_dish_connection_string() const { return m_sniffer_dish_connection_string; }
@@ -102,6 +112,36 @@ class FbftConfig
     std::string fbft_db_filename() const { return m_fbft_db_filename; }
     bool fbft_db_reset() const { return m_fbft_db_reset; }
 
+    // Name of the scheme used to compute message digests, either the default "prolog" or "native"
+    std::string fbft_digest_scheme() const { return m_fbft_digest_scheme; }
+
+    // Whether the replica applies its active actions in batches, refreshing its state once per batch
+    bool fbft_batch_apply() const { return m_fbft_batch_apply; }
+
+    // Name of the scheduler ordering the active actions, either "priority" or the legacy "random"
+    std::string fbft_scheduler() const { return m_fbft_scheduler; }
+    // If set, the scheduler makes the same choices at each run
+    std::optional<uint32_t> fbft_scheduler_seed() const { return m_fbft_scheduler_seed; }
+
+    // Size of the watermark window, i.e. the number of heights above the latest checkpoint the replica
+    // agrees on at the same time. With 1, each block has to reach the chain before the next one is proposed.
+    uint32_t fbft_request_buffer_len() const { return m_fbft_request_buffer_len; }
+    // Number of heights above the watermark window whose messages are kept until they can be applied.
+    // With 0, only the messages of the heights in the window that wait for their parent block are kept.
+    uint32_t fbft_future_msg_window() const { return m_fbft_future_msg_window; }
+    // Number of worker threads verifying the received messages and signing the sent ones in parallel.
+    // With 0, the consensus thread verifies and signs the messages one at a time.
+    uint32_t fbft_crypto_threads() const { return m_fbft_crypto_threads; }
+    // Number of (sender, digest, signature) triples whose signature is known to be valid, so that a message
+    // received again is not verified twice. With 0, every received message is verified.
+    uint32_t fbft_verification_cache_size() const { return m_fbft_verification_cache_size; }
+    // Name of the scheme used to sign the messages, either the signmessage compatible "ecdsa" or the Schnorr "bip340".
+    // All the replicas must use the same scheme.
+    std::string fbft_signature_scheme() const { return m_fbft_signature_scheme; }
+    // Whether the PRE_PREPAREs, PREPAREs and COMMITs carry a vector of HMAC-SHA256 tags, one per recipient, as in PBFT.
+    // The other messages keep the signatures of fbft_signature_scheme.
+    bool fbft_mac_authenticators() const { return m_fbft_mac_authenticators; }
+
   private:
     unsigned int id_;
     uint32_t m_cluster_size;
@@ -121,6 +161,16 @@ class FbftConfig
     // Fbft engine persistence
     bool m_fbft_db_reset;
     std::string m_fbft_db_filename;
+    std::string m_fbft_digest_scheme;
+    bool m_fbft_batch_apply;
+    std::string m_fbft_scheduler;
+    std::optional<uint32_t> m_fbft_scheduler_seed;
+    uint32_t m_fbft_request_buffer_len;
+    uint32_t m_fbft_future_msg_window;
+    uint32_t m_fbft_crypto_threads;
+    uint32_t m_fbft_verification_cache_size;
+    std::string m_fbft_signature_scheme;
+    bool m_fbft_mac_authenticators;
 
     // If set, zmq messages from this replica will also be sent to this dish
     std::optional<std::string> m_sniffer_dish_connection_string;
@@ -3,6 +3,7 @@
 
 #include "Replica2.h"
 
+#include <algorithm>
 #include <thread>
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
@@ -26,10 +27,12 @@ Replica2::Replica2(
   uint32_t start_time
 ):
 ReplicaState(config, blockchain, wallet, start_height, start_hash, start_time),
-m_transport(transport)
+m_transport(transport),
+m_scheduler(scheduler::ActionScheduler::BuildFromConfig(config)),
+m_request_horizon(config),
+m_crypto_pool(wallet, config.fbft_crypto_threads(), config.fbft_verification_cache_size()),
+m_actions_left_to_budget(false)
 {
-  // use current time as seed for random generator
-  std::srand(std::time(nullptr));
 }
 
 const uint32_t Replica2::id() const
@@ -48,13 +51,16 @@ void Replica2::GenerateRequests()
   uint32_t last_req_time = this->latest_request_time();
   uint32_t last_rep_time = this->latest_reply_time();
 
-  // Always ensure there is exactly MAX_NUM_GENERATED_REQUESTS request in the future
-  // This number may need to become adaptive
-  uint32_t MAX_NUM_GENERATED_REQUESTS = 5;
+  // The horizon follows the observed replies and view changes
+  m_request_horizon.Observe(this->current_time(), this->latest_reply_time(), this->view());
+  uint32_t horizon = m_request_horizon.horizon();
 
+  // Always ensure there are horizon requests in the future.
+  // The timestamps follow each other, hence the requests are applied as a single batch.
+  std::vector<std::shared_ptr<actions::Action>> receive_requests;
   while(
-    last_req_time < current_time + MAX_NUM_GENERATED_REQUESTS*target_block_time &&
-    last_req_time < last_rep_time + MAX_NUM_GENERATED_REQUESTS*target_block_time
+    last_req_time < current_time + horizon*target_block_time &&
+    last_req_time < last_rep_time + horizon*target_block_time
   )
   {
     uint32_t req_timestamp = last_req_time + target_block_time;
@@ -62,24 +68,29 @@ void Replica2::GenerateRequests()
       boost::format("R%1% last_req_time=%2% < current_time + delta = %3% and < last_rep_time + delta = %4%, creating request with H=%5% and T=%6%.")
         % m_conf.id()
         % last_req_time
-        % (current_time + MAX_NUM_GENERATED_REQUESTS*target_block_time)
-        % (last_rep_time + MAX_NUM_GENERATED_REQUESTS*target_block_time)
+        % (current_time + horizon*target_block_time)
+        % (last_rep_time + horizon*target_block_time)
         % ((req_timestamp-genesis_block_time) / target_block_time)
         % req_timestamp
     );
     messages::Request req = messages::Request(genesis_block_time, target_block_time, req_timestamp);
-    actions::ReceiveRequest receive_req(m_conf.id(), req);
-    this->Apply(receive_req);
+    receive_requests.emplace_back(std::make_shared<actions::ReceiveRequest>(m_conf.id(), req));
+    last_req_time = req_timestamp;
+  }
+
+  if (!receive_requests.empty())
+  {
+    this->ApplyBatch(receive_requests);
     last_req_time = this->latest_request_time();
   }
 
-  if (last_req_time >= current_time + MAX_NUM_GENERATED_REQUESTS*target_block_time)
+  if (last_req_time >= current_time + horizon*target_block_time)
   {
     BOOST_LOG_TRIVIAL(trace) << str(
       boost::format("R%1% last_req_time=%2% >= current_time + delta = %3%, stop creating requests.")
         % m_conf.id()
         % last_req_time
-        % (current_time + MAX_NUM_GENERATED_REQUESTS*target_block_time)
+        % (current_time + horizon*target_block_time)
     );
   }
   else
@@ -88,75 +99,170 @@ void Replica2::GenerateRequests()
       boost::format("R%1% last_req_time=%2% >= last_rep_time + delta = %3%, stop creating requests.")
         % m_conf.id()
         % last_req_time
-        % (last_rep_time + MAX_NUM_GENERATED_REQUESTS*target_block_time)
+        % (last_rep_time + horizon*target_block_time)
     );
   }
 }
 
-void Replica2::ApplyActiveActions()
+std::optional<double> Replica2::NextDeadline() const
+{
+  state::ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  std::vector<double> deadlines;
+
+  // GenerateRequests creates a request once the latest one is less than horizon blocks
+  // ahead of the current time, truncated to seconds, unless the replies are lagging behind
+  double target_block_time = m_conf.target_block_time();
+  double last_req_time = this->latest_request_time();
+  uint32_t horizon = m_request_horizon.horizon();
+  if (last_req_time < this->latest_reply_time() + horizon*target_block_time)
+  {
+    deadlines.push_back(last_req_time - horizon*target_block_time + 1);
+  }
+
+  // The next request may be proposed when its timestamp is reached
+  std::optional<double> next_request_time = m_engine->next_request_time();
+  if (next_request_time.has_value())
+  {
+    deadlines.push_back(next_request_time.value());
+  }
+
+  // A VIEW_CHANGE is sent when a request is not replied within the timeout
+  std::optional<double> view_change_deadline = m_engine->view_change_deadline();
+  if (view_change_deadline.has_value())
+  {
+    deadlines.push_back(view_change_deadline.value());
+  }
+
+  // The previous CheckTimedActions evaluated the time dependent preconditions after these deadlines,
+  // what they enabled has been applied. Reporting them again would fire CheckTimedActions in a loop
+  if (m_last_timed_check.has_value())
+  {
+    double last_timed_check = m_last_timed_check.value();
+    deadlines.erase(
+      std::remove_if(deadlines.begin(), deadlines.end(), [last_timed_check](double deadline) { return deadline < last_timed_check; }),
+      deadlines.end()
+    );
+  }
+
+  // Unless the scheduler budget left some of the actions for the next cycle
+  if (m_actions_left_to_budget)
+  {
+    deadlines.push_back(this->current_time());
+  }
+
+  if (deadlines.empty())
+  {
+    return std::nullopt;
+  }
+  return *std::min_element(deadlines.begin(), deadlines.end());
+}
+
+uint32_t Replica2::BroadcastOutMessages()
 {
-  // We execute an active action
-  uint32_t num_applied_actions = 0; uint32_t MAX_NUM_APPLIED_ACTIONS = 11;
-  while (!m_active_actions.empty() && num_applied_actions<MAX_NUM_APPLIED_ACTIONS)
-  {
-    // We apply a random action
-    size_t num_actions = m_active_actions.size();
-    int index_random = std::rand() % num_actions;
-    std::unique_ptr<actions::Action> action_to_apply= move(m_active_actions.at(index_random));
-    this->Apply( *action_to_apply );
-    num_applied_actions += 1;
-
-    // We broadcast all messages in the output buffer
-    if (!m_out_msg_buffer.empty())
+  uint32_t num_injected_messages = 0;
+  if (m_out_msg_buffer.empty())
+  {
+    return num_injected_messages;
+  }
+
+  std::vector<unique_ptr<messages::Message>> ready_to_be_sent{};
+  for (auto& p_msg: m_out_msg_buffer)
+  {
+    // i-th element in out_msg_buffer is nullptr after move, but still present
+    ready_to_be_sent.emplace_back(move(p_msg));
+  }
+  this->ClearOutMessageBuffer();
+
+  std::vector<unique_ptr<messages::Message>> to_be_signed{};
+  for (auto& p_msg: ready_to_be_sent)
+  {
+    // In 5FBFT the Primary may be both the ROAST coordinator and a signer of a signature session,
+    // in that case it is also one of the recipients of its own ROAST messages.
+    // These are handed to the state machine before signing, through the trusted local path.
+    if (IsAddressedToSelf(*p_msg))
     {
-      std::vector<unique_ptr<messages::Message>> ready_to_be_sent{};
-      for (auto& p_msg: m_out_msg_buffer)
+      num_injected_messages += 1;
+      if (!IsAddressedToOthers(*p_msg))
       {
-        // i-th element in out_msg_buffer is nullptr after move, but still present
-        ready_to_be_sent.emplace_back(move(p_msg));
+        this->DeliverOwnMessage(move(p_msg));
+        continue;
       }
-      this->ClearOutMessageBuffer();
+      this->DeliverOwnMessage(p_msg->clone());
+    }
+    to_be_signed.emplace_back(move(p_msg));
+  }
+
+  // The messages are signed as a batch, then broadcast in the order they were produced
+  m_crypto_pool.SignAll(to_be_signed);
+  for (auto& p_msg: to_be_signed)
+  {
+    m_transport.BroadcastMessage(move(p_msg));
+  }
+  return num_injected_messages;
+}
+
+bool Replica2::IsAddressedToSelf(const messages::Message& msg) const
+{
+  if (msg.type()==MSG_TYPE::ROAST_PRE_SIGNATURE)
+  {
+    // The pre signature goes to all the candidate signers of the session, selected by the coordinator
+    std::vector<uint32_t> signers = static_cast<const messages::RoastPreSignature&>(msg).signers();
+    return std::find(signers.begin(), signers.end(), m_conf.id()) != signers.end();
+  }
+  if (msg.type()==MSG_TYPE::ROAST_SIGNATURE_SHARE)
+  {
+    // The signature share goes to the coordinator, i.e. the primary
+    return this->primary() == m_conf.id();
+  }
+  return false;
+}
 
-      for (auto& p_msg: ready_to_be_sent)
+bool Replica2::IsAddressedToOthers(const messages::Message& msg) const
+{
+  if (msg.type()==MSG_TYPE::ROAST_SIGNATURE_SHARE)
+  {
+    return this->primary() != m_conf.id();
+  }
+  return true;
+}
+
+void Replica2::ApplyActiveActions()
+{
+  state::ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  // We execute the active actions, in the order chosen by the scheduler and up to its budget
+  uint32_t num_applied_actions = 0; uint32_t budget = m_scheduler->budget();
+  while (!m_active_actions.empty() && num_applied_actions<budget)
+  {
+    std::vector<std::shared_ptr<actions::Action>> schedule = m_scheduler->Schedule(m_active_actions);
+    if (m_conf.fbft_batch_apply())
+    {
+      // We apply all the non conflicting actions, the state is refreshed once for the batch.
+      // Earlier actions in the schedule win the conflicts with the later ones
+      schedule.resize(std::min<size_t>(schedule.size(), budget-num_applied_actions));
+      state::BatchStats stats = this->ApplyBatch(schedule);
+      num_applied_actions += stats.applied + stats.failed;
+      if (stats.applied + stats.failed == 0)
       {
-        p_msg->Sign(m_wallet);
-
-        // A special trick needs to be applied for ROAST_PRE_SIGNATURE message
-        // This message is sent by the ROAST coordinator to all the candidate signers of the signature session
-        // In 5FBFT the Primary may be both the ROAST coordinator and signer for that specific session
-        // In that special case, we need to inject the message in the input buffer of the coordinator
-        if (p_msg->type()==MSG_TYPE::ROAST_PRE_SIGNATURE)
-        {
-          unique_ptr<messages::RoastPreSignature> typed_msg = make_unique<messages::RoastPreSignature>( dynamic_cast<messages::RoastPreSignature&>(*p_msg) );
-
-          bool replica_id_found = false;
-          for (uint32_t signer_id : typed_msg->signers())
-          {
-            if (signer_id == m_conf.id())
-            {
-              replica_id_found = true;
-              break;
-            }
-          }
-          if (replica_id_found)
-          {
-            this->m_in_msg_buffer.emplace_back(std::move(typed_msg));
-          }
-        }
-        else if (p_msg->type()==MSG_TYPE::ROAST_SIGNATURE_SHARE)
-        {
-          // Similarly, the ROAST_SIGNATURE_SHARE should be sent to the coordinator only
-          // Here we ship the signature share also to current replica, in case it's the coordinator
-          unique_ptr<messages::RoastSignatureShare> typed_msg = make_unique<messages::RoastSignatureShare>( dynamic_cast<messages::RoastSignatureShare&>(*p_msg) );
-          this->m_in_msg_buffer.emplace_back(std::move(typed_msg));
-        }
-
-        // Actual broadcast
-        m_transport.BroadcastMessage(move(p_msg));
+        break;
       }
     }
+    else
+    {
+      // We apply the first scheduled action
+      this->Apply( *schedule.front() );
+      num_applied_actions += 1;
+    }
+
+    // We broadcast all messages in the output buffer.
+    // In batch mode, messages injected in the input buffer are turned into receive actions right away
+    if (this->BroadcastOutMessages() > 0 && m_conf.fbft_batch_apply())
+    {
+      this->UpdateActiveActions();
+    }
   }
-  if (num_applied_actions == MAX_NUM_APPLIED_ACTIONS)
+
+  bool actions_left = !m_active_actions.empty();
+  if (actions_left && budget == scheduler::ActionScheduler::MAX_BUDGET)
   {
     string error_msg = str(
       boost::format("R%1% exceeded the number of applied actions!")
@@ -165,6 +271,8 @@ void Replica2::ApplyActiveActions()
     // throw(std::runtime_error(error_msg));
     BOOST_LOG_TRIVIAL(error) << error_msg;
   }
+  m_actions_left_to_budget = actions_left && budget < scheduler::ActionScheduler::MAX_BUDGET;
+  m_scheduler->AdaptBudget(num_applied_actions, actions_left);
   BOOST_LOG_TRIVIAL(trace) << str(
     boost::format("R%1% does not have further active actions to apply.")
       % m_conf.id()
@@ -173,10 +281,12 @@ void Replica2::ApplyActiveActions()
 
 void Replica2::CheckTimedActions()
 {
+  state::ReplicaEngine::ThreadGuard engine_guard{*m_engine};
   BOOST_LOG_TRIVIAL(trace) << str(
     boost::format("R%1% cycle start.")
       % m_conf.id()
   );
+  m_last_timed_check = this->current_time();
 
   // Generate requests
   this->GenerateRequests();
@@ -194,44 +304,90 @@ void Replica2::CheckTimedActions()
   );
 }
 
-void Replica2::ReceiveIncomingMessage(std::unique_ptr<messages::Message> msg)
+void Replica2::CollectVerificationCache()
 {
+  // The engine has collected the messages up to the new height, they will not be verified again
+  m_crypto_pool.verification_cache().CollectGarbage(this->h());
+
+  wallet::VerificationCacheMetrics metrics = m_crypto_pool.verification_cache().metrics();
   BOOST_LOG_TRIVIAL(debug) << str(
-    boost::format("R%1% receiving %2% from %3%.")
+    boost::format("R%1% verification cache: size %2%/%3%, hits %4%, misses %5%, evictions %6%.")
       % m_conf.id()
-      % msg->identify()
-      % msg->sender_id()
+      % metrics.size
+      % metrics.capacity
+      % metrics.hits
+      % metrics.misses
+      % metrics.evictions
   );
+}
+
+void Replica2::ReceiveIncomingMessage(std::shared_ptr<const messages::Message> msg)
+{
+  this->ReceiveIncomingMessages({move(msg)});
+}
+
+void Replica2::ReceiveIncomingMessages(const std::vector<std::shared_ptr<const messages::Message>>& msgs)
+{
+  state::ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  for (const auto& msg : msgs)
+  {
+    BOOST_LOG_TRIVIAL(debug) << str(
+      boost::format("R%1% receiving %2% from %3%.")
+        % m_conf.id()
+        % msg->identify()
+        % msg->sender_id()
+    );
+  }
 
   // Generate requests
   this->GenerateRequests();
 
-  if( msg->type()==messages::MSG_TYPE::BLOCK )
+  // Checkpoint messages are not signed, since they are received upon
+  // receipt of a valid (hence signed) block. The others are verified as a batch
+  std::vector<std::shared_ptr<const messages::Message>> signed_msgs;
+  for (const auto& msg : msgs)
   {
-    // Checkpoint messages are not signed, since they are received upon
-    // receipt of a valid (hence signed) block.
-    messages::Block typed_msg{ dynamic_cast<messages::Block&>(*msg) };
-    actions::ReceiveBlock receive_block(m_conf.id(), typed_msg);
-    this->Apply(receive_block);
-
-    // When we receive a block, we return to prevent a replica that is receiving blocks (e.g. resync)
-    // to trigger view changes
+    if (msg->type() != messages::MSG_TYPE::BLOCK)
+    {
+      signed_msgs.emplace_back(msg);
+    }
   }
-  // Here the message is not a block, we check signature
-  else if ( msg->VerifySignatures(m_wallet) )
+  std::vector<bool> valid_signatures = m_crypto_pool.VerifyAll(signed_msgs);
+
+  // The messages enter the state in arrival order
+  bool received_signed_msgs = false;
+  size_t signed_msg_idx = 0;
+  for (const auto& msg : msgs)
   {
-    ReplicaState::ReceiveIncomingMessage(move(msg));
-    // Apply active actions resulting from the received, non-block message
-    this->ApplyActiveActions();
+    if( msg->type()==messages::MSG_TYPE::BLOCK )
+    {
+      auto typed_msg = std::static_pointer_cast<const messages::Block>(msg);
+      actions::ReceiveBlock receive_block(m_conf.id(), typed_msg);
+      this->Apply(receive_block);
+      this->CollectVerificationCache();
+    }
+    else if ( valid_signatures[signed_msg_idx++] )
+    {
+      ReplicaState::ReceiveIncomingMessage(msg);
+      received_signed_msgs = true;
+    }
+    else
+    {
+      BOOST_LOG_TRIVIAL(error) << str(
+        boost::format("R%1% received message %2% from R%3% with invalid signature, discarding.")
+          % m_conf.id()
+          % msg->name()
+          % msg->sender_id()
+      );
+    }
   }
-  else
+
+  // Apply active actions resulting from the received, non-block messages.
+  // When we only receive blocks, we return to prevent a replica that is receiving blocks (e.g. resync)
+  // to trigger view changes
+  if (received_signed_msgs)
   {
-    BOOST_LOG_TRIVIAL(error) << str(
-      boost::format("R%1% received message %2% from R%3% with invalid signature, discarding.")
-        % m_conf.id()
-        % msg->name()
-        % msg->sender_id()
-    );
+    this->ApplyActiveActions();
   }
 
   BOOST_LOG_TRIVIAL(debug) << str(
@@ -8,11 +8,13 @@
 #include "../transport/network.h"
 #include "../wallet/wallet.h"
 
+#include "scheduler/scheduler.h"
 #include "state/state.h"
 
 namespace blockchain = itcoin::blockchain;
 namespace network = itcoin::network;
 namespace wallet = itcoin::wallet;
+namespace scheduler = itcoin::fbft::scheduler;
 namespace state = itcoin::fbft::state;
 
 namespace itcoin {
@@ -33,16 +35,44 @@ class Replica2: public network::NetworkListener, public state::ReplicaState
 
     // Getters
     const uint32_t id() const;
+    const scheduler::ActionScheduler& action_scheduler() const { return *m_scheduler; }
+    const scheduler::RequestHorizon& request_horizon() const { return m_request_horizon; }
+    // Can be called from any thread, e.g. by metrics readers
+    wallet::VerificationCacheMetrics verification_cache_metrics() const { return m_crypto_pool.verification_cache().metrics(); }
+
+    // The earliest time, in seconds since the Epoch, at which CheckTimedActions has something to do:
+    // generating requests, proposing the next request, or sending a VIEW_CHANGE.
+    // The deadlines already handled by the previous CheckTimedActions are left out
+    std::optional<double> NextDeadline() const;
 
     // Operations
-    void ReceiveIncomingMessage(std::unique_ptr<messages::Message> msg);
+    void ReceiveIncomingMessage(std::shared_ptr<const messages::Message> msg);
+    // The signatures are verified in parallel, the valid messages enter the state in arrival order
+    void ReceiveIncomingMessages(const std::vector<std::shared_ptr<const messages::Message>>& msgs);
     void CheckTimedActions();
 
   private:
     network::NetworkTransport& m_transport;
+    std::unique_ptr<scheduler::ActionScheduler> m_scheduler;
+    // Number of requests generated ahead of the current time
+    scheduler::RequestHorizon m_request_horizon;
+    // Verifies the received messages and signs the sent ones
+    wallet::CryptoPool m_crypto_pool;
+    // Time at which the last CheckTimedActions started
+    std::optional<double> m_last_timed_check;
+    // Whether the last ApplyActiveActions stopped at a budget below the maximum one, with actions left
+    bool m_actions_left_to_budget;
 
     void GenerateRequests();
     void ApplyActiveActions();
+    // Drops the verified signatures of the messages collected by the engine
+    void CollectVerificationCache();
+    // Signs and broadcasts the output buffer, returns the number of messages delivered to this replica
+    uint32_t BroadcastOutMessages();
+    // Whether this replica is one of the recipients of a message it sends
+    bool IsAddressedToSelf(const messages::Message& msg) const;
+    // Whether a message this replica sends has to go through the transport
+    bool IsAddressedToOthers(const messages::Message& msg) const;
 };
 
 }
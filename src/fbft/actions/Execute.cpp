@@ -42,16 +42,10 @@ std::vector<std::unique_ptr<actions::Execute>> Execute::BuildActives(
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::Execute>> results{};
   PlTerm Req_digest, V, N, Replica_id{(long) config.id()};
-  PlQuery query("pre_EXECUTE", PlTermv(Req_digest, V, N, Replica_id));
-  while ( query.next_solution() )
-  {
-    actions::Execute action{blockchain, wallet, Replica_id, Req_digest, V, N};
-    std::unique_ptr<actions::Execute> p_action = std::make_unique<actions::Execute>(action);
-    results.emplace_back(move(p_action));
-  }
-  return results;
+  return CollectSolutions<actions::Execute>("pre_EXECUTE", PlTermv(Req_digest, V, N, Replica_id), [&]() {
+    return std::make_unique<actions::Execute>(blockchain, wallet, Replica_id, Req_digest, V, N);
+  });
 }
 
 int Execute::effect() const
@@ -97,7 +91,7 @@ int Execute::effect() const
 
   // Retrieve thre proposed block
   PrePrepare ppp_msg = PrePrepare::FindByV_N_Req(m_replica_id, m_view, m_seq_number, m_request.digest());
-  CBlock proposed_block = ppp_msg.proposed_block();
+  const CBlock& proposed_block = ppp_msg.proposed_block();
   CBlock final_block;
 
   // Cast the wallet to a FROST wallet, otherwise ROAST cannot work
@@ -33,16 +33,10 @@ std::vector<std::unique_ptr<actions::ProcessNewView>> ProcessNewView::BuildActiv
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::ProcessNewView>> results{};
   PlTerm Hi, Nu, Chi, Replica_id{(long) config.id()};
-  PlQuery query("pre_PROCESS_NEW_VIEW", PlTermv(Hi, Nu, Chi, Replica_id));
-  while ( query.next_solution() )
-  {
-    unique_ptr<actions::ProcessNewView> action =
-      std::make_unique<actions::ProcessNewView>(Replica_id, Hi, Nu, Chi);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+  return CollectSolutions<actions::ProcessNewView>("pre_PROCESS_NEW_VIEW", PlTermv(Hi, Nu, Chi, Replica_id), [&]() {
+    return std::make_unique<actions::ProcessNewView>(Replica_id, Hi, Nu, Chi);
+  });
 }
 
 int ProcessNewView::effect() const
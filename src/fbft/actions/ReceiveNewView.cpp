@@ -19,22 +19,32 @@ namespace itcoin {
 namespace fbft {
 namespace actions {
 
-ReceiveNewView::ReceiveNewView(RoastWallet& wallet, uint32_t replica_id, messages::NewView msg):
+ReceiveNewView::ReceiveNewView(RoastWallet& wallet, uint32_t replica_id, std::shared_ptr<const messages::NewView> msg):
 Action(replica_id),
 m_wallet(wallet),
 m_msg(msg)
 {
 };
 
+ReceiveNewView::ReceiveNewView(RoastWallet& wallet, uint32_t replica_id, messages::NewView msg):
+ReceiveNewView(wallet, replica_id, std::make_shared<messages::NewView>(std::move(msg)))
+{
+};
+
 int ReceiveNewView::effect() const
 {
+  // The engine only keeps the hashes of the blocks in Chi, the blocks go to the block store
+  for (const messages::PrePrepare& ppp: m_msg->pre_prepares())
+  {
+    BlockStore::Instance().Put(m_replica_id, ppp.seq_number(), ppp.proposed_block_ptr());
+  }
 
   PlTermv args(
-    PlTerm((long) m_msg.view()),
-    NewView::nu_as_plterm(m_msg.nu()),
-    NewView::chi_as_plterm(m_msg.chi()),
-    PlTerm((long) m_msg.sender_id()),
-    PlString((const char*) m_msg.signature().c_str()),
+    PlTerm((long) m_msg->view()),
+    NewView::nu_as_plterm(m_msg->nu()),
+    NewView::chi_as_plterm(m_msg->chi()),
+    PlTerm((long) m_msg->sender_id()),
+    PlString((const char*) m_msg->signature().c_str()),
     PlTerm((long) m_replica_id)
   );
 
@@ -46,8 +56,8 @@ std::string ReceiveNewView::identify() const
   return str(
     boost::format( "<%1%, V=%2%, Sender=%3%, R=%4%>" )
       % name()
-      % m_msg.view()
-      % m_msg.sender_id()
+      % m_msg->view()
+      % m_msg->sender_id()
       % m_replica_id
   );
 }
@@ -22,7 +22,7 @@ namespace actions {
 
 ReceivePrePrepare::ReceivePrePrepare(uint32_t replica_id, Blockchain& blockchain,
   double current_time, double pre_prepare_time_tolerance_delta,
-  PrePrepare msg)
+  std::shared_ptr<const PrePrepare> msg)
 :
 Action(replica_id),
 m_current_time(current_time),
@@ -33,6 +33,16 @@ m_msg(msg)
 
 };
 
+ReceivePrePrepare::ReceivePrePrepare(uint32_t replica_id, Blockchain& blockchain,
+  double current_time, double pre_prepare_time_tolerance_delta,
+  PrePrepare msg)
+:
+ReceivePrePrepare(replica_id, blockchain, current_time, pre_prepare_time_tolerance_delta,
+  std::make_shared<PrePrepare>(std::move(msg)))
+{
+
+};
+
 int ReceivePrePrepare::effect() const
 {
   /*
@@ -40,7 +50,7 @@ int ReceivePrePrepare::effect() const
    * the signet solution from the check (hence the third parameter set to
    * "false").
    */
-  if(!m_blockchain.TestBlockValidity(m_msg.seq_number(), m_msg.proposed_block(), false))
+  if(!m_blockchain.TestBlockValidity(m_msg->seq_number(), m_msg->proposed_block(), false))
   {
     BOOST_LOG_TRIVIAL(error) << "A received PRE_PREPARE contains an invalid block, and will be ignored!";
     return 0;
@@ -48,13 +58,13 @@ int ReceivePrePrepare::effect() const
 
   // Check that the block has the expected timestamp
   messages::Request req;
-  if (!messages::Request::TryFindByDigest(m_replica_id, m_msg.req_digest(), req))
+  if (!messages::Request::TryFindByDigest(m_replica_id, m_msg->req_digest(), req))
   {
     BOOST_LOG_TRIVIAL(error) << "A received PRE_PREPARE references an unknown request, and will be ignored.";
     return 0;
   }
 
-  if (!m_msg.proposed_block().nTime == req.timestamp())
+  if (!m_msg->proposed_block().nTime == req.timestamp())
   {
     BOOST_LOG_TRIVIAL(error) << "A received PRE_PREPARE has mismatching block and request timestamp, and will be ignored.";
     return 0;
@@ -73,13 +83,16 @@ int ReceivePrePrepare::effect() const
     return 0;
   }
 
+  // The engine only keeps the block hash, the block goes to the block store
+  BlockStore::Instance().Put(m_replica_id, m_msg->seq_number(), m_msg->proposed_block_ptr());
+
   PlTermv args(
-    PlTerm((long) m_msg.view()),
-    PlTerm((long) m_msg.seq_number()),
-    PlString((const char*) m_msg.req_digest().c_str()),
-    PlString((const char*) m_msg.proposed_block_hex().c_str() ),
-    PlTerm((long) m_msg.sender_id()),
-    PlString((const char*) m_msg.signature().c_str()),
+    PlTerm((long) m_msg->view()),
+    PlTerm((long) m_msg->seq_number()),
+    PlString((const char*) m_msg->req_digest().c_str()),
+    PlString((const char*) m_msg->proposed_block_hash().c_str() ),
+    PlTerm((long) m_msg->sender_id()),
+    PlString((const char*) m_msg->signature().c_str()),
     PlTerm((long) m_replica_id)
   );
   return PlCall("effect_RECEIVE_PRE_PREPARE", args);
@@ -90,8 +103,8 @@ std::string ReceivePrePrepare::identify() const
   return str(
     boost::format( "<%1%, V=%2%, N=%3%, R=%4%>" )
       % name()
-      % m_msg.view()
-      % m_msg.seq_number()
+      % m_msg->view()
+      % m_msg->seq_number()
       % m_replica_id
   );
 }
@@ -13,11 +13,11 @@ namespace actions {
 int ReceivePrepare::effect() const
 {
   PlTermv args(
-    PlTerm((long) m_msg.view()),
-    PlTerm((long) m_msg.seq_number()),
-    PlString((const char*) m_msg.req_digest().c_str()),
-    PlTerm((long) m_msg.sender_id()),
-    PlString((const char*) m_msg.signature().c_str()),
+    PlTerm((long) m_msg->view()),
+    PlTerm((long) m_msg->seq_number()),
+    PlString((const char*) m_msg->req_digest().c_str()),
+    PlTerm((long) m_msg->sender_id()),
+    PlString((const char*) m_msg->signature().c_str()),
     PlTerm((long) m_replica_id)
   );
 
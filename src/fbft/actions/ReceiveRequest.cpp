@@ -15,8 +15,8 @@ namespace actions {
 int ReceiveRequest::effect() const
 {
   PlTermv args(
-    PlString((const char*) m_msg.digest().c_str()),
-    PlTerm((long) m_msg.timestamp()),
+    PlString((const char*) m_msg->digest().c_str()),
+    PlTerm((long) m_msg->timestamp()),
     PlTerm((long) m_replica_id)
   );
 
@@ -28,8 +28,8 @@ std::string ReceiveRequest::identify() const
   return str(
     boost::format( "<%1%, T=%2%, H=%3%, R=%4%>" )
       % name()
-      % m_msg.timestamp()
-      % m_msg.height()
+      % m_msg->timestamp()
+      % m_msg->height()
       % m_replica_id
   );
 }
@@ -6,7 +6,10 @@
 #include <boost/format.hpp>
 #include <SWI-cpp.h>
 
+#include "../../blockchain/blockchain.h"
+
 using namespace std;
+using namespace itcoin::blockchain;
 
 namespace messages=itcoin::fbft::messages;
 
@@ -16,14 +19,24 @@ namespace actions {
 
 int ReceiveViewChange::effect() const
 {
+  // The blocks in Qi may be needed to build Chi if this replica becomes the primary
+  for (const messages::view_change_pre_prepared_elem_t& elem: m_msg->qi())
+  {
+    auto block_it = m_msg->qi_blocks().find(get<2>(elem));
+    if (block_it != m_msg->qi_blocks().end())
+    {
+      BlockStore::Instance().Put(m_replica_id, get<0>(elem), block_it->second);
+    }
+  }
+
   PlTermv args(
-    PlTerm((long) m_msg.view()),
-    PlTerm((long) m_msg.hi()),
-    PlString((const char*) m_msg.c().c_str()),
-    m_msg.pi_as_plterm(),
-    m_msg.qi_as_plterm(),
-    PlTerm((long) m_msg.sender_id()),
-    PlString((const char*) m_msg.signature().c_str()),
+    PlTerm((long) m_msg->view()),
+    PlTerm((long) m_msg->hi()),
+    PlString((const char*) m_msg->c().c_str()),
+    m_msg->pi_as_plterm(),
+    m_msg->qi_as_plterm(),
+    PlTerm((long) m_msg->sender_id()),
+    PlString((const char*) m_msg->signature().c_str()),
     PlTerm((long) m_replica_id)
   );
 
@@ -35,8 +48,8 @@ std::string ReceiveViewChange::identify() const
   return str(
     boost::format( "<%1%, S=%2%, V=%3%, R=%4%>" )
       % name()
-      % m_msg.sender_id()
-      % m_msg.view()
+      % m_msg->sender_id()
+      % m_msg->view()
       % m_replica_id
   );
 }
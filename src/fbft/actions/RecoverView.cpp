@@ -37,17 +37,11 @@ std::vector<std::unique_ptr<actions::RecoverView>> RecoverView::BuildActives(
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::RecoverView>> results{};
   PlTerm V, Replica_id{(long) config.id()};
-  PlQuery query("pre_RECOVER_VIEW", PlTermv(Replica_id, V));
-  while ( query.next_solution() )
-  {
+  return CollectSolutions<actions::RecoverView>("pre_RECOVER_VIEW", PlTermv(Replica_id, V), [&]() {
     uint32_t v = (long) V;
-    std::unique_ptr<actions::RecoverView> action =
-      std::make_unique<actions::RecoverView>(config.id(), v);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+    return std::make_unique<actions::RecoverView>(config.id(), v);
+  });
 }
 
 int RecoverView::effect() const
@@ -61,16 +61,10 @@ std::vector<std::unique_ptr<actions::RoastInit>> RoastInit::BuildActives(
   wallet::RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::RoastInit>> results{};
   PlTerm Req_digest, V, N, Replica_id{(long) config.id()};
-  PlQuery query("pre_ROAST_INIT", PlTermv(Replica_id, Req_digest, V, N));
-  while ( query.next_solution() )
-  {
-    actions::RoastInit action{Replica_id, Req_digest, V, N};
-    std::unique_ptr<actions::RoastInit> p_action = std::make_unique<actions::RoastInit>(action);
-    results.emplace_back(move(p_action));
-  }
-  return results;
+  return CollectSolutions<actions::RoastInit>("pre_ROAST_INIT", PlTermv(Replica_id, Req_digest, V, N), [&]() {
+    return std::make_unique<actions::RoastInit>(Replica_id, Req_digest, V, N);
+  });
 }
 
 }
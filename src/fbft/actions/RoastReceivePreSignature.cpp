@@ -19,12 +19,18 @@ namespace itcoin {
 namespace fbft {
 namespace actions {
 
-RoastReceivePreSignature::RoastReceivePreSignature(wallet::RoastWallet& wallet, uint32_t replica_id, messages::RoastPreSignature msg):
+RoastReceivePreSignature::RoastReceivePreSignature(wallet::RoastWallet& wallet, uint32_t replica_id, std::shared_ptr<const messages::RoastPreSignature> msg):
 Action(replica_id), m_wallet(wallet), m_msg(msg)
 {
 
 };
 
+RoastReceivePreSignature::RoastReceivePreSignature(wallet::RoastWallet& wallet, uint32_t replica_id, messages::RoastPreSignature msg):
+RoastReceivePreSignature(wallet, replica_id, std::make_shared<messages::RoastPreSignature>(std::move(msg)))
+{
+
+};
+
 RoastReceivePreSignature::~RoastReceivePreSignature()
 {
 
@@ -54,7 +60,7 @@ int RoastReceivePreSignature::effect() const
   }
 
   bool replica_id_found = false;
-  for (uint32_t signer_id : m_msg.signers())
+  for (uint32_t signer_id : m_msg->signers())
   {
     if (signer_id == m_replica_id)
     {
@@ -64,13 +70,13 @@ int RoastReceivePreSignature::effect() const
   }
 
   if ( replica_id_found ) {
-    string signature_share = m_wallet.GetSignatureShare(m_msg.signers(), m_msg.pre_signature(), block_to_sign);
+    string signature_share = m_wallet.GetSignatureShare(m_msg->signers(), m_msg->pre_signature(), block_to_sign);
     string next_pre_sig_share = m_wallet.GetPreSignatureShare();
 
     PlTermv args(
       PlTerm((long) m_replica_id),
-      m_msg.signers_as_plterm(),
-      PlString((const char*) m_msg.pre_signature().c_str()),
+      m_msg->signers_as_plterm(),
+      PlString((const char*) m_msg->pre_signature().c_str()),
       PlString((const char*) signature_share.c_str()),
       PlString((const char*) next_pre_sig_share.c_str())
     );
@@ -92,7 +98,7 @@ std::string RoastReceivePreSignature::identify() const
   return str(
     boost::format( "<%1%, msg=%2%, R=%3%>" )
       % name()
-      % m_msg.identify()
+      % m_msg->identify()
       % m_replica_id
   );
 }
@@ -38,16 +38,10 @@ std::vector<std::unique_ptr<actions::SendCommit>> SendCommit::BuildActives(
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::SendCommit>> results{};
   PlTerm Req_digest, V, N, Replica_id{(long) config.id()};
-  PlQuery query("pre_SEND_COMMIT", PlTermv(Req_digest, V, N, Replica_id));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<actions::SendCommit> p_action =
-      std::make_unique<actions::SendCommit>(wallet, Replica_id, Req_digest, V, N);
-    results.emplace_back(move(p_action));
-  }
-  return results;
+  return CollectSolutions<actions::SendCommit>("pre_SEND_COMMIT", PlTermv(Req_digest, V, N, Replica_id), [&]() {
+    return std::make_unique<actions::SendCommit>(wallet, Replica_id, Req_digest, V, N);
+  });
 }
 
 int SendCommit::effect() const
@@ -26,19 +26,12 @@ std::vector<std::unique_ptr<actions::SendNewView>> SendNewView::BuildActives(
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::SendNewView>> results{};
   PlTerm Nu, Chi, Replica_id{(long) config.id()};
-  PlQuery query("pre_SEND_NEW_VIEW", PlTermv(Nu, Chi, Replica_id));
-  while ( query.next_solution() )
-  {
+  return CollectSolutions<actions::SendNewView>("pre_SEND_NEW_VIEW", PlTermv(Nu, Chi, Replica_id), [&]() {
     auto nu = NewView::nu_from_plterm(Nu);
     auto chi = NewView::chi_from_plterm(Chi);
-
-    unique_ptr<SendNewView> action =
-      std::make_unique<SendNewView>(config.id(), nu, chi);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+    return std::make_unique<actions::SendNewView>(config.id(), nu, chi);
+  });
 }
 
 int SendNewView::effect() const
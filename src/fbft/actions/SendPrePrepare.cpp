@@ -7,6 +7,9 @@
 #include <boost/log/trivial.hpp>
 #include <SWI-cpp.h>
 
+#include <serialize.h>
+#include <version.h>
+
 #include "../../blockchain/blockchain.h"
 #include "../../wallet/wallet.h"
 #include "config/FbftConfig.h"
@@ -21,8 +24,9 @@ namespace fbft {
 namespace actions {
 
 SendPrePrepare::SendPrePrepare(Blockchain& blockchain,
-PlTerm Replica_id, PlTerm Req_digest, PlTerm V, PlTerm N)
-: Action(Replica_id), m_blockchain(blockchain)
+PlTerm Replica_id, PlTerm Req_digest, PlTerm V, PlTerm N,
+std::optional<std::string> parent_block_hash)
+: Action(Replica_id), m_blockchain(blockchain), m_parent_block_hash(parent_block_hash)
 {
   m_view = (long) V;
   m_seq_number = (long) N;
@@ -38,17 +42,32 @@ std::vector<std::unique_ptr<actions::SendPrePrepare>> SendPrePrepare::BuildActiv
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::SendPrePrepare>> results{};
   PlTerm Req_digest, V, N, Replica_id{(long) config.id()};
-  PlQuery query("pre_SEND_PRE_PREPARE", PlTermv(Req_digest, V, N, Replica_id));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<actions::SendPrePrepare> action =
-      std::make_unique<actions::SendPrePrepare>(blockchain,
-      Replica_id, Req_digest, V, N);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+  PlTerm H;
+  PlCall("get_h", PlTermv(Replica_id, H));
+  uint32_t h = (long) H;
+
+  return CollectSolutions<actions::SendPrePrepare>("pre_SEND_PRE_PREPARE", PlTermv(Req_digest, V, N, Replica_id), [&]() {
+    // Above h+1, the block builds on the one this primary proposed for the previous height
+    std::optional<std::string> parent_block_hash = std::nullopt;
+    if ((uint32_t) (long) N > h+1)
+    {
+      if (!blockchain.CanGenerateOnPendingBlock())
+      {
+        return std::unique_ptr<actions::SendPrePrepare>();
+      }
+      PlTerm Parent_block_hash;
+      PlTermv parent_args(Replica_id, V, PlTerm((long) N - 1), PlTerm(), Parent_block_hash, Replica_id, PlTerm());
+      if (!PlCall("msg_log_pre_prepare", parent_args))
+      {
+        return std::unique_ptr<actions::SendPrePrepare>();
+      }
+      parent_block_hash = (char*) Parent_block_hash;
+    }
+
+    return std::make_unique<actions::SendPrePrepare>(blockchain,
+      Replica_id, Req_digest, V, N, parent_block_hash);
+  });
 }
 
 int SendPrePrepare::effect() const
@@ -57,7 +76,19 @@ int SendPrePrepare::effect() const
   CBlock proposed_block;
   try
   {
-    proposed_block = m_blockchain.GenerateBlock( m_request.timestamp() );
+    if (m_parent_block_hash.has_value())
+    {
+      std::shared_ptr<const CBlock> p_parent_block = BlockStore::Instance().Get(m_parent_block_hash.value());
+      if (!p_parent_block)
+      {
+        throw std::runtime_error("the block proposed for the previous height is not in the block store");
+      }
+      proposed_block = m_blockchain.GenerateBlockOnTopOf( m_seq_number, m_request.timestamp(), *p_parent_block );
+    }
+    else
+    {
+      proposed_block = m_blockchain.GenerateBlock( m_request.timestamp() );
+    }
   }
   catch(const std::runtime_error& e)
   {
@@ -69,8 +100,7 @@ int SendPrePrepare::effect() const
     return 0;
   }
 
-  const auto block_ser = HexSerializableCBlock(proposed_block);
-  const uint32_t block_size_bytes = block_ser.GetHex().length() / 2;
+  const uint32_t block_size_bytes = ::GetSerializeSize(proposed_block, PROTOCOL_VERSION);
   const std::string block_hash = proposed_block.GetBlockHeader().GetHash().ToString();
 
   BOOST_LOG_TRIVIAL(debug) << str(
@@ -81,13 +111,14 @@ int SendPrePrepare::effect() const
   );
 
   // Now the PrePrepare is ready to be sent, we can save it into the message store
+  // The engine only keeps the block hash, the block goes to the block store
   messages::PrePrepare msg(m_replica_id,
     m_view, m_seq_number, m_request.digest().c_str(),
-    proposed_block);
+    BlockStore::Instance().Put(m_replica_id, m_seq_number, proposed_block));
 
   PlTermv args(
     PlString((const char*) m_request.digest().c_str()),
-    PlString((const char*) msg.proposed_block_hex().c_str()),
+    PlString((const char*) msg.proposed_block_hash().c_str()),
     PlTerm((long) m_view),
     PlTerm((long) m_seq_number),
     PlTerm((long) m_replica_id)
@@ -37,16 +37,10 @@ std::vector<std::unique_ptr<actions::SendPrepare>> SendPrepare::BuildActives(
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::SendPrepare>> results{};
   PlTerm Req_digest, V, N, Replica_id{(long) config.id()};
-  PlQuery query("pre_SEND_PREPARE", PlTermv(Req_digest, V, N, Replica_id));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<actions::SendPrepare> action =
-      std::make_unique<actions::SendPrepare>(Replica_id, Req_digest, V, N);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+  return CollectSolutions<actions::SendPrepare>("pre_SEND_PREPARE", PlTermv(Req_digest, V, N, Replica_id), [&]() {
+    return std::make_unique<actions::SendPrepare>(Replica_id, Req_digest, V, N);
+  });
 }
 
 int SendPrepare::effect() const
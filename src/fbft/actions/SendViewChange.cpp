@@ -26,17 +26,11 @@ std::vector<std::unique_ptr<actions::SendViewChange>> SendViewChange::BuildActiv
   RoastWallet& wallet
 )
 {
-  std::vector<unique_ptr<actions::SendViewChange>> results{};
   PlTerm V, Replica_id{(long) config.id()};
-  PlQuery query("pre_SEND_VIEW_CHANGE", PlTermv(V, Replica_id));
-  while ( query.next_solution() )
-  {
+  return CollectSolutions<actions::SendViewChange>("pre_SEND_VIEW_CHANGE", PlTermv(V, Replica_id), [&]() {
     uint32_t v = (long) V;
-    std::unique_ptr<actions::SendViewChange> action =
-      std::make_unique<actions::SendViewChange>(config.id(), v);
-    results.emplace_back(std::move(action));
-  }
-  return results;
+    return std::make_unique<actions::SendViewChange>(config.id(), v);
+  });
 }
 
 int SendViewChange::effect() const
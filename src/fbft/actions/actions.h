@@ -102,7 +102,8 @@ class Execute : public Action {
     ~Execute() {};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::EXECUTE; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::EXECUTE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -124,7 +125,8 @@ class ProcessNewView: public Action {
     ~ProcessNewView() {};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::PROCESS_NEW_VIEW; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::PROCESS_NEW_VIEW;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -137,77 +139,90 @@ class ProcessNewView: public Action {
     messages::new_view_chi_t m_chi;
 };
 
+// The receive actions share the received message with the input buffer of the replica, rather than owning a copy.
+// The constructors taking a message by value are meant for the messages built in place, e.g. in the tests.
 class ReceiveBlock : public Action {
   public:
-    ReceiveBlock(uint32_t replica_id, messages::Block msg):Action(replica_id), m_msg(msg){};
+    ReceiveBlock(uint32_t replica_id, std::shared_ptr<const messages::Block> msg): Action(replica_id), m_msg(msg){};
+    ReceiveBlock(uint32_t replica_id, messages::Block msg): ReceiveBlock(replica_id, std::make_shared<messages::Block>(std::move(msg))){};
     ~ReceiveBlock() {};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_BLOCK; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_BLOCK;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::Block m_msg;
+    std::shared_ptr<const messages::Block> m_msg;
 };
 
 class ReceiveCommit : public Action {
   public:
-    ReceiveCommit(uint32_t replica_id, messages::Commit msg):Action(replica_id), m_msg(msg){};
+    ReceiveCommit(uint32_t replica_id, std::shared_ptr<const messages::Commit> msg): Action(replica_id), m_msg(msg){};
+    ReceiveCommit(uint32_t replica_id, messages::Commit msg): ReceiveCommit(replica_id, std::make_shared<messages::Commit>(std::move(msg))){};
     ~ReceiveCommit() {};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_COMMIT; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_COMMIT;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::Commit m_msg;
+    std::shared_ptr<const messages::Commit> m_msg;
 };
 
 class ReceiveNewView : public Action {
   public:
+    ReceiveNewView(wallet::RoastWallet& wallet, uint32_t replica_id, std::shared_ptr<const messages::NewView> msg);
     ReceiveNewView(wallet::RoastWallet& wallet, uint32_t replica_id, messages::NewView msg);
     ~ReceiveNewView() {};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_NEW_VIEW; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_NEW_VIEW;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
     wallet::RoastWallet& m_wallet;
 
-    messages::NewView m_msg;
+    std::shared_ptr<const messages::NewView> m_msg;
 };
 
 class ReceivePrepare : public Action {
   public:
-    ReceivePrepare(uint32_t replica_id, messages::Prepare msg): Action(replica_id), m_msg(msg){};;
+    ReceivePrepare(uint32_t replica_id, std::shared_ptr<const messages::Prepare> msg): Action(replica_id), m_msg(msg){};
+    ReceivePrepare(uint32_t replica_id, messages::Prepare msg): ReceivePrepare(replica_id, std::make_shared<messages::Prepare>(std::move(msg))){};
     ~ReceivePrepare() {};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_PREPARE; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_PREPARE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::Prepare m_msg;
+    std::shared_ptr<const messages::Prepare> m_msg;
 };
 
 class ReceivePrePrepare : public Action {
   public:
+    ReceivePrePrepare(uint32_t replica_id, blockchain::Blockchain& blockchain,
+      double current_time, double pre_prepare_time_tolerance_delta, std::shared_ptr<const messages::PrePrepare> msg);
     ReceivePrePrepare(uint32_t replica_id, blockchain::Blockchain& blockchain,
       double current_time, double pre_prepare_time_tolerance_delta, messages::PrePrepare msg);
     ~ReceivePrePrepare(){};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_PRE_PREPARE; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_PRE_PREPARE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -215,37 +230,41 @@ class ReceivePrePrepare : public Action {
     blockchain::Blockchain& m_blockchain;
     double m_current_time;
     double m_pre_prepare_time_tolerance_delta;
-    messages::PrePrepare m_msg;
+    std::shared_ptr<const messages::PrePrepare> m_msg;
 };
 
 class ReceiveRequest : public Action {
   public:
-    ReceiveRequest(uint32_t replica_id, messages::Request request): Action(replica_id), m_msg(request){};
+    ReceiveRequest(uint32_t replica_id, std::shared_ptr<const messages::Request> msg): Action(replica_id), m_msg(msg){};
+    ReceiveRequest(uint32_t replica_id, messages::Request msg): ReceiveRequest(replica_id, std::make_shared<messages::Request>(std::move(msg))){};
     ~ReceiveRequest(){};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_REQUEST; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_REQUEST;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::Request m_msg;
+    std::shared_ptr<const messages::Request> m_msg;
 };
 
 class ReceiveViewChange : public Action {
   public:
-    ReceiveViewChange(uint32_t replica_id, messages::ViewChange msg): Action(replica_id), m_msg(msg){};
+    ReceiveViewChange(uint32_t replica_id, std::shared_ptr<const messages::ViewChange> msg): Action(replica_id), m_msg(msg){};
+    ReceiveViewChange(uint32_t replica_id, messages::ViewChange msg): ReceiveViewChange(replica_id, std::make_shared<messages::ViewChange>(std::move(msg))){};
     ~ReceiveViewChange(){};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::RECEIVE_VIEW_CHANGE; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECEIVE_VIEW_CHANGE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::ViewChange m_msg;
+    std::shared_ptr<const messages::ViewChange> m_msg;
 };
 
 class RecoverView: public Action {
@@ -254,7 +273,8 @@ class RecoverView: public Action {
     ~RecoverView();
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::RECOVER_VIEW; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::RECOVER_VIEW;
+    ACTION_TYPE type() const { return TYPE; }
     int effect() const;
 
     static std::vector<std::unique_ptr<actions::RecoverView>> BuildActives(const itcoin::FbftConfig& config,
@@ -271,7 +291,8 @@ class SendCommit : public Action {
     ~SendCommit(){};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::SEND_COMMIT; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::SEND_COMMIT;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -295,7 +316,8 @@ class SendNewView : public Action {
     ~SendNewView(){};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::SEND_NEW_VIEW; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::SEND_NEW_VIEW;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -313,7 +335,8 @@ class SendPrepare : public Action {
     ~SendPrepare(){};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::SEND_PREPARE; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::SEND_PREPARE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -329,11 +352,13 @@ class SendPrepare : public Action {
 class SendPrePrepare : public Action {
   public:
     SendPrePrepare(blockchain::Blockchain& blockchain,
-      PlTerm Replica_id, PlTerm Req_digest, PlTerm V, PlTerm N);
+      PlTerm Replica_id, PlTerm Req_digest, PlTerm V, PlTerm N,
+      std::optional<std::string> parent_block_hash = std::nullopt);
     ~SendPrePrepare(){};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::SEND_PRE_PREPARE; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::SEND_PRE_PREPARE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -346,6 +371,8 @@ class SendPrePrepare : public Action {
     messages::Request m_request;
     uint32_t m_view;
     uint32_t m_seq_number;
+    // Set when the previous height is not on the chain yet, it is the block proposed for it
+    std::optional<std::string> m_parent_block_hash;
 };
 
 class SendViewChange : public Action {
@@ -354,7 +381,8 @@ class SendViewChange : public Action {
     ~SendViewChange(){};
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::SEND_VIEW_CHANGE; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::SEND_VIEW_CHANGE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -375,7 +403,8 @@ class RoastInit : public Action {
     ~RoastInit();
 
     std::string identify() const;
-    ACTION_TYPE type() const { return ACTION_TYPE::ROAST_INIT; }
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::ROAST_INIT;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
@@ -385,35 +414,63 @@ class RoastInit : public Action {
 
 class RoastReceivePreSignature : public Action {
   public:
+    RoastReceivePreSignature(wallet::RoastWallet& wallet, uint32_t replica_id, std::shared_ptr<const messages::RoastPreSignature> msg);
     RoastReceivePreSignature(wallet::RoastWallet& wallet, uint32_t replica_id, messages::RoastPreSignature msg);
     ~RoastReceivePreSignature();
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::ROAST_RECEIVE_PRE_SIGNATURE; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::ROAST_RECEIVE_PRE_SIGNATURE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
     wallet::RoastWallet& m_wallet;
-    messages::RoastPreSignature m_msg;
+    std::shared_ptr<const messages::RoastPreSignature> m_msg;
 };
 
 class RoastReceiveSignatureShare : public Action {
   public:
-    RoastReceiveSignatureShare(uint32_t replica_id, messages::RoastSignatureShare msg):Action(replica_id), m_msg(msg){};
+    RoastReceiveSignatureShare(uint32_t replica_id, std::shared_ptr<const messages::RoastSignatureShare> msg): Action(replica_id), m_msg(msg){};
+    RoastReceiveSignatureShare(uint32_t replica_id, messages::RoastSignatureShare msg): RoastReceiveSignatureShare(replica_id, std::make_shared<messages::RoastSignatureShare>(std::move(msg))){};
     ~RoastReceiveSignatureShare() {};
 
     std::string identify() const;
-    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) m_msg);}
-    ACTION_TYPE type() const { return ACTION_TYPE::ROAST_RECEIVE_SIGNATURE_SHARE; }
+    std::optional<std::reference_wrapper<const messages::Message>> message() const {return std::optional<std::reference_wrapper<const messages::Message>>((const messages::Message&) *m_msg);}
+    static constexpr ACTION_TYPE TYPE = ACTION_TYPE::ROAST_RECEIVE_SIGNATURE_SHARE;
+    ACTION_TYPE type() const { return TYPE; }
 
     int effect() const;
 
   private:
-    messages::RoastSignatureShare m_msg;
+    std::shared_ptr<const messages::RoastSignatureShare> m_msg;
 };
 
+// Compile-time list of action types, the registry generates the per-type code the engine needs
+template<typename... Ts>
+struct ActionRegistry {
+  // Builds the active actions of the given type, none if the type is not in the registry
+  static std::vector<std::unique_ptr<Action>> BuildActives(ACTION_TYPE type,
+    const itcoin::FbftConfig& config, blockchain::Blockchain& blockchain, wallet::RoastWallet& wallet)
+  {
+    std::vector<std::unique_ptr<Action>> results{};
+    auto append = [&results](auto&& typed_actions) {
+      for (auto& p_action : typed_actions)
+      {
+        results.emplace_back(std::move(p_action));
+      }
+    };
+    ( (type == Ts::TYPE && (append(Ts::BuildActives(config, blockchain, wallet)), true)) || ... );
+    return results;
+  }
+};
+
+// The actions whose preconditions are evaluated by the engine, receive actions are built
+// by the ReplicaState from its input buffer
+typedef ActionRegistry<Execute, SendCommit, SendPrepare, SendPrePrepare, SendViewChange,
+  RecoverView, SendNewView, ProcessNewView, RoastInit> StateActions;
+
 }
 }
 }
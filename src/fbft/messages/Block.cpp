@@ -36,7 +36,7 @@ bool Block::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> Block::clone()
+std::unique_ptr<Message> Block::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<Block>(*this);
   return msg;
@@ -52,6 +52,11 @@ std::string Block::identify() const
   );
 }
 
+message_key_t Block::key() const
+{
+  return message_key_t(type(), m_sender_id, std::nullopt, m_block_height, m_block_hash);
+}
+
 }
 }
 }
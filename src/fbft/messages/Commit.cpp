@@ -45,15 +45,10 @@ Commit::~Commit()
 
 std::vector<std::unique_ptr<messages::Commit>> Commit::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::Commit>> results{};
   PlTerm Replica_id{(long) replica_id}, V, N, Block_signature;
-  PlQuery query("msg_out_commit", PlTermv(Replica_id, V, N, Block_signature));
-  while ( query.next_solution() )
-  {
-    messages::Commit msg{Replica_id, V, N, Block_signature};
-    results.emplace_back(std::move(std::make_unique<messages::Commit>(msg)));
-  }
-  return results;
+  return CollectSolutions<messages::Commit>("msg_out_commit", PlTermv(Replica_id, V, N, Block_signature), [&]() {
+    return std::make_unique<messages::Commit>(Replica_id, V, N, Block_signature);
+  });
 }
 
 std::vector<messages::Commit> Commit::FindByV_N(uint32_t replica_id, uint32_t v, uint32_t n)
@@ -84,13 +79,23 @@ bool Commit::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> Commit::clone()
+std::unique_ptr<Message> Commit::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<Commit>(*this);
   return msg;
 }
 
-const std::string Commit::digest() const
+std::string Commit::NativeDigest() const
+{
+  return DigestWriter(type())
+    .Write(m_view)
+    .Write(m_seq_number)
+    .Write(m_pre_signature)
+    .Write(m_sender_id)
+    .GetHex();
+}
+
+std::string Commit::PrologDigest() const
 {
   PlTerm Digest;
   int pl_ok = PlCall("digest_commit", PlTermv(
@@ -0,0 +1,103 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "messages.h"
+
+#include <atomic>
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+
+#include <crypto/sha256.h>
+#include <util/strencodings.h>
+
+using namespace std;
+
+namespace itcoin {
+namespace fbft {
+namespace messages {
+
+namespace {
+  // Written once at startup, read by the replicas from their own threads
+  std::atomic<DIGEST_SCHEME> g_digest_scheme{DIGEST_SCHEME::PROLOG};
+}
+
+DIGEST_SCHEME digest_scheme()
+{
+  return g_digest_scheme;
+}
+
+DIGEST_SCHEME digest_scheme_from_string(const std::string& scheme_name)
+{
+  if (scheme_name == DIGEST_SCHEME_AS_STRING[static_cast<unsigned int>(DIGEST_SCHEME::PROLOG)])
+  {
+    return DIGEST_SCHEME::PROLOG;
+  }
+  else if (scheme_name == DIGEST_SCHEME_AS_STRING[static_cast<unsigned int>(DIGEST_SCHEME::NATIVE)])
+  {
+    return DIGEST_SCHEME::NATIVE;
+  }
+  string error_msg = str(
+    boost::format("Unknown digest scheme %1%")
+      % scheme_name
+  );
+  throw(std::runtime_error(error_msg));
+}
+
+void set_digest_scheme(DIGEST_SCHEME scheme)
+{
+  g_digest_scheme = scheme;
+
+  // The engine computes the VIEW_CHANGE digests referenced by NEW_VIEW messages,
+  // they must match ViewChange::digest()
+  PlCall("retractall", PlTermv(PlCompound("digest_view_change_hook(_, _, _, _, _, _, _)")));
+  if (scheme == DIGEST_SCHEME::NATIVE)
+  {
+    PlCall("assertz", PlTermv(PlCompound(
+      "(digest_view_change_hook(V, Hi, C, Pi, Qi, Sender_id, Digest) :- digest_view_change_native(V, Hi, C, Pi, Qi, Sender_id, Digest))"
+    )));
+  }
+
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("Message digests use the %1% scheme")
+      % DIGEST_SCHEME_AS_STRING[static_cast<unsigned int>(scheme)]
+  );
+}
+
+DigestWriter::DigestWriter(unsigned int msg_type)
+{
+  Write(static_cast<uint32_t>(msg_type));
+}
+
+DigestWriter& DigestWriter::Write(uint32_t value)
+{
+  for (int i=0; i<4; i++)
+  {
+    m_buffer.push_back(static_cast<unsigned char>(value >> (8*i)));
+  }
+  return *this;
+}
+
+DigestWriter& DigestWriter::Write(const std::string& value)
+{
+  Write(static_cast<uint32_t>(value.size()));
+  m_buffer.insert(m_buffer.end(), value.begin(), value.end());
+  return *this;
+}
+
+std::string DigestWriter::GetHex() const
+{
+  unsigned char hash[CSHA256::OUTPUT_SIZE];
+  CSHA256().Write(m_buffer.data(), m_buffer.size()).Finalize(hash);
+  return HexStr(hash);
+}
+
+}
+}
+}
+
+// digest_view_change_native(V, Hi, C, Pi, Qi, Sender_id, Digest)
+PREDICATE(digest_view_change_native, 7) {
+  itcoin::fbft::messages::ViewChange msg(PL_A6, PL_A1, PL_A2, PL_A3, PL_A4, PL_A5);
+  return PL_A7 = PlString((const char*) msg.digest().c_str());
+}
@@ -49,7 +49,33 @@ std::optional<uint32_t> Message::seq_number_as_opt() const
   return std::nullopt;
 }
 
+std::optional<uint32_t> Message::view_as_opt() const
+{
+  return std::nullopt;
+}
+
+message_key_t Message::key() const
+{
+  return message_key_t(type(), m_sender_id, view_as_opt(), seq_number_as_opt(), digest());
+}
+
 const std::string Message::digest() const
+{
+  DIGEST_SCHEME scheme = digest_scheme();
+  if (!m_digest.has_value() || m_digest_scheme != scheme)
+  {
+    m_digest = scheme == DIGEST_SCHEME::NATIVE ? NativeDigest() : PrologDigest();
+    m_digest_scheme = scheme;
+  }
+  return m_digest.value();
+}
+
+std::string Message::NativeDigest() const
+{
+  throw(std::runtime_error("Message::digest() not available for message type: "+name()));
+}
+
+std::string Message::PrologDigest() const
 {
   throw(std::runtime_error("Message::digest() not available for message type: "+name()));
 }
@@ -79,7 +105,7 @@ void Message::Sign(const Wallet& wallet)
   wallet.AppendSignature(*this);
 }
 
-bool Message::VerifySignatures(const Wallet& wallet)
+bool Message::VerifySignatures(const Wallet& wallet) const
 {
   return wallet.VerifySignature(*this);
 }
@@ -120,9 +146,9 @@ std::string Message::ToBinBuffer() const
   throw(std::runtime_error("Message::ToBinBuffer() not available for message type: "+name()));
 }
 
-optional<unique_ptr<Message>> Message::BuildFromBinBuffer(const std::string& bin_buffer)
+optional<shared_ptr<const Message>> Message::BuildFromBinBuffer(const std::string& bin_buffer)
 {
-  optional<unique_ptr<Message>> result = nullopt;
+  optional<shared_ptr<const Message>> result = nullopt;
 
   Json::Reader reader;
   Json::Value root;
@@ -138,33 +164,10 @@ optional<unique_ptr<Message>> Message::BuildFromBinBuffer(const std::string& bin
   else
   {
     uint32_t msg_type = root["payload"]["type"].asUInt();
-    if (msg_type == MSG_TYPE::COMMIT)
-    {
-      result = make_unique<Commit>(root);
-    }
-    else if (msg_type == MSG_TYPE::NEW_VIEW)
-    {
-      result = make_unique<NewView>(root);
-    }
-    else if (msg_type == MSG_TYPE::PREPARE)
-    {
-      result = make_unique<Prepare>(root);
-    }
-    else if (msg_type == MSG_TYPE::PRE_PREPARE)
-    {
-      result = make_unique<PrePrepare>(root);
-    }
-    else if (msg_type == MSG_TYPE::VIEW_CHANGE)
-    {
-      result = make_unique<ViewChange>(root);
-    }
-    else if (msg_type == MSG_TYPE::ROAST_SIGNATURE_SHARE)
-    {
-      result = make_unique<RoastSignatureShare>(root);
-    }
-    else if (msg_type == MSG_TYPE::ROAST_PRE_SIGNATURE)
+    std::shared_ptr<const Message> p_msg = ReplicaMessages::BuildFromJson(msg_type, root);
+    if (p_msg != nullptr)
     {
-      result = make_unique<RoastPreSignature>(root);
+      result = p_msg;
     }
     else
     {
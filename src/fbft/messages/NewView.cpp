@@ -57,13 +57,13 @@ NewView::NewView(PlTerm Sender_id, PlTerm V, PlTerm Nu, PlTerm Chi)
   {
     uint32_t chi_n = get<0>(chi_elem);
     std::string chi_digest{  get<1>(chi_elem) };
-    std::string chi_block{ get<2>(chi_elem) };
+    std::string chi_block_hash{ get<2>(chi_elem) };
 
     // Further elements of chi propagate prepared requests from one view to the other
     PrePrepare ppp = PrePrepare(
       PlTerm((long) m_sender_id), PlTerm((long) m_view), PlTerm((long) chi_n),
       PlString((const char*) chi_digest.c_str()),
-      PlString((const char*) chi_block.c_str())
+      PlString((const char*) chi_block_hash.c_str())
     );
     m_ppp_messages.emplace_back(ppp);
   }
@@ -75,17 +75,10 @@ NewView::~NewView()
 
 std::vector<std::unique_ptr<messages::NewView>> NewView::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::NewView>> results{};
   PlTerm Replica_id{(long) replica_id}, V, Nu, Chi;
-  PlQuery query("msg_out_new_view", PlTermv(Replica_id, V, Nu, Chi));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<messages::NewView> msg = std::make_unique<messages::NewView>(
-      Replica_id, V, Nu, Chi
-    );
-    results.emplace_back(std::move(msg));
-  }
-  return results;
+  return CollectSolutions<messages::NewView>("msg_out_new_view", PlTermv(Replica_id, V, Nu, Chi), [&]() {
+    return std::make_unique<messages::NewView>(Replica_id, V, Nu, Chi);
+  });
 }
 
 new_view_nu_t NewView::nu_from_plterm(PlTerm Nu)
@@ -189,17 +182,23 @@ new_view_nu_t NewView::nu() const
 new_view_chi_t NewView::chi() const
 {
   new_view_chi_t result;
-  for (messages::PrePrepare elem: m_ppp_messages)
+  for (const messages::PrePrepare& elem: m_ppp_messages)
   {
     uint32_t n = elem.seq_number();
     string digest = elem.req_digest();
-    string prepared_block = elem.proposed_block_hex();
-    result.emplace_back(make_tuple(n, digest, prepared_block));
+    string prepared_block_hash = elem.proposed_block_hash();
+    result.emplace_back(make_tuple(n, digest, prepared_block_hash));
   }
   return result;
 }
 
 void NewView::Sign(const RoastWallet& wallet)
+{
+  this->SignViewChanges(wallet);
+  wallet.AppendSignature(*this);
+}
+
+void NewView::SignViewChanges(const Wallet& wallet)
 {
   // Sign the view change messages not having a signature
   for(auto& vc: m_vc_messages)
@@ -209,11 +208,9 @@ void NewView::Sign(const RoastWallet& wallet)
       wallet.AppendSignature(vc);
     }
   }
-
-  wallet.AppendSignature(*this);
 }
 
-bool NewView::VerifySignatures(const RoastWallet& wallet)
+bool NewView::VerifySignatures(const RoastWallet& wallet) const
 {
   bool result = true;
   for (const messages::ViewChange& vc: m_vc_messages)
@@ -241,19 +238,43 @@ bool NewView::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> NewView::clone()
+std::unique_ptr<Message> NewView::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<NewView>(*this);
   return msg;
 }
 
-const std::string NewView::digest() const
+std::string NewView::NativeDigest() const
 {
+  DigestWriter writer(type());
+  writer.Write(m_view);
+  writer.Write(static_cast<uint32_t>(m_vc_messages.size()));
+  for (const messages::ViewChange& elem: m_vc_messages)
+  {
+    writer.Write(elem.sender_id()).Write(elem.digest());
+  }
+  writer.Write(static_cast<uint32_t>(m_ppp_messages.size()));
+  for (const messages::PrePrepare& elem: m_ppp_messages)
+  {
+    writer.Write(elem.seq_number()).Write(elem.req_digest()).Write(elem.proposed_block_hash());
+  }
+  return writer.GetHex();
+}
+
+std::string NewView::PrologDigest() const
+{
+  // The legacy digest covers the whole blocks in Chi, as in the previous releases
+  new_view_chi_t legacy_chi;
+  for (const messages::PrePrepare& elem: m_ppp_messages)
+  {
+    legacy_chi.emplace_back(make_tuple(elem.seq_number(), elem.req_digest(), elem.proposed_block_hex()));
+  }
+
   PlTerm Digest;
   PlTermv args(
     PlTerm((long) m_view),
     NewView::nu_as_plterm(this->nu()),
-    NewView::chi_as_plterm(this->chi()),
+    NewView::chi_as_plterm(legacy_chi),
     Digest
   );
 
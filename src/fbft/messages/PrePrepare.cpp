@@ -28,7 +28,18 @@ CBlock proposed_block)
   m_view = view;
   m_seq_number = seq_number;
   m_req_digest = req_digest;
-  m_proposed_block = HexSerializableCBlock(proposed_block);
+  this->set_proposed_block(std::make_shared<const CBlock>(proposed_block));
+}
+
+PrePrepare::PrePrepare(uint32_t sender_id,
+uint32_t view, uint32_t seq_number, std::string req_digest,
+std::shared_ptr<const CBlock> proposed_block)
+:Message(NODE_TYPE::REPLICA, sender_id)
+{
+  m_view = view;
+  m_seq_number = seq_number;
+  m_req_digest = req_digest;
+  this->set_proposed_block(proposed_block);
 }
 
 PrePrepare::PrePrepare(PlTerm Sender_id, PlTerm V, PlTerm N, PlTerm Req_digest,
@@ -39,32 +50,35 @@ PlTerm Proposed_block)
   m_seq_number = (long) N;
   m_req_digest = (char*) Req_digest;
 
-  std::string proposed_block_hex { (char*) Proposed_block };
-  this->set_proposed_block(proposed_block_hex);
+  std::string proposed_block_hash { (char*) Proposed_block };
+  std::shared_ptr<const CBlock> proposed_block = BlockStore::Instance().Get(proposed_block_hash);
+  if (!proposed_block)
+  {
+    string error_msg = str(
+      boost::format("Unable to find block %1% in the block store")
+        % proposed_block_hash
+    );
+    throw(std::runtime_error(error_msg));
+  }
+  this->set_proposed_block(proposed_block);
 }
 
 PrePrepare::~PrePrepare()
 {
 };
 
-void PrePrepare::set_proposed_block(std::string proposed_block_hex)
+void PrePrepare::set_proposed_block(std::shared_ptr<const CBlock> proposed_block)
 {
-  m_proposed_block = HexSerializableCBlock(proposed_block_hex);
+  m_proposed_block = proposed_block;
+  m_proposed_block_hash = proposed_block->GetHash().GetHex();
 }
 
 std::vector<std::unique_ptr<messages::PrePrepare>> PrePrepare::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::PrePrepare>> results{};
   PlTerm Replica_id{(long) replica_id}, V, N, Req_digest, Proposed_block;
-  PlQuery query("msg_out_pre_prepare", PlTermv(Replica_id, V, N, Req_digest, Proposed_block));
-  while ( query.next_solution() )
-  {
-    messages::PrePrepare msg{
-      Replica_id, V, N, Req_digest, Proposed_block
-    };
-    results.emplace_back(std::move(std::make_unique<messages::PrePrepare>(msg)));
-  }
-  return results;
+  return CollectSolutions<messages::PrePrepare>("msg_out_pre_prepare", PlTermv(Replica_id, V, N, Req_digest, Proposed_block), [&]() {
+    return std::make_unique<messages::PrePrepare>(Replica_id, V, N, Req_digest, Proposed_block);
+  });
 }
 
 messages::PrePrepare PrePrepare::FindByV_N_Req(uint32_t replica_id, uint32_t v, uint32_t n, std::string req_digest)
@@ -96,18 +110,30 @@ bool PrePrepare::equals(const Message& other) const
   if (m_view != typed_other.m_view) return false;
   if (m_seq_number != typed_other.m_seq_number) return false;
   if (m_req_digest != typed_other.m_req_digest) return false;
-  if (m_proposed_block.GetHash() != typed_other.m_proposed_block.GetHash()) return false;
+  if (m_proposed_block_hash != typed_other.m_proposed_block_hash) return false;
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> PrePrepare::clone()
+std::unique_ptr<Message> PrePrepare::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<PrePrepare>(*this);
   return msg;
 }
 
-const std::string PrePrepare::digest() const
+std::string PrePrepare::NativeDigest() const
+{
+  // The proposed block only contributes its hash
+  return DigestWriter(type())
+    .Write(m_view)
+    .Write(m_seq_number)
+    .Write(m_req_digest)
+    .Write(m_proposed_block_hash)
+    .GetHex();
+}
+
+std::string PrePrepare::PrologDigest() const
 {
+  // The legacy digest covers the whole proposed block, as in the previous releases
   PlTerm Digest;
   int pl_ok = PlCall("digest_pre_prepare", PlTermv(
     PlTerm{(long) m_view},
@@ -130,7 +156,7 @@ const std::string PrePrepare::digest() const
 
 std::string PrePrepare::proposed_block_hex() const
 {
-  return m_proposed_block.GetHex();
+  return HexSerializableCBlock(*m_proposed_block).GetHex();
 }
 
 std::string PrePrepare::identify() const
@@ -154,7 +180,7 @@ Message(root)
   m_seq_number = root["payload"]["n"].asUInt();
   m_req_digest = root["payload"]["req_digest"].asString();
   string proposed_block_hex = root["payload"]["data"].asString();
-  this->set_proposed_block(proposed_block_hex);
+  this->set_proposed_block(std::make_shared<const CBlock>(HexSerializableCBlock(proposed_block_hex)));
 }
 
 std::string PrePrepare::ToBinBuffer() const
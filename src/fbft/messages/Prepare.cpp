@@ -37,17 +37,10 @@ Prepare::~Prepare()
 
 std::vector<std::unique_ptr<messages::Prepare>> Prepare::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::Prepare>> results{};
   PlTerm Replica_id{(long) replica_id}, V, N, Req_digest;
-  PlQuery query("msg_out_prepare", PlTermv(Replica_id, V, N, Req_digest));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<messages::Prepare> msg = std::make_unique<messages::Prepare>(
-      Replica_id, V, N, Req_digest
-    );
-    results.emplace_back(std::move(msg));
-  }
-  return results;
+  return CollectSolutions<messages::Prepare>("msg_out_prepare", PlTermv(Replica_id, V, N, Req_digest), [&]() {
+    return std::make_unique<messages::Prepare>(Replica_id, V, N, Req_digest);
+  });
 }
 
 bool Prepare::equals(const Message& other) const
@@ -61,13 +54,23 @@ bool Prepare::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> Prepare::clone()
+std::unique_ptr<Message> Prepare::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<Prepare>(*this);
   return msg;
 }
 
-const std::string Prepare::digest() const
+std::string Prepare::NativeDigest() const
+{
+  return DigestWriter(type())
+    .Write(m_view)
+    .Write(m_seq_number)
+    .Write(m_req_digest)
+    .Write(m_sender_id)
+    .GetHex();
+}
+
+std::string Prepare::PrologDigest() const
 {
   PlTerm Digest;
   int pl_ok = PlCall("digest_prepare", PlTermv(
@@ -87,7 +87,7 @@ bool Request::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> Request::clone()
+std::unique_ptr<Message> Request::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<Request>(*this);
   return msg;
@@ -46,26 +46,31 @@ RoastPreSignature::~RoastPreSignature()
 
 std::vector<std::unique_ptr<messages::RoastPreSignature>> RoastPreSignature::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::RoastPreSignature>> results{};
   PlTerm Replica_id{(long) replica_id}, Signers, Pre_signature;
-  PlQuery query("msg_out_roast_pre_signature", PlTermv(Replica_id, Signers, Pre_signature));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<messages::RoastPreSignature> msg = std::make_unique<messages::RoastPreSignature>(
-      Replica_id, Signers, Pre_signature
-    );
-    results.emplace_back(std::move(msg));
-  }
-  return results;
+  return CollectSolutions<messages::RoastPreSignature>("msg_out_roast_pre_signature", PlTermv(Replica_id, Signers, Pre_signature), [&]() {
+    return std::make_unique<messages::RoastPreSignature>(Replica_id, Signers, Pre_signature);
+  });
 }
 
-std::unique_ptr<Message> RoastPreSignature::clone()
+std::unique_ptr<Message> RoastPreSignature::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<RoastPreSignature>(*this);
   return msg;
 }
 
-const std::string RoastPreSignature::digest() const
+std::string RoastPreSignature::NativeDigest() const
+{
+  DigestWriter writer(type());
+  writer.Write(static_cast<uint32_t>(m_signers.size()));
+  for (uint32_t signer: m_signers)
+  {
+    writer.Write(signer);
+  }
+  writer.Write(m_pre_signature).Write(m_sender_id);
+  return writer.GetHex();
+}
+
+std::string RoastPreSignature::PrologDigest() const
 {
   PlTerm Digest;
   PlTermv args(
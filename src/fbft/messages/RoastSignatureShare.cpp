@@ -42,26 +42,28 @@ RoastSignatureShare::~RoastSignatureShare()
 
 std::vector<std::unique_ptr<messages::RoastSignatureShare>> RoastSignatureShare::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::RoastSignatureShare>> results{};
   PlTerm Replica_id{(long) replica_id}, Signature_share, Next_pre_signature_share;
-  PlQuery query("msg_out_roast_signature_share", PlTermv(Replica_id, Signature_share, Next_pre_signature_share));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<messages::RoastSignatureShare> msg = std::make_unique<messages::RoastSignatureShare>(
-      Replica_id, Signature_share, Next_pre_signature_share
-    );
-    results.emplace_back(std::move(msg));
-  }
-  return results;
+  return CollectSolutions<messages::RoastSignatureShare>("msg_out_roast_signature_share", PlTermv(Replica_id, Signature_share, Next_pre_signature_share), [&]() {
+    return std::make_unique<messages::RoastSignatureShare>(Replica_id, Signature_share, Next_pre_signature_share);
+  });
 }
 
-std::unique_ptr<Message> RoastSignatureShare::clone()
+std::unique_ptr<Message> RoastSignatureShare::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<RoastSignatureShare>(*this);
   return msg;
 }
 
-const std::string RoastSignatureShare::digest() const
+std::string RoastSignatureShare::NativeDigest() const
+{
+  return DigestWriter(type())
+    .Write(m_signature_share)
+    .Write(m_next_pre_signature_share)
+    .Write(m_sender_id)
+    .GetHex();
+}
+
+std::string RoastSignatureShare::PrologDigest() const
 {
   PlTerm Digest;
   PlTermv args(
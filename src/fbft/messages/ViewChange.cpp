@@ -12,6 +12,7 @@
 #include "config/FbftConfig.h"
 
 using namespace std;
+using namespace itcoin::blockchain;
 
 namespace itcoin {
 namespace fbft {
@@ -29,6 +30,14 @@ ViewChange::ViewChange(uint32_t sender_id,
   m_c = c;
   m_pi = pi;
   m_qi = qi;
+  for (const view_change_pre_prepared_elem_t& elem: m_qi)
+  {
+    std::shared_ptr<const CBlock> block = BlockStore::Instance().Get(get<2>(elem));
+    if (block)
+    {
+      m_qi_blocks.emplace(get<2>(elem), block);
+    }
+  }
 }
 
 ViewChange::ViewChange(PlTerm Sender_id,
@@ -81,6 +90,13 @@ ViewChange::ViewChange(PlTerm Sender_id,
     assert(Q_elem_5.type()==PL_NIL);
 
     m_qi.emplace_back( make_tuple(q_n, q_req_digest, q_prep_block, q_v) );
+
+    // Blocks already released from the store are not needed anymore
+    std::shared_ptr<const CBlock> block = BlockStore::Instance().Get(q_prep_block);
+    if (block)
+    {
+      m_qi_blocks.emplace(q_prep_block, block);
+    }
   }
 }
 
@@ -90,17 +106,10 @@ ViewChange::~ViewChange()
 
 std::vector<std::unique_ptr<messages::ViewChange>> ViewChange::BuildToBeSent(uint32_t replica_id)
 {
-  std::vector<unique_ptr<messages::ViewChange>> results{};
   PlTerm Replica_id{(long) replica_id}, V, Hi, C, Pi, Qi;
-  PlQuery query("msg_out_view_change", PlTermv(Replica_id, V, Hi, C, Pi, Qi));
-  while ( query.next_solution() )
-  {
-    std::unique_ptr<messages::ViewChange> msg = std::make_unique<messages::ViewChange>(
-      Replica_id, V, Hi, C, Pi, Qi
-    );
-    results.emplace_back(std::move(msg));
-  }
-  return results;
+  return CollectSolutions<messages::ViewChange>("msg_out_view_change", PlTermv(Replica_id, V, Hi, C, Pi, Qi), [&]() {
+    return std::make_unique<messages::ViewChange>(Replica_id, V, Hi, C, Pi, Qi);
+  });
 }
 
 messages::ViewChange ViewChange::FindByDigest(uint32_t replica_id, uint32_t sender_id, std::string digest)
@@ -141,7 +150,7 @@ bool ViewChange::equals(const Message& other) const
   return Message::equals(other);
 }
 
-std::unique_ptr<Message> ViewChange::clone()
+std::unique_ptr<Message> ViewChange::clone() const
 {
   std::unique_ptr<Message> msg = std::make_unique<ViewChange>(*this);
   return msg;
@@ -199,7 +208,25 @@ PlTerm ViewChange::qi_as_plterm() const
   return result;
 }
 
-const std::string ViewChange::digest() const
+std::string ViewChange::NativeDigest() const
+{
+  DigestWriter writer(type());
+  writer.Write(m_view).Write(m_hi).Write(m_c);
+  writer.Write(static_cast<uint32_t>(m_pi.size()));
+  for (const view_change_prepared_elem_t& elem: m_pi)
+  {
+    writer.Write(get<0>(elem)).Write(get<1>(elem)).Write(get<2>(elem));
+  }
+  writer.Write(static_cast<uint32_t>(m_qi.size()));
+  for (const view_change_pre_prepared_elem_t& elem: m_qi)
+  {
+    writer.Write(get<0>(elem)).Write(get<1>(elem)).Write(get<2>(elem)).Write(get<3>(elem));
+  }
+  writer.Write(m_sender_id);
+  return writer.GetHex();
+}
+
+std::string ViewChange::PrologDigest() const
 {
   PlTerm Digest;
   PlTermv args(
@@ -271,6 +298,15 @@ Message(root)
       return qi_elem;
     }
   );
+
+  const Json::Value qi_blocks = root["payload"]["qi_blocks"];
+  for(Json::Value qi_block_json: qi_blocks)
+  {
+    std::shared_ptr<const CBlock> block = std::make_shared<const CBlock>(
+      HexSerializableCBlock(qi_block_json.asString())
+    );
+    m_qi_blocks.emplace(block->GetHash().GetHex(), block);
+  }
 }
 
 std::string ViewChange::ToBinBuffer() const
@@ -303,6 +339,13 @@ std::string ViewChange::ToBinBuffer() const
   }
   payload["qi"] = qi;
 
+  Json::Value qi_blocks{Json::arrayValue};
+  for(const auto& [block_hash, block]: m_qi_blocks)
+  {
+    qi_blocks.append(HexSerializableCBlock(*block).GetHex());
+  }
+  payload["qi_blocks"] = qi_blocks;
+
   return this->FinalizeJsonRoot(payload);
 }
 
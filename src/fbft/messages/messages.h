@@ -4,7 +4,12 @@
 #ifndef ITCOIN_FBFT_MESSAGES_MESSAGES_H
 #define ITCOIN_FBFT_MESSAGES_MESSAGES_H
 
+#include <map>
+#include <memory>
+#include <optional>
+#include <stdexcept>
 #include <string>
+#include <variant>
 #include <vector>
 
 #include <json/json.h>
@@ -22,6 +27,25 @@ namespace wallet=itcoin::wallet;
 
 namespace itcoin {
 namespace fbft {
+
+// Runs a query on the engine, and builds an element with make at each solution, make may return nullptr to skip it.
+// The arguments are bound by the query, hence make reads the solution from the terms it captures.
+template<typename T, typename F>
+std::vector<std::unique_ptr<T>> CollectSolutions(const char* predicate, const PlTermv& args, F&& make)
+{
+  std::vector<std::unique_ptr<T>> results{};
+  PlQuery query(predicate, args);
+  while ( query.next_solution() )
+  {
+    std::unique_ptr<T> p_elem = make();
+    if (p_elem != nullptr)
+    {
+      results.emplace_back(std::move(p_elem));
+    }
+  }
+  return results;
+}
+
 namespace messages {
 
 enum NODE_TYPE : unsigned int {
@@ -55,7 +79,43 @@ const std::string MSG_TYPE_AS_STRING[] = {
   "VIEW_CHANGE",
 };
 
+// Digests
+
+// How Message::digest() is computed. PROLOG is the legacy digest, the SHA-256 of the json built
+// by the digest_* predicates of the engine. NATIVE is the SHA-256 of the canonical binary encoding
+// written by DigestWriter. All the replicas of a cluster must use the same scheme.
+enum class DIGEST_SCHEME : unsigned int {
+  PROLOG = 0,
+  NATIVE = 1,
+};
+
+const std::string DIGEST_SCHEME_AS_STRING[] = { "prolog", "native" };
+
+// The digest scheme is process-wide, like the Prolog database. It is set once at startup, from the
+// fbft_digest_scheme configuration value, before any replica is built: set_digest_scheme also
+// replaces the digest_view_change_hook clause shared by all the Prolog engines.
+DIGEST_SCHEME digest_scheme();
+DIGEST_SCHEME digest_scheme_from_string(const std::string& scheme_name);
+void set_digest_scheme(DIGEST_SCHEME scheme);
+
+// Canonical binary encoding of a message: the message type, followed by its fields in a fixed order.
+// Integers are 4 bytes little endian, strings and lists are prefixed by their length.
+class DigestWriter {
+  public:
+    DigestWriter(unsigned int msg_type);
+
+    DigestWriter& Write(uint32_t value);
+    DigestWriter& Write(const std::string& value);
+
+    // The hex encoded SHA-256 of the data written so far
+    std::string GetHex() const;
+
+  private:
+    std::vector<unsigned char> m_buffer;
+};
+
 // Type definitions for messages
+// Blocks appear in the tuples by hash, the blocks themselves are in the blockchain::BlockStore
 
 typedef std::tuple<uint32_t, std::string, std::string, uint32_t> view_change_pre_prepared_elem_t;
 typedef std::vector<view_change_pre_prepared_elem_t> view_change_pre_prepared_t;
@@ -69,6 +129,13 @@ typedef std::vector<new_view_nu_elem_t> new_view_nu_t;
 typedef std::tuple<uint32_t, std::string, std::string> new_view_chi_elem_t;
 typedef std::vector<new_view_chi_elem_t> new_view_chi_t;
 
+// Identity of a message in the input buffers of a replica: type, sender, view, sequence number and digest.
+// Two messages with the same key are duplicates, whatever their signature.
+typedef std::tuple<unsigned int, uint32_t, std::optional<uint32_t>, std::optional<uint32_t>, std::string> message_key_t;
+
+// Signature of the messages a replica delivers to itself, the engine logs its own messages with it
+const std::string SIG_OWN_REPLICA = "SIG_OWN_REPLICA";
+
 // Abstract class
 
 class Message {
@@ -78,21 +145,24 @@ class Message {
     virtual ~Message();
 
     // Getters
-    virtual std::unique_ptr<Message> clone() = 0;
+    virtual std::unique_ptr<Message> clone() const = 0;
+    // The digest is computed once, with the current digest scheme, and then memoized
     virtual const std::string digest() const;
     virtual std::string identify() const = 0;
+    virtual message_key_t key() const;
     std::string name() const;
     virtual std::optional<uint32_t> seq_number_as_opt() const;
     std::string signature() const;
     uint32_t sender_id() const {return m_sender_id;}
     virtual MSG_TYPE type() const = 0;
+    virtual std::optional<uint32_t> view_as_opt() const;
 
     // Setters
     void set_signature(std::string signature_hex);
 
     // Operations
     virtual void Sign(const wallet::Wallet& wallet);
-    virtual bool VerifySignatures(const wallet::Wallet& wallet);
+    virtual bool VerifySignatures(const wallet::Wallet& wallet) const;
 
     // Operators
     friend std::ostream& operator<<(std::ostream& Str, const Message& action);
@@ -101,8 +171,8 @@ class Message {
     // Serialization
     virtual std::string ToBinBuffer() const; // Should be = 0;
 
-    // TODO: ritornare direttamente uno unique_ptr, eventualmente nullptr
-    static std::optional<std::unique_ptr<messages::Message>> BuildFromBinBuffer(const std::string& bin_buffer);
+    // Received messages are immutable, and shared by the input buffer and the actions referring to them
+    static std::optional<std::shared_ptr<const messages::Message>> BuildFromBinBuffer(const std::string& bin_buffer);
 
   protected:
     Message(const Json::Value& root);
@@ -111,6 +181,12 @@ class Message {
     uint32_t m_sender_id;
     std::string m_signature;
 
+    // Digests, the memoized one is valid for the scheme it was computed with
+    mutable std::optional<std::string> m_digest;
+    mutable DIGEST_SCHEME m_digest_scheme = DIGEST_SCHEME::PROLOG;
+    virtual std::string NativeDigest() const;
+    virtual std::string PrologDigest() const;
+
     virtual bool equals(const Message& other) const;
     std::string FinalizeJsonRoot(Json::Value& root) const;
 };
@@ -123,12 +199,13 @@ class Request : public Message {
     ~Request();
 
     // Getters
-    std::unique_ptr<Message> clone();
+    std::unique_ptr<Message> clone() const;
     const std::string digest() const;
     std::string identify() const;
     uint32_t timestamp() const { return m_timestamp; }
     uint32_t height() const;
-    MSG_TYPE type() const { return MSG_TYPE::REQUEST; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::REQUEST;
+    MSG_TYPE type() const { return TYPE; }
 
     // Finders
     // TODO, replace with one optional
@@ -148,20 +225,27 @@ class PrePrepare : public Message {
     PrePrepare(uint32_t sender_id,
       uint32_t view, uint32_t seq_number, std::string req_digest,
       CBlock proposed_block);
+    PrePrepare(uint32_t sender_id,
+      uint32_t view, uint32_t seq_number, std::string req_digest,
+      std::shared_ptr<const CBlock> proposed_block);
+    // Proposed_block is the block hash, the block is resolved from the blockchain::BlockStore
     PrePrepare(PlTerm Sender_id, PlTerm V, PlTerm N, PlTerm Req_digest, PlTerm Proposed_block);
     PrePrepare(const Json::Value& root);
     ~PrePrepare();
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     std::string identify() const;
     uint32_t view() const { return m_view; }
     uint32_t seq_number() const { return m_seq_number; }
     std::optional<uint32_t> seq_number_as_opt() const { return m_seq_number; }
     std::string req_digest() const { return m_req_digest; }
-    MSG_TYPE type() const { return MSG_TYPE::PRE_PREPARE; }
-    const CBlock& proposed_block() const { return m_proposed_block; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::PRE_PREPARE;
+    MSG_TYPE type() const { return TYPE; }
+    std::optional<uint32_t> view_as_opt() const { return m_view; }
+    const CBlock& proposed_block() const { return *m_proposed_block; }
+    std::shared_ptr<const CBlock> proposed_block_ptr() const { return m_proposed_block; }
+    const std::string& proposed_block_hash() const { return m_proposed_block_hash; }
     std::string proposed_block_hex() const;
 
     // Builders
@@ -177,10 +261,13 @@ class PrePrepare : public Message {
     uint32_t m_view;
     uint32_t m_seq_number;
     std::string m_req_digest;
-    itcoin::blockchain::HexSerializableCBlock m_proposed_block;
+    std::shared_ptr<const CBlock> m_proposed_block;
+    std::string m_proposed_block_hash;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
-    void set_proposed_block(std::string proposed_block_hex);
+    void set_proposed_block(std::shared_ptr<const CBlock> proposed_block);
 };
 
 class Prepare : public Message {
@@ -192,13 +279,14 @@ class Prepare : public Message {
     ~Prepare();
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     std::string identify() const;
     std::string req_digest() const { return m_req_digest; }
     uint32_t seq_number() const { return m_seq_number; }
     std::optional<uint32_t> seq_number_as_opt() const { return m_seq_number; }
-    MSG_TYPE type() const { return MSG_TYPE::PREPARE; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::PREPARE;
+    MSG_TYPE type() const { return TYPE; }
+    std::optional<uint32_t> view_as_opt() const { return m_view; }
     uint32_t view() const { return m_view; }
 
     // Builders
@@ -212,6 +300,8 @@ class Prepare : public Message {
     uint32_t m_seq_number;
     std::string m_req_digest;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
 };
 
@@ -223,13 +313,14 @@ class Commit : public Message {
     ~Commit();
 
     // Getters
-    std::unique_ptr<Message> clone();
+    std::unique_ptr<Message> clone() const;
     const std::string pre_signature() const { return m_pre_signature; }
-    const std::string digest() const;
     std::string identify() const;
     uint32_t seq_number() const { return m_seq_number; }
     std::optional<uint32_t> seq_number_as_opt() const { return m_seq_number; }
-    MSG_TYPE type() const { return MSG_TYPE::COMMIT; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::COMMIT;
+    MSG_TYPE type() const { return TYPE; }
+    std::optional<uint32_t> view_as_opt() const { return m_view; }
     uint32_t view() const { return m_view; }
 
     // Finders
@@ -246,6 +337,8 @@ class Commit : public Message {
     uint32_t m_seq_number;
     std::string m_pre_signature;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
     void set_pre_signature(std::string pre_signature_hex);
 };
@@ -256,12 +349,15 @@ class Block : public Message {
     ~Block();
 
     // Getters
-    std::unique_ptr<Message> clone();
+    std::unique_ptr<Message> clone() const;
     uint32_t block_time() const { return m_block_time; }
     std::string block_hash() const { return m_block_hash; };
     uint32_t block_height() const { return m_block_height; }
     std::string identify() const;
-    MSG_TYPE type() const { return MSG_TYPE::BLOCK; }
+    // Blocks have no digest, they are identified by height and hash
+    message_key_t key() const;
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::BLOCK;
+    MSG_TYPE type() const { return TYPE; }
 
   private:
     uint32_t m_block_height;
@@ -284,8 +380,7 @@ class ViewChange : public Message {
     ~ViewChange();
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     uint32_t view() const { return m_view; }
     uint32_t hi() const { return m_hi; }
     std::string identify() const;
@@ -294,7 +389,11 @@ class ViewChange : public Message {
     PlTerm pi_as_plterm() const;
     const view_change_pre_prepared_t& qi() const { return m_qi; }
     PlTerm qi_as_plterm() const;
-    MSG_TYPE type() const { return MSG_TYPE::VIEW_CHANGE; }
+    // The blocks referenced by qi, by hash, they travel with the message so that the new primary can build Chi
+    const std::map<std::string, std::shared_ptr<const CBlock>>& qi_blocks() const { return m_qi_blocks; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::VIEW_CHANGE;
+    MSG_TYPE type() const { return TYPE; }
+    std::optional<uint32_t> view_as_opt() const { return m_view; }
 
     // Builders
     static std::vector<std::unique_ptr<messages::ViewChange>> BuildToBeSent(uint32_t replica_id);
@@ -311,7 +410,10 @@ class ViewChange : public Message {
     std::string m_c;
     view_change_prepared_t m_pi;
     view_change_pre_prepared_t m_qi;
+    std::map<std::string, std::shared_ptr<const CBlock>> m_qi_blocks;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
 };
 
@@ -329,14 +431,15 @@ class NewView: public Message {
     ~NewView();
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     std::string identify() const;
     const std::vector<ViewChange>& view_changes() const { return m_vc_messages; };
     new_view_nu_t nu() const;
     const std::vector<PrePrepare>& pre_prepares() const { return m_ppp_messages; };
     new_view_chi_t chi() const;
-    MSG_TYPE type() const { return MSG_TYPE::NEW_VIEW; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::NEW_VIEW;
+    MSG_TYPE type() const { return TYPE; }
+    std::optional<uint32_t> view_as_opt() const { return m_view; }
     uint32_t view() const { return m_view; }
 
     // Builders
@@ -348,7 +451,9 @@ class NewView: public Message {
 
     // Operations
     void Sign(const wallet::RoastWallet& wallet);
-    bool VerifySignatures(const wallet::RoastWallet& wallet);
+    // Signs the VIEW_CHANGEs of the sender, taken unsigned from its own log
+    void SignViewChanges(const wallet::Wallet& wallet);
+    bool VerifySignatures(const wallet::RoastWallet& wallet) const;
 
     // Serialization
     std::string ToBinBuffer() const;
@@ -358,6 +463,8 @@ class NewView: public Message {
     std::vector<ViewChange> m_vc_messages;
     std::vector<PrePrepare> m_ppp_messages;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
 };
 
@@ -374,13 +481,13 @@ class RoastPreSignature : public Message {
     static std::vector<std::unique_ptr<messages::RoastPreSignature>> BuildToBeSent(uint32_t replica_id);
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     std::string identify() const;
     std::string pre_signature() const;
     std::vector<uint32_t> signers() const;
     PlTerm signers_as_plterm() const;
-    MSG_TYPE type() const { return MSG_TYPE::ROAST_PRE_SIGNATURE; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::ROAST_PRE_SIGNATURE;
+    MSG_TYPE type() const { return TYPE; }
 
     // Serialization
     std::string ToBinBuffer() const;
@@ -389,6 +496,8 @@ class RoastPreSignature : public Message {
     std::vector<uint32_t> m_signers;
     std::string m_pre_signature;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
 };
 
@@ -405,12 +514,12 @@ class RoastSignatureShare : public Message {
     static std::vector<std::unique_ptr<messages::RoastSignatureShare>> BuildToBeSent(uint32_t replica_id);
 
     // Getters
-    std::unique_ptr<Message> clone();
-    const std::string digest() const;
+    std::unique_ptr<Message> clone() const;
     std::string identify() const;
     std::string signature_share() const;
     std::string next_pre_signature_share() const;
-    MSG_TYPE type() const { return MSG_TYPE::ROAST_SIGNATURE_SHARE; }
+    static constexpr MSG_TYPE TYPE = MSG_TYPE::ROAST_SIGNATURE_SHARE;
+    MSG_TYPE type() const { return TYPE; }
 
     // Serialization
     std::string ToBinBuffer() const;
@@ -419,9 +528,62 @@ class RoastSignatureShare : public Message {
     std::string m_signature_share;
     std::string m_next_pre_signature_share;
 
+    std::string NativeDigest() const;
+    std::string PrologDigest() const;
     bool equals(const Message& other) const;
 };
 
+// Compile-time registry of message types.
+// It generates the loops over the types, and converts a message to a variant, so that the code handling
+// each type is chosen by std::visit rather than by casts, and a missing type is a compile error.
+template<typename... Ts>
+struct MessageRegistry {
+  typedef std::variant<std::shared_ptr<const Ts>...> variant_t;
+
+  // Converts p_msg to the alternative of its type, throws if the type is not in the registry
+  static variant_t AsVariant(const std::shared_ptr<const Message>& p_msg)
+  {
+    std::optional<variant_t> result = std::nullopt;
+    MSG_TYPE msg_type = p_msg->type();
+    ( (msg_type == Ts::TYPE && (result.emplace(std::static_pointer_cast<const Ts>(p_msg)), true)) || ... );
+    if (!result.has_value())
+    {
+      throw std::runtime_error("MessageRegistry::AsVariant unknown message type: " + p_msg->name());
+    }
+    return std::move(result.value());
+  }
+
+  // Builds the message of the given type from its json, nullptr if the type is not in the registry
+  static std::shared_ptr<const Message> BuildFromJson(unsigned int msg_type, const Json::Value& root)
+  {
+    std::shared_ptr<const Message> result = nullptr;
+    ( (msg_type == Ts::TYPE && (result = std::make_shared<Ts>(root), true)) || ... );
+    return result;
+  }
+
+  // Collects the messages the engine wants to be sent, type by type
+  static std::vector<std::unique_ptr<Message>> BuildToBeSent(uint32_t replica_id)
+  {
+    std::vector<std::unique_ptr<Message>> results{};
+    auto append = [&results](auto&& typed_msgs) {
+      for (auto& p_msg : typed_msgs)
+      {
+        results.emplace_back(std::move(p_msg));
+      }
+    };
+    ( append(Ts::BuildToBeSent(replica_id)), ... );
+    return results;
+  }
+};
+
+// All the messages a replica handles
+typedef MessageRegistry<Block, Request, PrePrepare, Prepare, Commit, ViewChange, NewView,
+  RoastPreSignature, RoastSignatureShare> AllMessages;
+
+// The messages replicas exchange over the network, in the order they are sent
+typedef MessageRegistry<PrePrepare, Prepare, Commit, ViewChange, NewView,
+  RoastPreSignature, RoastSignatureShare> ReplicaMessages;
+
 }
 }
 }
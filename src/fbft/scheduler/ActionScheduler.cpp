@@ -0,0 +1,73 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "scheduler.h"
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+
+using namespace std;
+
+namespace itcoin {
+namespace fbft {
+namespace scheduler {
+
+ActionScheduler::ActionScheduler(const itcoin::FbftConfig& conf):
+m_conf(conf),
+m_budget(MIN_BUDGET)
+{
+}
+
+std::unique_ptr<ActionScheduler> ActionScheduler::BuildFromConfig(const itcoin::FbftConfig& conf)
+{
+  std::string scheduler_name = conf.fbft_scheduler();
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% using the %2% action scheduler")
+      % conf.id()
+      % scheduler_name
+  );
+
+  if (scheduler_name == "priority")
+  {
+    return std::make_unique<PriorityActionScheduler>(conf);
+  }
+  else if (scheduler_name == "random")
+  {
+    return std::make_unique<RandomActionScheduler>(conf);
+  }
+
+  string error_msg = str(
+    boost::format("R%1% unknown fbft_scheduler \"%2%\", the allowed values are \"priority\" and \"random\"")
+      % conf.id()
+      % scheduler_name
+  );
+  BOOST_LOG_TRIVIAL(error) << error_msg;
+  throw std::runtime_error(error_msg);
+}
+
+void ActionScheduler::AdaptBudget(uint32_t num_applied_actions, bool actions_left)
+{
+  uint32_t previous_budget = m_budget;
+  if (actions_left)
+  {
+    m_budget = std::min(2*m_budget, MAX_BUDGET);
+  }
+  else if (num_applied_actions < m_budget/4)
+  {
+    m_budget = std::max(m_budget/2, MIN_BUDGET);
+  }
+
+  if (m_budget != previous_budget)
+  {
+    BOOST_LOG_TRIVIAL(debug) << str(
+      boost::format("R%1% action budget changed from %2% to %3%")
+        % m_conf.id()
+        % previous_budget
+        % m_budget
+    );
+  }
+}
+
+}
+}
+}
@@ -0,0 +1,71 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <map>
+
+using namespace std;
+
+namespace itcoin {
+namespace fbft {
+namespace scheduler {
+
+// The rank of each action type, lower ranks are applied first
+static const std::map<actions::ACTION_TYPE, uint32_t> PRIORITY_RANKS{
+  // Receiving a block moves the checkpoint, and makes most of the other actions stale
+  {actions::ACTION_TYPE::RECEIVE_BLOCK, 0},
+  // Actions completing a view change
+  {actions::ACTION_TYPE::RECOVER_VIEW, 1},
+  {actions::ACTION_TYPE::PROCESS_NEW_VIEW, 2},
+  {actions::ACTION_TYPE::SEND_NEW_VIEW, 3},
+  {actions::ACTION_TYPE::RECEIVE_NEW_VIEW, 4},
+  {actions::ACTION_TYPE::RECEIVE_VIEW_CHANGE, 5},
+  // Normal operation, from the latest phase to the earliest one
+  {actions::ACTION_TYPE::EXECUTE, 10},
+  {actions::ACTION_TYPE::ROAST_RECEIVE_SIGNATURE_SHARE, 11},
+  {actions::ACTION_TYPE::ROAST_RECEIVE_PRE_SIGNATURE, 12},
+  {actions::ACTION_TYPE::ROAST_INIT, 13},
+  {actions::ACTION_TYPE::SEND_COMMIT, 14},
+  {actions::ACTION_TYPE::SEND_PREPARE, 15},
+  {actions::ACTION_TYPE::SEND_PRE_PREPARE, 16},
+  {actions::ACTION_TYPE::RECEIVE_COMMIT, 20},
+  {actions::ACTION_TYPE::RECEIVE_PREPARE, 21},
+  {actions::ACTION_TYPE::RECEIVE_PRE_PREPARE, 22},
+  {actions::ACTION_TYPE::RECEIVE_REQUEST, 23},
+  // Actions starting a view change
+  {actions::ACTION_TYPE::SEND_VIEW_CHANGE, 30},
+  {actions::ACTION_TYPE::INVALID, 40},
+};
+
+PriorityActionScheduler::PriorityActionScheduler(const itcoin::FbftConfig& conf):
+ActionScheduler(conf)
+{
+}
+
+std::string PriorityActionScheduler::name() const
+{
+  return "priority";
+}
+
+uint32_t PriorityActionScheduler::rank(actions::ACTION_TYPE type)
+{
+  return PRIORITY_RANKS.at(type);
+}
+
+std::vector<std::shared_ptr<actions::Action>> PriorityActionScheduler::Schedule(
+  const std::vector<std::shared_ptr<actions::Action>>& active_actions)
+{
+  std::vector<std::shared_ptr<actions::Action>> schedule{active_actions};
+  std::stable_sort(schedule.begin(), schedule.end(),
+    [](const std::shared_ptr<actions::Action>& a, const std::shared_ptr<actions::Action>& b) {
+      return rank(a->type()) < rank(b->type());
+    }
+  );
+  return schedule;
+}
+
+}
+}
+}
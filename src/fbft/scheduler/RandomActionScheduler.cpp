@@ -0,0 +1,48 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <chrono>
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+
+using namespace std;
+
+namespace itcoin {
+namespace fbft {
+namespace scheduler {
+
+RandomActionScheduler::RandomActionScheduler(const itcoin::FbftConfig& conf):
+ActionScheduler(conf)
+{
+  // Without a seed, use the current time as the previous releases did
+  uint32_t seed = conf.fbft_scheduler_seed().value_or(
+    static_cast<uint32_t>(std::chrono::system_clock::now().time_since_epoch().count())
+  );
+  m_generator.seed(seed);
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% random action scheduler seeded with %2%")
+      % conf.id()
+      % seed
+  );
+}
+
+std::string RandomActionScheduler::name() const
+{
+  return "random";
+}
+
+std::vector<std::shared_ptr<actions::Action>> RandomActionScheduler::Schedule(
+  const std::vector<std::shared_ptr<actions::Action>>& active_actions)
+{
+  std::vector<std::shared_ptr<actions::Action>> schedule{active_actions};
+  std::shuffle(schedule.begin(), schedule.end(), m_generator);
+  return schedule;
+}
+
+}
+}
+}
@@ -0,0 +1,94 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "scheduler.h"
+
+#include <algorithm>
+#include <cmath>
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+
+using namespace std;
+
+namespace itcoin {
+namespace fbft {
+namespace scheduler {
+
+RequestHorizon::RequestHorizon(const itcoin::FbftConfig& conf):
+m_conf(conf),
+m_horizon(INITIAL_HORIZON),
+m_commit_latency(0),
+m_view_change_rate(0),
+m_latest_reply_time(std::nullopt),
+m_view(std::nullopt),
+m_view_changes_since_reply(0)
+{
+}
+
+bool RequestHorizon::Observe(double current_time, double latest_reply_time, uint32_t view)
+{
+  double target_block_time = m_conf.target_block_time();
+
+  // The first observation is the starting point
+  if (!m_latest_reply_time.has_value())
+  {
+    m_latest_reply_time = latest_reply_time;
+    m_view = view;
+    return false;
+  }
+
+  bool changed = false;
+  if (view > m_view.value())
+  {
+    m_view_changes_since_reply += view - m_view.value();
+    m_view = view;
+    changed = true;
+  }
+
+  if (latest_reply_time > m_latest_reply_time.value())
+  {
+    m_latest_reply_time = latest_reply_time;
+
+    // Replies received while catching up are capped, otherwise a single resync would max out the horizon
+    double latency = std::clamp(current_time - latest_reply_time, 0.0, MAX_HORIZON*target_block_time);
+    m_commit_latency = (1-SMOOTHING)*m_commit_latency + SMOOTHING*latency;
+    m_view_change_rate = (1-SMOOTHING)*m_view_change_rate + SMOOTHING*m_view_changes_since_reply;
+    m_view_changes_since_reply = 0;
+    changed = true;
+  }
+
+  if (!changed)
+  {
+    return false;
+  }
+
+  // The heights in flight, plus the requests due while a reply is pending, plus one more request
+  // for each view change expected before the next reply. The view changes since the latest reply
+  // count right away, since the replica does not know when the next reply will come.
+  double view_changes = std::max(m_view_change_rate, (double) m_view_changes_since_reply);
+  uint32_t horizon = m_conf.fbft_request_buffer_len()
+    + (uint32_t) std::ceil(m_commit_latency/target_block_time)
+    + (uint32_t) std::ceil(view_changes);
+  horizon = std::clamp(horizon, MIN_HORIZON, MAX_HORIZON);
+
+  if (horizon == m_horizon)
+  {
+    return false;
+  }
+
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% request horizon changed from %2% to %3%, commit latency %4% s, view change rate %5%")
+      % m_conf.id()
+      % m_horizon
+      % horizon
+      % m_commit_latency
+      % m_view_change_rate
+  );
+  m_horizon = horizon;
+  return true;
+}
+
+}
+}
+}
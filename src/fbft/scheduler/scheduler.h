@@ -0,0 +1,133 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#ifndef ITCOIN_FBFT_SCHEDULER_SCHEDULER_H
+#define ITCOIN_FBFT_SCHEDULER_SCHEDULER_H
+
+#include <memory>
+#include <optional>
+#include <random>
+#include <vector>
+
+#include "config/FbftConfig.h"
+#include "../actions/actions.h"
+
+namespace actions = itcoin::fbft::actions;
+
+namespace itcoin {
+namespace fbft {
+namespace scheduler {
+
+// The action scheduler decides in which order the active actions of a replica are applied,
+// and how many actions a replica may apply in a cycle. The actual implementation is selected
+// at startup via the fbft_scheduler configuration value.
+class ActionScheduler {
+  public:
+    ActionScheduler(const itcoin::FbftConfig& conf);
+    virtual ~ActionScheduler() {};
+
+    // Builds the scheduler named in the configuration
+    static std::unique_ptr<ActionScheduler> BuildFromConfig(const itcoin::FbftConfig& conf);
+
+    // Bounds of the number of actions applied in a cycle
+    static constexpr uint32_t MIN_BUDGET = 11;
+    static constexpr uint32_t MAX_BUDGET = 256;
+
+    // Getters
+    virtual std::string name() const = 0;
+    // Maximum number of actions to apply in the current cycle
+    uint32_t budget() const { return m_budget; }
+
+    // Operations
+    // Returns the active actions in the order they should be applied
+    virtual std::vector<std::shared_ptr<actions::Action>> Schedule(
+      const std::vector<std::shared_ptr<actions::Action>>& active_actions) = 0;
+    // Adapts the budget to the outcome of a cycle. The budget doubles when the cycle ended with
+    // actions still active, and halves when the cycle used less than a quarter of it.
+    void AdaptBudget(uint32_t num_applied_actions, bool actions_left);
+
+  protected:
+    const itcoin::FbftConfig& m_conf;
+    uint32_t m_budget;
+};
+
+// Applies the actions that bring a request closer to a block first: execute, commit, prepare,
+// then the receive actions, from the latest protocol phase to the earliest one.
+// View change actions follow their own policy: the actions completing a view change go first,
+// since the normal operation is stuck until the new view is active, while sending a VIEW_CHANGE
+// goes last, so that a replica does not leave a view where it can still make progress.
+// Actions with the same priority keep their relative order, hence the schedule is deterministic.
+class PriorityActionScheduler: public ActionScheduler {
+  public:
+    PriorityActionScheduler(const itcoin::FbftConfig& conf);
+
+    // Getters
+    std::string name() const;
+    // Lower ranks are applied first
+    static uint32_t rank(actions::ACTION_TYPE type);
+
+    // Operations
+    std::vector<std::shared_ptr<actions::Action>> Schedule(
+      const std::vector<std::shared_ptr<actions::Action>>& active_actions);
+};
+
+// Applies the actions in a random order, as the previous releases did.
+// The order is reproducible when fbft_scheduler_seed is set.
+class RandomActionScheduler: public ActionScheduler {
+  public:
+    RandomActionScheduler(const itcoin::FbftConfig& conf);
+
+    // Getters
+    std::string name() const;
+
+    // Operations
+    std::vector<std::shared_ptr<actions::Action>> Schedule(
+      const std::vector<std::shared_ptr<actions::Action>>& active_actions);
+
+  private:
+    std::mt19937 m_generator;
+};
+
+// The request horizon is the number of requests a replica generates ahead of its current time
+// and of its latest reply. A replica can only agree on the requests in its own log, so the horizon
+// has to cover the heights in flight, the time it takes to reply, and the view changes, whose timeouts
+// grow at each consecutive view. A larger horizon makes the log, hence the preconditions, more expensive,
+// so the horizon shrinks back once the replies are fast and the view is stable.
+class RequestHorizon {
+  public:
+    RequestHorizon(const itcoin::FbftConfig& conf);
+
+    // Bounds of the horizon, the initial one is the fixed horizon of the previous releases
+    static constexpr uint32_t MIN_HORIZON = 2;
+    static constexpr uint32_t INITIAL_HORIZON = 5;
+    static constexpr uint32_t MAX_HORIZON = 20;
+    // Weight of the latest observation in the moving averages
+    static constexpr double SMOOTHING = 0.2;
+
+    // Getters
+    uint32_t horizon() const { return m_horizon; }
+    // Moving average of the seconds between the timestamp of a request and its reply
+    double commit_latency() const { return m_commit_latency; }
+    // Moving average of the view changes between two consecutive replies
+    double view_change_rate() const { return m_view_change_rate; }
+
+    // Operations
+    // Updates the horizon given the latest reply time and view of the replica, returns true if it changed
+    bool Observe(double current_time, double latest_reply_time, uint32_t view);
+
+  private:
+    const itcoin::FbftConfig& m_conf;
+    uint32_t m_horizon;
+    double m_commit_latency;
+    double m_view_change_rate;
+
+    std::optional<double> m_latest_reply_time;
+    std::optional<uint32_t> m_view;
+    uint32_t m_view_changes_since_reply;
+};
+
+}
+}
+}
+
+#endif // ITCOIN_FBFT_SCHEDULER_SCHEDULER_H
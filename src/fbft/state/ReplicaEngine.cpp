@@ -0,0 +1,331 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "state.h"
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+#include <mutex>
+#include <string>
+#include <SWI-cpp.h>
+
+#include "../../blockchain/blockchain.h"
+#include "../../wallet/wallet.h"
+
+using namespace std;
+using namespace itcoin::blockchain;
+using namespace itcoin::wallet;
+
+// utilities
+
+static int prolog_engine_one_shot_call(const string predicate, const PlTermv args)
+{
+  try
+  {
+    return PlCall(predicate.c_str(), args);
+  }
+  catch ( PlException &ex )
+  {
+    BOOST_LOG_TRIVIAL(error) << (char *) ex;
+    throw ex;
+  }
+}
+
+namespace itcoin {
+namespace fbft {
+namespace state {
+
+// The persistence file of the engine is attached process-wide, see init_notx
+static std::mutex g_init_mutex;
+
+ReplicaEngine::ReplicaEngine(const itcoin::FbftConfig& conf,
+Blockchain& blockchain,
+RoastWallet& wallet):
+m_conf(conf),
+m_blockchain(blockchain),
+m_wallet(wallet)
+{
+  PL_thread_attr_t attributes{};
+  m_pl_engine = PL_create_engine(&attributes);
+  if (m_pl_engine == nullptr)
+  {
+    string error_msg = str(
+      boost::format("R%1% unable to create the Prolog engine")
+        % m_conf.id()
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw std::runtime_error(error_msg);
+  }
+}
+
+ReplicaEngine::~ReplicaEngine()
+{
+  PL_destroy_engine(m_pl_engine);
+}
+
+ReplicaEngine::ThreadGuard::ThreadGuard(const ReplicaEngine& engine):
+m_engine(engine)
+{
+  m_engine.AttachThread();
+}
+
+ReplicaEngine::ThreadGuard::~ThreadGuard()
+{
+  m_engine.DetachThread();
+}
+
+void ReplicaEngine::AttachThread() const
+{
+  PL_engine_t previous_pl_engine;
+  int result = PL_set_engine(m_pl_engine, &previous_pl_engine);
+  if (result != PL_ENGINE_SET)
+  {
+    string error_msg = str(
+      boost::format("R%1% unable to bind the Prolog engine to the calling thread, is it in use by another thread?")
+        % m_conf.id()
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw std::runtime_error(error_msg);
+  }
+  m_previous_pl_engines.push_back(previous_pl_engine);
+}
+
+void ReplicaEngine::DetachThread() const
+{
+  PL_set_engine(m_previous_pl_engines.back(), nullptr);
+  m_previous_pl_engines.pop_back();
+}
+
+void ReplicaEngine::Init(uint32_t start_height, std::string start_hash, uint32_t start_time)
+{
+  uint32_t replica_id = m_conf.id();
+  uint32_t cluster_size = m_conf.cluster_size();
+  uint32_t target_block_time = m_conf.target_block_time();
+
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% creating PL database with \
+    cluster_size=%2% \
+    start_height=%3%, \
+    start_hash=%4%, \
+    start_time=%5%, \
+    genesis_block_timestamp=%6%, \
+    target_block_time=%7%, \
+    db_filename=%8%, \
+    db_reset=%9%")
+      % m_conf.id()
+      % m_conf.cluster_size()
+      % start_height
+      % start_hash
+      % start_time
+      % m_conf.genesis_block_timestamp()
+      % m_conf.target_block_time()
+      % m_conf.fbft_db_filename()
+      % m_conf.fbft_db_reset()
+  );
+  PlTermv args(
+    PlTerm((long) replica_id),
+    PlTerm((long) cluster_size),
+    PlTerm((long) start_height),
+    PlString(start_hash.c_str()),
+    PlTerm((long) start_time),
+    PlTerm((long) m_conf.genesis_block_timestamp()),
+    PlTerm((long) target_block_time),
+    PlString(m_conf.fbft_db_filename().c_str()),
+    PlTerm(m_conf.fbft_db_reset())
+  );
+  std::lock_guard<std::mutex> lock(g_init_mutex);
+  prolog_engine_one_shot_call("init", args);
+
+  // The watermark window is a global of this engine, it is not persisted
+  prolog_engine_one_shot_call("set_request_buffer_len", PlTermv(PlTerm((long) m_conf.fbft_request_buffer_len())));
+
+  // The digest scheme is set once at startup, since it is shared with the other engines of the process
+  messages::DIGEST_SCHEME digest_scheme = messages::digest_scheme_from_string(m_conf.fbft_digest_scheme());
+  if (digest_scheme != messages::digest_scheme())
+  {
+    string error_msg = str(
+      boost::format("R%1% is configured with the %2% digest scheme, but the process uses the %3% one")
+        % replica_id
+        % m_conf.fbft_digest_scheme()
+        % messages::DIGEST_SCHEME_AS_STRING[static_cast<unsigned int>(messages::digest_scheme())]
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw std::runtime_error(error_msg);
+  }
+
+  // A fresh message log does not reference any block
+  if (m_conf.fbft_db_reset())
+  {
+    BlockStore::Instance().ReleaseAll(replica_id);
+  }
+}
+
+std::vector<std::unique_ptr<actions::Action>> ReplicaEngine::BuildActives(actions::ACTION_TYPE type)
+{
+  std::vector<std::unique_ptr<actions::Action>> results{};
+  try
+  {
+    results = actions::StateActions::BuildActives(type, m_conf, m_blockchain, m_wallet);
+  }
+  catch ( PlException &ex )
+  {
+    BOOST_LOG_TRIVIAL(error) << (char *) ex;
+    throw ex;
+  }
+  return results;
+}
+
+void ReplicaEngine::ReclaimMemory()
+{
+  // On 2022 Nov 30, we experienced once the following:
+  // 15398 [2022-Nov-30 16:04:57.933528] [error] error(resource_error(stack), stack_overflow{
+  // choicepoints:3,depth:2,environments:3,globalused:895048,localused:2692,
+  // stack:[frame(2,user:msg_log_commit(2,2,62,_192953056,2,_192953060),[]),
+  // frame(1,user:pre_SEND_COMMIT("(H=62, T=1669820690)",2,62,2),[]),frame(0,system:'$c_call_prolog',[])],stack_limit:1048576,trailused:618
+  // }) terminate called after throwing an instance of 'PlException'
+  // Similar to:
+  // https://discourse.swi-prolog.org/t/stack-overflow-problem/520/4
+  prolog_engine_one_shot_call("garbage_collect", PlTermv(0));
+}
+
+std::vector<std::unique_ptr<messages::Message>> ReplicaEngine::BuildToBeSent()
+{
+  std::vector<std::unique_ptr<messages::Message>> results{};
+  try
+  {
+    results = messages::ReplicaMessages::BuildToBeSent(m_conf.id());
+  }
+  catch ( PlException &ex )
+  {
+    BOOST_LOG_TRIVIAL(error) << (char *) ex;
+    throw ex;
+  }
+  return results;
+}
+
+void ReplicaEngine::ClearToBeSent()
+{
+  prolog_engine_one_shot_call("msg_out_clear_all", PlTermv(PlTerm{(long) m_conf.id()}));
+}
+
+double ReplicaEngine::latest_request_time() const
+{
+  PlTerm Max_t;
+  int result = prolog_engine_one_shot_call("get_latest_request_time", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    Max_t
+  ));
+  if (result)
+    return (double) Max_t;
+  else
+  {
+    return m_conf.genesis_block_timestamp();
+  }
+}
+
+double ReplicaEngine::latest_reply_time() const
+{
+  PlTerm Last_rep_t;
+  int result = prolog_engine_one_shot_call("last_rep", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    Last_rep_t
+  ));
+  if (result)
+    return (double) Last_rep_t;
+  else
+  {
+    return m_conf.genesis_block_timestamp();
+  }
+}
+
+double ReplicaEngine::current_time() const
+{
+  PlTerm Synthetic_time;
+  prolog_engine_one_shot_call("get_synthetic_time", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    Synthetic_time
+  ));
+  return (double) Synthetic_time;
+}
+
+uint32_t ReplicaEngine::h() const
+{
+  PlTerm H;
+  prolog_engine_one_shot_call("get_h", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    H
+  ));
+  return (long) H;
+}
+
+uint32_t ReplicaEngine::primary() const
+{
+  PlTerm Primary;
+  prolog_engine_one_shot_call("primary", PlTermv(
+    PlTerm{(long) view()},
+    Primary
+  ));
+  return (long) Primary;
+}
+
+uint32_t ReplicaEngine::view() const
+{
+  PlTerm View_i;
+  prolog_engine_one_shot_call("view", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    View_i
+  ));
+  return (long) View_i;
+}
+
+double ReplicaEngine::latest_compaction_time() const
+{
+  PlTerm N, Duration;
+  int result = prolog_engine_one_shot_call("gc_latest_compaction", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    N,
+    Duration
+  ));
+  if (result)
+    return (double) Duration;
+  else
+    return 0;
+}
+
+std::optional<double> ReplicaEngine::next_request_time() const
+{
+  PlTerm Next_t;
+  int result = prolog_engine_one_shot_call("get_next_request_time", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    Next_t
+  ));
+  if (result)
+    return (double) Next_t;
+  else
+    return std::nullopt;
+}
+
+std::optional<double> ReplicaEngine::view_change_deadline() const
+{
+  PlTerm Deadline;
+  int result = prolog_engine_one_shot_call("get_view_change_deadline", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    Deadline
+  ));
+  if (result)
+    return (double) Deadline;
+  else
+    return std::nullopt;
+}
+
+void ReplicaEngine::set_synthetic_time(double time)
+{
+  prolog_engine_one_shot_call("set_synthetic_time", PlTermv(
+    PlTerm{(long) m_conf.id()},
+    PlTerm{(double) time}
+  ));
+}
+
+}
+}
+}
@@ -5,6 +5,7 @@
 
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
+#include <chrono>
 #include <string>
 #include <SWI-cpp.h>
 
@@ -17,25 +18,76 @@ using namespace std;
 using namespace itcoin::blockchain;
 using namespace itcoin::wallet;
 
-// utilities
-
-static int prolog_engine_one_shot_call(const string predicate, const PlTermv args)
-{
-  try
-  {
-    return PlCall(predicate.c_str(), args);
-  }
-  catch ( PlException &ex )
-  {
-    BOOST_LOG_TRIVIAL(error) << (char *) ex;
-    throw ex;
-  }
-}
-
 namespace itcoin {
 namespace fbft {
 namespace state {
 
+// The actions that depend on the replica state, in the order they appear among the active actions
+static const std::vector<actions::ACTION_TYPE> STATE_DEPENDENT_ACTIONS{
+  actions::ACTION_TYPE::EXECUTE,
+  actions::ACTION_TYPE::SEND_COMMIT,
+  actions::ACTION_TYPE::SEND_PREPARE,
+  actions::ACTION_TYPE::SEND_PRE_PREPARE,
+  actions::ACTION_TYPE::SEND_VIEW_CHANGE,
+  actions::ACTION_TYPE::RECOVER_VIEW,
+  actions::ACTION_TYPE::SEND_NEW_VIEW,
+  actions::ACTION_TYPE::PROCESS_NEW_VIEW,
+  actions::ACTION_TYPE::ROAST_INIT,
+};
+
+// The facets read by the precondition of each state dependent action, see the pre_* predicates in the engine
+static const std::map<actions::ACTION_TYPE, uint32_t> PRECONDITION_READS{
+  {actions::ACTION_TYPE::EXECUTE,
+    FACET_CHECKPOINTS | FACET_REQUESTS | FACET_PRE_PREPARES | FACET_PREPARES | FACET_COMMITS | FACET_ROAST},
+  {actions::ACTION_TYPE::SEND_COMMIT,
+    FACET_VIEW | FACET_CHECKPOINTS | FACET_REQUESTS | FACET_PRE_PREPARES | FACET_PREPARES | FACET_COMMITS},
+  {actions::ACTION_TYPE::SEND_PREPARE,
+    FACET_VIEW | FACET_CHECKPOINTS | FACET_REQUESTS | FACET_PRE_PREPARES | FACET_PREPARES},
+  {actions::ACTION_TYPE::SEND_PRE_PREPARE,
+    FACET_VIEW | FACET_CHECKPOINTS | FACET_REQUESTS | FACET_PRE_PREPARES | FACET_TIME},
+  {actions::ACTION_TYPE::SEND_VIEW_CHANGE,
+    FACET_VIEW | FACET_REQUESTS | FACET_TIME},
+  {actions::ACTION_TYPE::RECOVER_VIEW,
+    FACET_VIEW | FACET_CHECKPOINTS | FACET_COMMITS},
+  {actions::ACTION_TYPE::SEND_NEW_VIEW,
+    FACET_VIEW | FACET_VIEW_CHANGES | FACET_NEW_VIEWS},
+  {actions::ACTION_TYPE::PROCESS_NEW_VIEW,
+    FACET_VIEW | FACET_VIEW_CHANGES | FACET_NEW_VIEWS | FACET_CHECKPOINTS | FACET_REQUESTS},
+  {actions::ACTION_TYPE::ROAST_INIT,
+    FACET_CHECKPOINTS | FACET_REQUESTS | FACET_PRE_PREPARES | FACET_PREPARES | FACET_COMMITS | FACET_ROAST},
+};
+
+// The facets written by the effect of each action, see the apply_* predicates in the engine
+static const std::map<actions::ACTION_TYPE, uint32_t> EFFECT_WRITES{
+  {actions::ACTION_TYPE::INVALID, FACET_ALL},
+  {actions::ACTION_TYPE::EXECUTE, FACET_CHECKPOINTS | FACET_REQUESTS},
+  {actions::ACTION_TYPE::PROCESS_NEW_VIEW, FACET_VIEW | FACET_PRE_PREPARES | FACET_PREPARES},
+  // Receiving a block moves the checkpoint and collects the garbage
+  {actions::ACTION_TYPE::RECEIVE_BLOCK, FACET_ALL},
+  {actions::ACTION_TYPE::RECEIVE_COMMIT, FACET_COMMITS | FACET_ROAST},
+  {actions::ACTION_TYPE::RECEIVE_NEW_VIEW, FACET_NEW_VIEWS},
+  {actions::ACTION_TYPE::RECEIVE_PREPARE, FACET_PREPARES},
+  {actions::ACTION_TYPE::RECEIVE_PRE_PREPARE, FACET_PRE_PREPARES},
+  {actions::ACTION_TYPE::RECEIVE_REQUEST, FACET_REQUESTS},
+  {actions::ACTION_TYPE::RECEIVE_VIEW_CHANGE, FACET_VIEW_CHANGES},
+  // Changing view clears the message log of the previous views
+  {actions::ACTION_TYPE::RECOVER_VIEW, FACET_ALL},
+  {actions::ACTION_TYPE::SEND_COMMIT, FACET_COMMITS},
+  {actions::ACTION_TYPE::SEND_NEW_VIEW, FACET_NEW_VIEWS},
+  {actions::ACTION_TYPE::SEND_PREPARE, FACET_PREPARES},
+  {actions::ACTION_TYPE::SEND_PRE_PREPARE, FACET_VIEW | FACET_PRE_PREPARES},
+  {actions::ACTION_TYPE::SEND_VIEW_CHANGE, FACET_ALL},
+  {actions::ACTION_TYPE::ROAST_INIT, FACET_ROAST},
+  {actions::ACTION_TYPE::ROAST_RECEIVE_PRE_SIGNATURE, FACET_ROAST},
+  {actions::ACTION_TYPE::ROAST_RECEIVE_SIGNATURE_SHARE, FACET_ROAST},
+};
+
+// Seconds since the Epoch, as get_time/1 in the engine
+static double system_time()
+{
+  return std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+}
+
 ReplicaState::ReplicaState(const itcoin::FbftConfig& conf,
 Blockchain& blockchain,
 RoastWallet& wallet,
@@ -44,219 +96,271 @@ std::string start_hash,
 uint32_t start_time):
 m_conf(conf),
 m_blockchain(blockchain),
-m_wallet(wallet)
+m_wallet(wallet),
+m_engine(std::make_unique<ReplicaEngine>(conf, blockchain, wallet)),
+m_precondition_evaluations(0),
+m_skipped_precondition_evaluations(0),
+m_self_delivered_messages(0),
+m_duplicate_messages(0),
+m_written_facets(FACET_NONE),
+m_stale_snapshot_facets(FACET_ALL)
 {
   Init(start_height, start_hash, start_time);
 }
 
 void ReplicaState::Init(uint32_t start_height, std::string start_hash, uint32_t start_time)
 {
-  uint32_t replica_id = m_conf.id();
-  uint32_t cluster_size = m_conf.cluster_size();
-  uint32_t target_block_time = m_conf.target_block_time();
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  m_engine->Init(start_height, start_hash, start_time);
+  InvalidatePreconditions(FACET_ALL);
+  m_stale_snapshot_facets = FACET_ALL;
 
-  BOOST_LOG_TRIVIAL(debug) << str(
-    boost::format("R%1% creating PL database with \
-    cluster_size=%2% \
-    start_height=%3%, \
-    start_hash=%4%, \
-    start_time=%5%, \
-    genesis_block_timestamp=%6%, \
-    target_block_time=%7%, \
-    db_filename=%8%, \
-    db_reset=%9%")
-      % m_conf.id()
-      % m_conf.cluster_size()
-      % start_height
-      % start_hash
-      % start_time
-      % m_conf.genesis_block_timestamp()
-      % m_conf.target_block_time()
-      % m_conf.fbft_db_filename()
-      % m_conf.fbft_db_reset()
-  );
-  PlTermv args(
-    PlTerm((long) replica_id),
-    PlTerm((long) cluster_size),
-    PlTerm((long) start_height),
-    PlString(start_hash.c_str()),
-    PlTerm((long) start_time),
-    PlTerm((long) m_conf.genesis_block_timestamp()),
-    PlTerm((long) target_block_time),
-    PlString(m_conf.fbft_db_filename().c_str()),
-    PlTerm(m_conf.fbft_db_reset())
-  );
-  prolog_engine_one_shot_call("init", args);
+  // The engine starts without synthetic time
+  {
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    m_synthetic_time.reset();
+  }
+  RefreshSnapshot();
+}
+
+void ReplicaState::RefreshSnapshot()
+{
+  // Only the values whose facets have been written are queried again
+  ReplicaStateSnapshot snapshot = m_snapshot;
+  snapshot.replica_id = m_conf.id();
+  if (m_stale_snapshot_facets & FACET_CHECKPOINTS)
+  {
+    snapshot.h = m_engine->h();
+    snapshot.latest_compaction_time = m_engine->latest_compaction_time();
+  }
+  if (m_stale_snapshot_facets & FACET_VIEW)
+  {
+    snapshot.view = m_engine->view();
+    snapshot.primary = m_engine->primary();
+  }
+  if (m_stale_snapshot_facets & FACET_REQUESTS)
+  {
+    snapshot.latest_request_time = m_engine->latest_request_time();
+    snapshot.latest_reply_time = m_engine->latest_reply_time();
+  }
+  snapshot.current_time = m_synthetic_time.value_or(0);
+  m_stale_snapshot_facets = FACET_NONE;
+
+  std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+  m_snapshot = snapshot;
 }
 
-void ReplicaState::ReceiveIncomingMessage(std::unique_ptr<messages::Message> msg)
+void ReplicaState::ReceiveIncomingMessage(std::shared_ptr<const messages::Message> msg)
 {
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
   // Adds the received message to the input message buffer
-  m_in_msg_buffer.emplace_back(std::move(msg));
+  if (!BufferIncomingMessage(std::move(msg)))
+  {
+    return;
+  }
 
   // Update active actions
   UpdateActiveActions();
 }
 
-void ReplicaState::UpdateActiveActions()
+void ReplicaState::DeliverOwnMessage(std::unique_ptr<messages::Message> msg)
 {
-  // Clear the current active actions vector.
-  m_active_actions.clear();
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% delivering %2% to itself")
+      % m_conf.id()
+      % msg->identify()
+  );
+  // The engine records the messages of this replica with the same placeholder signature
+  msg->set_signature(messages::SIG_OWN_REPLICA);
+  if (BufferIncomingMessage(std::move(msg)))
+  {
+    m_self_delivered_messages += 1;
+  }
+}
 
-  /*
-   * Fill result actions that depend on the input message buffer
-   * The switch in the loop translate from Message to the corresponding ReceiveMessage action.
-   */
-  for (auto &msg : m_in_msg_buffer)
+bool ReplicaState::BufferIncomingMessage(std::shared_ptr<const messages::Message> msg)
+{
+  messages::message_key_t key = msg->key();
+
+  bool is_duplicate = m_in_msg_index.find(key) != m_in_msg_index.end();
+  std::optional<uint32_t> seq_number_opt = msg->seq_number_as_opt();
+  if (!is_duplicate && seq_number_opt.has_value())
   {
-    switch (msg->type()) {
-    case messages::MSG_TYPE::BLOCK:
-    {
-      messages::Block typed_msg{ dynamic_cast<messages::Block&>(*msg) };
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceiveBlock>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::REQUEST:
-    {
-      messages::Request typed_msg = messages::Request( dynamic_cast<messages::Request&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceiveRequest>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::PREPARE:
+    auto height_it = m_in_msg_future_buffer.find(seq_number_opt.value());
+    is_duplicate = height_it != m_in_msg_future_buffer.end() && height_it->second.find(key) != height_it->second.end();
+  }
+  if (is_duplicate)
+  {
+    BOOST_LOG_TRIVIAL(debug) << str(
+      boost::format("R%1% dropping duplicate %2%")
+        % m_conf.id()
+        % msg->identify()
+    );
+    m_duplicate_messages += 1;
+    return false;
+  }
+
+  auto msg_it = m_in_msg_buffer.insert(m_in_msg_buffer.end(), std::move(msg));
+  m_in_msg_index.emplace(std::move(key), msg_it);
+  return true;
+}
+
+void ReplicaState::ReleaseFutureMessages(uint32_t height)
+{
+  auto last_height_it = m_in_msg_future_buffer.upper_bound(height);
+  for (auto height_it = m_in_msg_future_buffer.begin(); height_it != last_height_it; height_it++)
+  {
+    for (auto& [key, msg]: height_it->second)
     {
-      messages::Prepare typed_msg = messages::Prepare( dynamic_cast<messages::Prepare&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceivePrepare>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
+      if (m_in_msg_index.find(key) != m_in_msg_index.end())
+      {
+        continue;
+      }
+      BOOST_LOG_TRIVIAL(debug) << str(
+        boost::format("R%1% moving %2% from the future buffer")
+          % m_conf.id()
+          % msg->identify()
+      );
+      auto msg_it = m_in_msg_buffer.insert(m_in_msg_buffer.end(), msg);
+      m_in_msg_index.emplace(key, msg_it);
     }
-    case messages::MSG_TYPE::PRE_PREPARE:
-    {
-      messages::PrePrepare typed_msg = messages::PrePrepare( dynamic_cast<messages::PrePrepare&>(*msg) );
+  }
+  m_in_msg_future_buffer.erase(m_in_msg_future_buffer.begin(), last_height_it);
+}
+
+std::shared_ptr<actions::Action> ReplicaState::BuildReceiveAction(const std::shared_ptr<const messages::Message>& p_msg) const
+{
+  // Each message type needs its own lambda, a missing one does not compile
+  uint32_t replica_id = m_conf.id();
+  return std::visit(utils::overloaded{
+    [replica_id](const std::shared_ptr<const messages::Block>& p_block) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceiveBlock>(replica_id, p_block);
+    },
+    [replica_id](const std::shared_ptr<const messages::Request>& p_request) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceiveRequest>(replica_id, p_request);
+    },
+    [this, replica_id](const std::shared_ptr<const messages::PrePrepare>& p_pre_prepare) -> std::shared_ptr<actions::Action> {
       double current_time = this->current_time();
       double pre_prepare_time_tolerance_delta = m_conf.C_PRE_PREPARE_ACCEPT_UNTIL_CURRENT_TIME_PLUS();
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceivePrePrepare>(
-        m_conf.id(), m_blockchain, current_time, pre_prepare_time_tolerance_delta, typed_msg
+      return std::make_shared<actions::ReceivePrePrepare>(
+        replica_id, m_blockchain, current_time, pre_prepare_time_tolerance_delta, p_pre_prepare
       );
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::COMMIT:
-    {
-      messages::Commit typed_msg = messages::Commit( dynamic_cast<messages::Commit&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceiveCommit>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::VIEW_CHANGE:
-    {
-      messages::ViewChange typed_msg = messages::ViewChange( dynamic_cast<messages::ViewChange&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceiveViewChange>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::NEW_VIEW:
-    {
-      messages::NewView typed_msg = messages::NewView( dynamic_cast<messages::NewView&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::ReceiveNewView>(m_wallet, m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::ROAST_PRE_SIGNATURE:
-    {
-      messages::RoastPreSignature typed_msg = messages::RoastPreSignature( dynamic_cast<messages::RoastPreSignature&>(*msg) );
+    },
+    [replica_id](const std::shared_ptr<const messages::Prepare>& p_prepare) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceivePrepare>(replica_id, p_prepare);
+    },
+    [replica_id](const std::shared_ptr<const messages::Commit>& p_commit) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceiveCommit>(replica_id, p_commit);
+    },
+    [replica_id](const std::shared_ptr<const messages::ViewChange>& p_view_change) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceiveViewChange>(replica_id, p_view_change);
+    },
+    [this, replica_id](const std::shared_ptr<const messages::NewView>& p_new_view) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::ReceiveNewView>(m_wallet, replica_id, p_new_view);
+    },
+    [this, replica_id](const std::shared_ptr<const messages::RoastPreSignature>& p_pre_signature) -> std::shared_ptr<actions::Action> {
       RoastWallet& wallet = dynamic_cast<wallet::RoastWallet&>(m_wallet);
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::RoastReceivePreSignature>(wallet, m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    case messages::MSG_TYPE::ROAST_SIGNATURE_SHARE:
-    {
-      messages::RoastSignatureShare typed_msg = messages::RoastSignatureShare( dynamic_cast<messages::RoastSignatureShare&>(*msg) );
-      std::unique_ptr<actions::Action> action = std::make_unique<actions::RoastReceiveSignatureShare>(m_conf.id(), typed_msg);
-      m_active_actions.emplace_back(std::move(action));
-      break;
-    }
-    } // switch(msg->Type())
-  }
+      return std::make_shared<actions::RoastReceivePreSignature>(wallet, replica_id, p_pre_signature);
+    },
+    [replica_id](const std::shared_ptr<const messages::RoastSignatureShare>& p_signature_share) -> std::shared_ptr<actions::Action> {
+      return std::make_shared<actions::RoastReceiveSignatureShare>(replica_id, p_signature_share);
+    },
+  }, messages::AllMessages::AsVariant(p_msg));
+}
 
-  /*
-   * Fill result with actions that depend on the current state
-   */
-  try
+void ReplicaState::InvalidatePreconditions(uint32_t facets)
+{
+  m_written_facets |= facets;
+  for (actions::ACTION_TYPE type : STATE_DEPENDENT_ACTIONS)
   {
-    for (auto& p_action :
-      actions::Execute::BuildActives(m_conf, m_blockchain, m_wallet) )
-    {
-      m_active_actions.emplace_back(std::move(p_action));
-    }
-
-    for (auto& p_action :
-      actions::SendCommit::BuildActives(m_conf, m_blockchain, m_wallet) )
+    if (PRECONDITION_READS.at(type) & facets)
     {
-      m_active_actions.emplace_back(std::move(p_action));
+      m_stale_preconditions.insert(type);
     }
+  }
+}
 
-    for (auto& p_action :
-      actions::SendPrepare::BuildActives(m_conf, m_blockchain, m_wallet) )
-    {
-      m_active_actions.emplace_back(std::move(p_action));
-    }
+void ReplicaState::InvalidateTime()
+{
+  // Time dependent preconditions, and the receive pre-prepare actions holding the previous time, are stale
+  InvalidatePreconditions(FACET_TIME);
+  for (auto it = m_receive_actions.begin(); it != m_receive_actions.end(); )
+  {
+    if (it->second->type() == actions::ACTION_TYPE::RECEIVE_PRE_PREPARE)
+      it = m_receive_actions.erase(it);
+    else
+      ++it;
+  }
+}
 
-    for (auto& p_action :
-      actions::SendPrePrepare::BuildActives(m_conf, m_blockchain, m_wallet) )
-    {
-      m_active_actions.emplace_back(std::move(p_action));
-    }
+void ReplicaState::UpdateActiveActions()
+{
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  // Clear the current active actions vector.
+  m_active_actions.clear();
 
-    for (auto& p_action :
-      actions::SendViewChange::BuildActives(m_conf, m_blockchain, m_wallet) )
-    {
-      m_active_actions.emplace_back(std::move(p_action));
-    }
+  // The wall clock moves between any two updates
+  if (!m_synthetic_time.has_value())
+  {
+    InvalidateTime();
+  }
 
-    for (auto& p_action :
-      actions::RecoverView::BuildActives(m_conf, m_blockchain, m_wallet) )
-    {
-      m_active_actions.emplace_back(std::move(p_action));
-    }
+  /*
+   * Fill result actions that depend on the input message buffer.
+   * Only the messages that entered the buffer since the previous update are translated into the
+   * corresponding ReceiveMessage action, the others reuse the action built back then.
+   */
+  std::map<const messages::Message*, std::shared_ptr<actions::Action>> receive_actions;
+  for (auto &msg : m_in_msg_buffer)
+  {
+    auto it = m_receive_actions.find(msg.get());
+    std::shared_ptr<actions::Action> action = ( it != m_receive_actions.end() ) ? it->second : BuildReceiveAction(msg);
+    receive_actions.emplace(msg.get(), action);
+    m_active_actions.emplace_back(action);
+  }
+  m_receive_actions = std::move(receive_actions);
 
-    for (auto& p_action :
-      actions::SendNewView::BuildActives(m_conf, m_blockchain, m_wallet) )
+  /*
+   * Fill result with actions that depend on the current state.
+   * Only the preconditions reading some portion of the state that changed since the previous update are re-evaluated.
+   */
+  for (actions::ACTION_TYPE type : STATE_DEPENDENT_ACTIONS)
+  {
+    if (m_stale_preconditions.count(type))
     {
-      m_active_actions.emplace_back(std::move(p_action));
+      std::vector<std::shared_ptr<actions::Action>> typed_actions{};
+      for (auto& p_action : m_engine->BuildActives(type))
+      {
+        typed_actions.emplace_back(std::move(p_action));
+      }
+      m_state_actions[type] = std::move(typed_actions);
+      m_precondition_evaluations += 1;
     }
-
-    for (auto& p_action :
-      actions::ProcessNewView::BuildActives(m_conf, m_blockchain, m_wallet) )
+    else
     {
-      m_active_actions.emplace_back(std::move(p_action));
+      m_skipped_precondition_evaluations += 1;
     }
 
-    for (auto& p_action :
-      actions::RoastInit::BuildActives(m_conf, m_blockchain, m_wallet) )
+    for (auto& p_action : m_state_actions[type])
     {
-      m_active_actions.emplace_back(std::move(p_action));
+      m_active_actions.emplace_back(p_action);
     }
   }
-  catch ( PlException &ex )
+
+  if (!m_stale_preconditions.empty())
   {
-    BOOST_LOG_TRIVIAL(error) << (char *) ex;
-    throw ex;
+    m_engine->ReclaimMemory();
+    m_stale_preconditions.clear();
   }
 
-  // On 2022 Nov 30, we experienced once the following:
-  // 15398 [2022-Nov-30 16:04:57.933528] [error] error(resource_error(stack), stack_overflow{
-  // choicepoints:3,depth:2,environments:3,globalused:895048,localused:2692,
-  // stack:[frame(2,user:msg_log_commit(2,2,62,_192953056,2,_192953060),[]),
-  // frame(1,user:pre_SEND_COMMIT("(H=62, T=1669820690)",2,62,2),[]),frame(0,system:'$c_call_prolog',[])],stack_limit:1048576,trailused:618
-  // }) terminate called after throwing an instance of 'PlException'
-  // Similar to:
-  // https://discourse.swi-prolog.org/t/stack-overflow-problem/520/4
-  prolog_engine_one_shot_call("garbage_collect", PlTermv(0));
-
-  for(unique_ptr<actions::Action>& action: m_active_actions)
+  BOOST_LOG_TRIVIAL(trace) << str(
+    boost::format("R%1% precondition evaluations = %2%, skipped = %3%")
+      % m_conf.id()
+      % m_precondition_evaluations
+      % m_skipped_precondition_evaluations
+  );
+
+  for(shared_ptr<actions::Action>& action: m_active_actions)
   {
     BOOST_LOG_TRIVIAL(debug) <<
       "R" << m_conf.id() << " action " <<
@@ -266,62 +370,95 @@ void ReplicaState::UpdateActiveActions()
 
 void ReplicaState::UpdateOutMessageBuffer()
 {
-  try
+  // Clear the current out buffer vector.
+  m_out_msg_buffer.clear();
+
+  for (auto& p_msg : m_engine->BuildToBeSent())
   {
-    // Clear the current out buffer vector.
-    m_out_msg_buffer.clear();
+    m_out_msg_buffer.emplace_back(std::move(p_msg));
+  }
 
-    for (auto& p_msg : messages::PrePrepare::BuildToBeSent(m_conf.id()) )
+  for(unique_ptr<messages::Message>& message: m_out_msg_buffer)
     {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
+      BOOST_LOG_TRIVIAL(trace) <<
+        "R" << m_conf.id() <<
+        " has " << *message <<
+        " in the output buffer";
     }
+}
 
-    for (auto& p_msg : messages::Prepare::BuildToBeSent(m_conf.id()) )
-    {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
-    }
+void ReplicaState::Apply(const actions::Action& action)
+{
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  ApplyEffect(action);
+  RefreshSnapshot();
 
-    for (auto& p_msg : messages::Commit::BuildToBeSent(m_conf.id()) )
-    {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
-    }
+  /*
+   * Retrieve messages that need to be sent and add them to the output buffer
+   */
+  UpdateOutMessageBuffer();
 
-    for (auto& p_msg : messages::ViewChange::BuildToBeSent(m_conf.id()) )
-    {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
-    }
+  /*
+   * Update active actions
+   */
+  UpdateActiveActions();
+}
 
-    for (auto& p_msg : messages::NewView::BuildToBeSent(m_conf.id()) )
+BatchStats ReplicaState::ApplyBatch(const std::vector<std::shared_ptr<actions::Action>>& actions)
+{
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
+  BatchStats stats;
+
+  /*
+   * Apply the effects of all the actions whose precondition still holds.
+   * Receive actions check their message in the effect itself, the state dependent ones are deferred
+   * if an effect applied before them, possibly a nested one, wrote what their precondition reads.
+   */
+  m_written_facets = FACET_NONE;
+  for (const std::shared_ptr<actions::Action>& p_action : actions)
+  {
+    auto reads_it = PRECONDITION_READS.find(p_action->type());
+    if (reads_it != PRECONDITION_READS.end() && (reads_it->second & m_written_facets))
     {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
+      stats.deferred += 1;
+      continue;
     }
-
-    for (auto& p_msg : messages::RoastPreSignature::BuildToBeSent(m_conf.id()) )
+    if (ApplyEffect(*p_action))
     {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
+      stats.applied += 1;
     }
-
-    for (auto& p_msg : messages::RoastSignatureShare::BuildToBeSent(m_conf.id()) )
+    else
     {
-      m_out_msg_buffer.emplace_back(std::move(p_msg));
+      stats.failed += 1;
     }
   }
-  catch ( PlException &ex )
-  {
-    BOOST_LOG_TRIVIAL(error) << (char *) ex;
-    throw ex;
-  }
 
-  for(unique_ptr<messages::Message>& message: m_out_msg_buffer)
-    {
-      BOOST_LOG_TRIVIAL(trace) <<
-        "R" << m_conf.id() <<
-        " has " << *message <<
-        " in the output buffer";
-    }
+  /*
+   * Refresh the mirror, the output buffer and the active actions once for the whole batch
+   */
+  auto refresh_start = std::chrono::steady_clock::now();
+  RefreshSnapshot();
+  UpdateOutMessageBuffer();
+  UpdateActiveActions();
+  stats.refresh_time = std::chrono::duration<double>(std::chrono::steady_clock::now() - refresh_start).count();
+
+  // Applying the actions one by one would have refreshed after each of them, assume at the same cost
+  uint32_t num_effects = stats.applied + stats.failed;
+  stats.estimated_saved_refresh_time = num_effects > 1 ? (num_effects - 1) * stats.refresh_time : 0;
+
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% applied a batch of %2% actions, %3% failed, %4% deferred, refresh took %5% s, estimated saving %6% s")
+      % m_conf.id()
+      % stats.applied
+      % stats.failed
+      % stats.deferred
+      % stats.refresh_time
+      % stats.estimated_saved_refresh_time
+  );
+  return stats;
 }
 
-void ReplicaState::Apply(const actions::Action& action)
+bool ReplicaState::ApplyEffect(const actions::Action& action)
 {
   /*
    * Apply the effect of the action
@@ -342,6 +479,17 @@ void ReplicaState::Apply(const actions::Action& action)
       );
       BOOST_LOG_TRIVIAL(error) << error_msg;
     }
+    else
+    {
+      // The mirror is refreshed once by Apply and ApplyBatch, unless the height read below has changed
+      uint32_t written_facets = EFFECT_WRITES.at(action.type());
+      InvalidatePreconditions(written_facets);
+      m_stale_snapshot_facets |= written_facets;
+      if (written_facets & FACET_CHECKPOINTS)
+      {
+        RefreshSnapshot();
+      }
+    }
   }
   catch ( PlException &ex )
   {
@@ -350,177 +498,194 @@ void ReplicaState::Apply(const actions::Action& action)
   }
 
   /*
-   * If the action was a ReceiveMessage type, update the two input buffers (normal one and awaiting checkpoint one) accordingly
+   * If the action was a ReceiveMessage type, update the two input buffers (normal one and future one) accordingly
    */
   std::optional<std::reference_wrapper<const messages::Message>> processed_msg_opt = action.message();
   if (processed_msg_opt.has_value())
   {
     const messages::Message& processed_msg = processed_msg_opt.value().get();
 
-    // If the message was a succesfully applied BLOCK, we move all messages from the awaiting_checkpoint buffer to the input buffer
+    // If the message was a succesfully applied BLOCK, the messages of the new current height go back to the input buffer
     if ( action_execution_success && processed_msg.type() == messages::MSG_TYPE::BLOCK )
     {
-      // Perhaps this could be improved by having a map (height -> set of messages), or a specialized data structure, rather than a vector.
-      // Still, since the number of messages in the buffers will be relatively low, this could possibly perform even better than a map,
-      // despite the worse complexity.
-      for (size_t i=0; i<m_in_msg_awaiting_checkpoint_buffer.size(); i++)
-      {
-        unique_ptr<messages::Message> msg = move(m_in_msg_awaiting_checkpoint_buffer.at(i));
-        BOOST_LOG_TRIVIAL(debug) << str(
-          boost::format("R%1% moving %2% from the awaiting checkpoint buffer")
-            % std::to_string(m_conf.id())
-            % msg->identify()
-        );
-        m_in_msg_buffer.emplace_back(move(msg));
-      }
-      m_in_msg_awaiting_checkpoint_buffer.clear();
+      BOOST_LOG_TRIVIAL(debug) << str(
+        boost::format("R%1% compacted the message log up to H=%2% in %3% s")
+          % m_conf.id()
+          % this->h()
+          % m_engine->latest_compaction_time()
+      );
+
+      // The engine no longer references the blocks up to the new height
+      BlockStore::Instance().Release(m_conf.id(), this->h());
+
+      // Only the height that just became the current one can be applied now, the following ones keep waiting
+      ReleaseFutureMessages(this->h() + 1);
     }
 
     // In any case we remove the corresponding message from the input message buffer
-    for (size_t i=0; i<m_in_msg_buffer.size(); i++)
+    messages::message_key_t key = processed_msg.key();
+    auto index_it = m_in_msg_index.find(key);
+    if (index_it != m_in_msg_index.end())
     {
-      const messages::Message& msg = *m_in_msg_buffer.at(i);
-      if ( msg == processed_msg )
+      std::shared_ptr<const messages::Message> msg = *index_it->second;
+
+      // If the action could not be applied because the message refers, via sequence number, to a future block
+      // We move the message in the future buffer. These are the heights in the watermark window that cannot be
+      // applied before their parent block reaches the chain, and the fbft_future_msg_window heights above it.
+      uint32_t h = this->h();
+      uint32_t max_height = h + m_conf.fbft_request_buffer_len() + m_conf.fbft_future_msg_window();
+      std::optional<uint32_t> seq_number_opt = processed_msg.seq_number_as_opt();
+      if ( !action_execution_success && seq_number_opt.has_value()
+        && seq_number_opt.value() >= h + 2 && seq_number_opt.value() <= max_height )
       {
-        // If the action could not be applied because the message refers, via sequence number, to a future block
-        // We move the message in the awaiting_checkpoint buffer
-        uint32_t h = this->h();
-        if ( !action_execution_success && processed_msg.seq_number_as_opt().has_value() && processed_msg.seq_number_as_opt().value() == h + 2 )
-        {
-          BOOST_LOG_TRIVIAL(debug) << str(
-            boost::format("R%1% moving %2% to the awaiting checkpoint buffer")
-              % std::to_string(m_conf.id())
-              % msg.identify()
-          );
-          m_in_msg_awaiting_checkpoint_buffer.emplace_back(std::move(m_in_msg_buffer.at(i))); // This makes msg a nullptr, not an issue, it will be removed
-        }
-        m_in_msg_buffer.erase(m_in_msg_buffer.begin()+i);
-        break;
+        BOOST_LOG_TRIVIAL(debug) << str(
+          boost::format("R%1% moving %2% to the future buffer")
+            % std::to_string(m_conf.id())
+            % msg->identify()
+        );
+        m_in_msg_future_buffer[seq_number_opt.value()].emplace(key, msg);
       }
+      m_receive_actions.erase(msg.get());
+      m_in_msg_buffer.erase(index_it->second);
+      m_in_msg_index.erase(index_it);
     }
 
   }
 
-  /*
-   * Retrieve messages that need to be sent and add them to the output buffer
-   */
-  UpdateOutMessageBuffer();
-
-  /*
-   * Update active actions
-   */
-  UpdateActiveActions();
+  return action_execution_success;
 }
 
 void ReplicaState::ClearOutMessageBuffer() {
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
   BOOST_LOG_TRIVIAL(debug) << str(
     boost::format("R%1% clearing the output buffer")
       % std::to_string(m_conf.id())
     );
   // Clean the message out buffer both on the engine and on the vector
-  prolog_engine_one_shot_call("msg_out_clear_all", PlTermv(PlTerm{(long) m_conf.id()}));
+  m_engine->ClearToBeSent();
   m_out_msg_buffer.clear();
 
 }
 
+// The scalar getters read the mirror, see RefreshSnapshot
+
 double ReplicaState::latest_request_time() const
 {
-  PlTerm Max_t;
-  int result = prolog_engine_one_shot_call("get_latest_request_time", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    Max_t
-  ));
-  if (result)
-    return (double) Max_t;
-  else
-  {
-    return m_conf.genesis_block_timestamp();
-  }
+  return m_snapshot.latest_request_time;
 }
 
 double ReplicaState::latest_reply_time() const
 {
-  PlTerm Last_rep_t;
-  int result = prolog_engine_one_shot_call("last_rep", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    Last_rep_t
-  ));
-  if (result)
-    return (double) Last_rep_t;
-  else
-  {
-    return m_conf.genesis_block_timestamp();
-  }
+  return m_snapshot.latest_reply_time;
 }
 
 double ReplicaState::current_time() const
 {
-  PlTerm Synthetic_time;
-  prolog_engine_one_shot_call("get_synthetic_time", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    Synthetic_time
-  ));
-  return (double) Synthetic_time;
+  if (m_synthetic_time.has_value())
+  {
+    return m_synthetic_time.value();
+  }
+  return system_time();
 }
 
 uint32_t ReplicaState::h() const
 {
-  PlTerm H;
-  prolog_engine_one_shot_call("get_h", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    H
-  ));
-  return (long) H;
+  return m_snapshot.h;
 }
 
 uint32_t ReplicaState::primary() const
 {
-  PlTerm Primary;
-  prolog_engine_one_shot_call("primary", PlTermv(
-    PlTerm{(long) view()},
-    Primary
-  ));
-  return (long) Primary;
+  return m_snapshot.primary;
 }
 
 uint32_t ReplicaState::view() const
 {
-  PlTerm View_i;
-  prolog_engine_one_shot_call("view", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    View_i
-  ));
-  return (long) View_i;
+  return m_snapshot.view;
+}
+
+double ReplicaState::latest_compaction_time() const
+{
+  return m_snapshot.latest_compaction_time;
+}
+
+ReplicaStateSnapshot ReplicaState::snapshot() const
+{
+  std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+  ReplicaStateSnapshot result = m_snapshot;
+  if (!m_synthetic_time.has_value())
+  {
+    result.current_time = system_time();
+  }
+  return result;
 }
 
-const std::vector<std::unique_ptr<messages::Message>>& ReplicaState::in_msg_buffer() const
+const std::list<std::shared_ptr<const messages::Message>>& ReplicaState::in_msg_buffer() const
 {
   return m_in_msg_buffer;
 }
 
+size_t ReplicaState::future_msg_buffer_size() const
+{
+  size_t result = 0;
+  for (const auto& [height, msgs]: m_in_msg_future_buffer)
+  {
+    result += msgs.size();
+  }
+  return result;
+}
+
 const std::vector<std::unique_ptr<messages::Message>>& ReplicaState::out_msg_buffer() const
 {
   return m_out_msg_buffer;
 }
 
-const std::vector<std::unique_ptr<actions::Action>>& ReplicaState::active_actions() const
+const std::vector<std::shared_ptr<actions::Action>>& ReplicaState::active_actions() const
 {
   return m_active_actions;
 }
 
+const ReplicaEngine& ReplicaState::engine() const
+{
+  return *m_engine;
+}
+
+uint64_t ReplicaState::precondition_evaluations() const
+{
+  return m_precondition_evaluations;
+}
+
+uint64_t ReplicaState::skipped_precondition_evaluations() const
+{
+  return m_skipped_precondition_evaluations;
+}
+
+uint64_t ReplicaState::self_delivered_messages() const
+{
+  return m_self_delivered_messages;
+}
+
+uint64_t ReplicaState::duplicate_messages() const
+{
+  return m_duplicate_messages;
+}
+
 // Setters
 
 void ReplicaState::set_synthetic_time(double time)
 {
+  ReplicaEngine::ThreadGuard engine_guard{*m_engine};
   BOOST_LOG_TRIVIAL(debug) << str(
     boost::format("R%1% setting synthetic time = %2%")
       % std::to_string(m_conf.id())
       % std::to_string(time)
     );
-  prolog_engine_one_shot_call("set_synthetic_time", PlTermv(
-    PlTerm{(long) m_conf.id()},
-    PlTerm{(double) time}
-  ));
+  m_engine->set_synthetic_time(time);
+  {
+    std::lock_guard<std::mutex> lock(m_snapshot_mutex);
+    m_synthetic_time = time;
+  }
+  RefreshSnapshot();
+  InvalidateTime();
 
   /*
    * Update active actions
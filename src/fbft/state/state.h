@@ -4,6 +4,12 @@
 #ifndef ITCOIN_FBFT_STATE_STATE_H
 #define ITCOIN_FBFT_STATE_STATE_H
 
+#include <list>
+#include <map>
+#include <mutex>
+#include <optional>
+#include <set>
+
 #include "config/FbftConfig.h"
 #include "../actions/actions.h"
 #include "../messages/messages.h"
@@ -23,6 +29,115 @@ namespace itcoin {
 namespace fbft {
 namespace state {
 
+// The replica engine holds the state of the I/O automaton (message log,
+// checkpoints, view, sequence numbers, Pi/Qi and ROAST sessions), backed by
+// engine/fbft-replica-engine.pl, and evaluates the action preconditions on it.
+// Each instance runs on its own SWI-Prolog engine, hence with its own global variables,
+// while the dynamic database is shared and partitioned by replica id.
+class ReplicaEngine {
+  public:
+    ReplicaEngine(
+      const itcoin::FbftConfig& conf,
+      blockchain::Blockchain& blockchain,
+      wallet::RoastWallet& wallet
+    );
+    ~ReplicaEngine();
+
+    // Binds the engine to the calling thread while alive. Every call into the engine, including
+    // the ones of actions and messages, must happen under a guard, so that replicas owning
+    // different engines can be stepped on different threads. Guards can be nested.
+    class ThreadGuard {
+      public:
+        ThreadGuard(const ReplicaEngine& engine);
+        ~ThreadGuard();
+      private:
+        const ReplicaEngine& m_engine;
+    };
+
+    // Getters
+    double current_time() const;
+    double latest_request_time() const;
+    double latest_reply_time() const;
+    uint32_t h() const;
+    uint32_t primary() const;
+    uint32_t view() const;
+    // Seconds spent by the latest compaction of the message log, run when a block is received
+    double latest_compaction_time() const;
+    // Timestamp of the earliest logged request that is still in the future, if any
+    std::optional<double> next_request_time() const;
+    // Time after which a VIEW_CHANGE is due, if a request is still waiting for its reply
+    std::optional<double> view_change_deadline() const;
+
+    // Setters
+    void set_synthetic_time(double time);
+
+    // Operations
+    void AttachThread() const;
+    void DetachThread() const;
+    void Init(uint32_t start_height, std::string start_hash, uint32_t start_time);
+    // Actions of the given type that depend only on the engine state, i.e. not the Receive* ones
+    std::vector<std::unique_ptr<actions::Action>> BuildActives(actions::ACTION_TYPE type);
+    // Messages that the engine wants to be sent
+    std::vector<std::unique_ptr<messages::Message>> BuildToBeSent();
+    void ClearToBeSent();
+    // Gives back to the engine the memory used while evaluating the preconditions
+    void ReclaimMemory();
+
+  private:
+    const itcoin::FbftConfig& m_conf;
+    blockchain::Blockchain& m_blockchain;
+    wallet::RoastWallet& m_wallet;
+
+    PL_engine_t m_pl_engine;
+    // The engines bound to the calling thread before each AttachThread, restored by DetachThread
+    mutable std::vector<PL_engine_t> m_previous_pl_engines;
+};
+
+// Portions of the replica state that are read by the action preconditions and
+// written by the action effects. They are used to re-evaluate, after a state
+// change, only the preconditions that may have been affected by it.
+enum STATE_FACET : uint32_t {
+  FACET_NONE = 0,
+  FACET_REQUESTS = 1 << 0,      // msg_log_request, last_rep
+  FACET_PRE_PREPARES = 1 << 1,  // msg_log_pre_prepare, view_change_Qi
+  FACET_PREPARES = 1 << 2,      // msg_log_prepare, view_change_Pi
+  FACET_COMMITS = 1 << 3,       // msg_log_commit, msg_log_commit_view_recovery
+  FACET_VIEW_CHANGES = 1 << 4,  // msg_log_view_change
+  FACET_NEW_VIEWS = 1 << 5,     // msg_log_new_view
+  FACET_VIEW = 1 << 6,          // view, active_view, timeout, seqno
+  FACET_CHECKPOINTS = 1 << 7,   // checkpoint, last_exec
+  FACET_ROAST = 1 << 8,         // roast_*
+  FACET_TIME = 1 << 9,          // synthetic_time
+  FACET_ALL = (1 << 10) - 1,
+};
+
+// A consistent copy of the scalar state of a replica. It is refreshed from the engine after each
+// successful Apply and each change of the synthetic time, so it can be read without touching the engine.
+struct ReplicaStateSnapshot {
+  uint32_t replica_id = 0;
+  uint32_t h = 0;
+  uint32_t view = 0;
+  uint32_t primary = 0;
+  double latest_request_time = 0;
+  double latest_reply_time = 0;
+  double latest_compaction_time = 0;
+  // The synthetic time if set, otherwise the system time when the snapshot was read
+  double current_time = 0;
+};
+
+// Outcome of ReplicaState::ApplyBatch
+struct BatchStats {
+  uint32_t applied = 0;
+  uint32_t failed = 0;
+  // Actions not applied, since an effect applied before them wrote what their precondition reads
+  uint32_t deferred = 0;
+  // Seconds spent refreshing the output buffer and the active actions at the end of the batch
+  double refresh_time = 0;
+  // Estimate, not a measure, of the seconds saved by refreshing once rather than after each effect:
+  // refresh_time times the number of refreshes avoided, as if each of them had cost the same
+  double estimated_saved_refresh_time = 0;
+};
+
 // A replica state
 class ReplicaState {
   public:
@@ -37,15 +152,27 @@ class ReplicaState {
     ~ReplicaState() {};
 
     // Getters
-    const std::vector<std::unique_ptr<messages::Message>>& in_msg_buffer() const;
+    const std::list<std::shared_ptr<const messages::Message>>& in_msg_buffer() const;
+    // Number of messages waiting for their height to become the current one
+    size_t future_msg_buffer_size() const;
     const std::vector<std::unique_ptr<messages::Message>>& out_msg_buffer() const;
-    const std::vector<std::unique_ptr<actions::Action>>& active_actions() const;
+    const std::vector<std::shared_ptr<actions::Action>>& active_actions() const;
+    const ReplicaEngine& engine() const;
     double current_time() const;
     double latest_request_time() const;
     double latest_reply_time() const;
     uint32_t h() const;
     uint32_t primary() const;
     uint32_t view() const;
+    double latest_compaction_time() const;
+    uint64_t precondition_evaluations() const;
+    uint64_t skipped_precondition_evaluations() const;
+    // Number of messages this replica delivered to itself, see DeliverOwnMessage
+    uint64_t self_delivered_messages() const;
+    // Number of incoming messages dropped because already buffered
+    uint64_t duplicate_messages() const;
+    // Can be called from any thread, e.g. by metrics and status readers
+    ReplicaStateSnapshot snapshot() const;
 
     // Setters
     // Synthetic time is a floating point number expressing the time in seconds since the Epoch at 1970-01-01.
@@ -54,8 +181,10 @@ class ReplicaState {
     // Operations
     void Init(uint32_t start_height, std::string start_hash, uint32_t start_time);
     void Apply(const actions::Action& action);
+    // Applies the effects of the given actions that are not conflicting, then refreshes the state once
+    BatchStats ApplyBatch(const std::vector<std::shared_ptr<actions::Action>>& actions);
     void ClearOutMessageBuffer();
-    void ReceiveIncomingMessage(std::unique_ptr<messages::Message> msg);
+    void ReceiveIncomingMessage(std::shared_ptr<const messages::Message> msg);
     void UpdateActiveActions();
 
   protected:
@@ -64,19 +193,79 @@ class ReplicaState {
     blockchain::Blockchain& m_blockchain;
     wallet::RoastWallet& m_wallet;
 
-    // Buffer of incoming messages
-    std::vector<std::unique_ptr<messages::Message>> m_in_msg_buffer;
-    std::vector<std::unique_ptr<messages::Message>> m_in_msg_awaiting_checkpoint_buffer;
+    // The automaton
+    std::unique_ptr<ReplicaEngine> m_engine;
+
+    // Buffer of incoming messages, in order of arrival and indexed by key.
+    // They are immutable and shared with the corresponding receive actions.
+    std::list<std::shared_ptr<const messages::Message>> m_in_msg_buffer;
+    std::map<messages::message_key_t, std::list<std::shared_ptr<const messages::Message>>::iterator> m_in_msg_index;
+
+    // Messages that could not be applied yet because they refer to a future height, by height.
+    // The messages of a height go back to the input buffer when it becomes the current one.
+    std::map<uint32_t, std::map<messages::message_key_t, std::shared_ptr<const messages::Message>>> m_in_msg_future_buffer;
 
     // Buffer of outgoing messages
     std::vector<std::unique_ptr<messages::Message>> m_out_msg_buffer;
 
     // Active actions
-    std::vector<std::unique_ptr<actions::Action>> m_active_actions;
+    std::vector<std::shared_ptr<actions::Action>> m_active_actions;
+
+    // Trusted local path for the messages this replica addresses to itself, e.g. the ROAST messages
+    // of a primary that is both coordinator and signer. The message comes from the engine of this
+    // replica, hence it is neither signed nor verified, and never goes through the transport.
+    // The caller is in charge of updating the active actions.
+    void DeliverOwnMessage(std::unique_ptr<messages::Message> msg);
 
   private:
     // Update the set of messages to be sent
     void UpdateOutMessageBuffer();
+
+    // Adds the message to the input buffer, unless it is already there or in the future buffer, returns whether it was added
+    bool BufferIncomingMessage(std::shared_ptr<const messages::Message> msg);
+
+    // Moves the messages up to the given height from the future buffer to the input buffer
+    void ReleaseFutureMessages(uint32_t height);
+
+    // Translates a message of the input buffer to the corresponding receive action
+    std::shared_ptr<actions::Action> BuildReceiveAction(const std::shared_ptr<const messages::Message>& p_msg) const;
+
+    // Applies the effect of the action and updates the input buffers, returns whether it succeeded
+    bool ApplyEffect(const actions::Action& action);
+
+    // Marks as stale the preconditions reading any of the given facets
+    void InvalidatePreconditions(uint32_t facets);
+
+    // Marks as stale the time dependent preconditions and the cached receive pre-prepare actions
+    void InvalidateTime();
+
+    // Reads the scalar state written since the previous refresh from the engine into the mirror
+    void RefreshSnapshot();
+
+    // Receive actions already built, by message
+    std::map<const messages::Message*, std::shared_ptr<actions::Action>> m_receive_actions;
+
+    // State dependent actions already built, by precondition, and the preconditions to be re-evaluated
+    std::map<actions::ACTION_TYPE, std::vector<std::shared_ptr<actions::Action>>> m_state_actions;
+    std::set<actions::ACTION_TYPE> m_stale_preconditions;
+
+    // Precondition evaluation counters
+    uint64_t m_precondition_evaluations;
+    uint64_t m_skipped_precondition_evaluations;
+    uint64_t m_self_delivered_messages;
+    uint64_t m_duplicate_messages;
+
+    // Facets written since the start of the current batch
+    uint32_t m_written_facets;
+
+    // Mirror of the scalar engine state, served by the getters.
+    // It is only written by the thread owning the replica, while holding the mutex, so that
+    // the owning thread can read it without locking and the other threads take a snapshot.
+    ReplicaStateSnapshot m_snapshot;
+    std::optional<double> m_synthetic_time;
+    mutable std::mutex m_snapshot_mutex;
+    // Facets written since the previous refresh of the mirror
+    uint32_t m_stale_snapshot_facets;
 };
 
 }
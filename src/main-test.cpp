@@ -20,6 +20,7 @@
 
 #include <SWI-cpp.h>
 
+#include "fbft/messages/messages.h"
 #include "utils/utils.h"
 
 using namespace boost::unit_test;
@@ -46,5 +47,8 @@ int BOOST_TEST_CALL_DECL main( int argc, char* argv[] )
   char *argv2[] = {(char*)"thisisnonsense", (char*)"-f", (char*)"none", (char*)"-F", (char*)"none", (char*)"-g", (char*)"true"};
   PlEngine engine(7, argv2);
 
+  // The message digests follow the default fbft_digest_scheme, like the test configurations
+  itcoin::fbft::messages::set_digest_scheme(itcoin::fbft::messages::DIGEST_SCHEME::PROLOG);
+
   return ::boost::unit_test::unit_test_main( init_unit_test, argc, argv );
 }
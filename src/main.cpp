@@ -67,6 +67,9 @@ int main(int argc, char* argv[])
   BOOST_LOG_TRIVIAL(debug) << "The ID of this replica is: " << config.id();
   BOOST_LOG_TRIVIAL(debug) << "------------";
 
+  // The message digests are computed the same way by the whole process
+  fbft::messages::set_digest_scheme(fbft::messages::digest_scheme_from_string(config.fbft_digest_scheme()));
+
   transport::BtcClient btc_client{config.itcoin_uri()};
 
   blockchain::BitcoinBlockchain blockchain{config, btc_client};
@@ -101,10 +104,8 @@ int main(int argc, char* argv[])
   };
 
   // Start the replica
-  zcomm.replica_message_received.connect([&replica](const std::string& group_name, const std::string& bin_buffer) {
-    auto p_msg = fbft::messages::Message::BuildFromBinBuffer(bin_buffer);
-    // TODO: far ritornare direttamente unique_ptr e fare check per nullptr
-    replica.ReceiveIncomingMessage(std::move(p_msg.value()));
+  zcomm.replica_messages_received.connect([&replica](const std::vector<std::shared_ptr<const fbft::messages::Message>>& p_msgs) {
+    replica.ReceiveIncomingMessages(p_msgs);
   });
 
   zcomm.itcoinblock_received.connect([&replica](const std::string& hash_hex_string, int32_t block_height, uint32_t block_time, uint32_t seq_number) {
@@ -113,6 +114,13 @@ int main(int argc, char* argv[])
       replica.ReceiveIncomingMessage(std::move(p_msg));
   });
 
+  zcomm.deadlines_requested.connect([&replica](std::vector<double>& deadlines) {
+    std::optional<double> next_deadline = replica.NextDeadline();
+    if (next_deadline.has_value()) {
+      deadlines.push_back(next_deadline.value());
+    }
+  });
+
   zcomm.network_timeout_expired.connect([&replica]() {
     BOOST_LOG_TRIVIAL(trace) << "Network timeout expired. Call replica::CheckTimedAction()";
     replica.CheckTimedActions();
@@ -3,8 +3,12 @@
 
 #include "fixtures.h"
 
-ReplicaSetFixture::ReplicaSetFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time):
-ReplicaStateFixture(cluster_size, genesis_block_timestamp, target_block_time) {
+#include <functional>
+#include <thread>
+
+ReplicaSetFixture::ReplicaSetFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time,
+  uint32_t request_buffer_len):
+ReplicaStateFixture(cluster_size, genesis_block_timestamp, target_block_time, request_buffer_len) {
   for (int i = 0; i < CLUSTER_SIZE; i++)
   {
     auto transport = std::make_unique<DummyNetwork>(*m_configs.at(i));
@@ -29,6 +33,15 @@ ReplicaStateFixture(cluster_size, genesis_block_timestamp, target_block_time) {
   }
 }
 
+void ReplicaSetFixture::set_synthetic_time(double time)
+{
+  ReplicaStateFixture::set_synthetic_time(time);
+  for (auto p_replica : m_replica)
+  {
+    p_replica->set_synthetic_time(time);
+  }
+}
+
 void ReplicaSetFixture::kill(uint32_t replica_id) {
   if (!m_transports.at(replica_id)->active)
   {
@@ -108,3 +121,77 @@ void ReplicaSetFixture::move_forward(int time_delta)
   current_time += time_delta;
   set_synthetic_time(current_time);
 }
+
+void ReplicaSetFixture::move_forward_in_parallel(int time_delta)
+{
+  // Runs step on each active replica, on its own thread
+  auto in_parallel = [this](std::function<void(uint32_t)> step) {
+    std::vector<std::thread> threads;
+    for (uint32_t i = 0; i < CLUSTER_SIZE; i++)
+    {
+      if (m_transports[i]->active)
+      {
+        threads.emplace_back(step, i);
+      }
+    }
+    for (auto& thread : threads)
+    {
+      thread.join();
+    }
+  };
+
+  // The replicas submit the blocks on their own threads, the block messages are handed to each
+  // replica on its thread as well, together with the messages of the other replicas
+  std::vector<std::shared_ptr<network::NetworkListener>> blockchain_listeners;
+  blockchain_listeners.swap(m_blockchain->listeners);
+  size_t delivered_height = m_blockchain->height() + 1;
+
+  in_parallel([this](uint32_t i) { m_replica[i]->CheckTimedActions(); });
+
+  for (uint32_t N = 0; N < 10; N++)
+  {
+    std::vector<std::vector<std::shared_ptr<const Message>>> sent_msgs;
+    for (uint32_t i = 0; i < CLUSTER_SIZE; i++)
+    {
+      sent_msgs.emplace_back(m_transports[i]->TakeBufferedMessages());
+    }
+    size_t height = m_blockchain->height() + 1;
+    std::vector<CBlock> new_blocks(m_blockchain->chain.begin() + delivered_height, m_blockchain->chain.begin() + height);
+
+    in_parallel([&, this](uint32_t i) {
+      // Each replica gets its own copy of the messages, as from a real network
+      std::vector<std::shared_ptr<const Message>> inbox;
+      for (size_t k = 0; k < new_blocks.size(); k++)
+      {
+        inbox.emplace_back(std::make_shared<Block>(delivered_height + k, new_blocks[k].nTime, new_blocks[k].GetHash().GetHex()));
+      }
+      for (uint32_t j = 0; j < CLUSTER_SIZE; j++)
+      {
+        if (j == i || !m_transports[j]->active) continue;
+        for (auto& p_msg : sent_msgs[j])
+        {
+          inbox.emplace_back(p_msg->clone());
+        }
+      }
+      if (!inbox.empty())
+      {
+        m_replica[i]->ReceiveIncomingMessages(inbox);
+      }
+    });
+    delivered_height = height;
+  }
+
+  // The blocks submitted in the last round are notified as usual
+  m_blockchain->listeners.swap(blockchain_listeners);
+  for (size_t height = delivered_height; height < m_blockchain->chain.size(); height++)
+  {
+    for (auto& p_listener : m_blockchain->listeners)
+    {
+      p_listener->ReceiveIncomingMessage(std::make_unique<Block>(height, m_blockchain->chain[height].nTime, m_blockchain->chain[height].GetHash().GetHex()));
+    }
+  }
+
+  double current_time = m_replica[0]->current_time();
+  current_time += time_delta;
+  set_synthetic_time(current_time);
+}
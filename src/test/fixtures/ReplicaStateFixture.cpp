@@ -3,7 +3,8 @@
 
 #include "fixtures.h"
 
-ReplicaStateFixture::ReplicaStateFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time):
+ReplicaStateFixture::ReplicaStateFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time,
+  uint32_t request_buffer_len):
 PrologTestFixture(), CLUSTER_SIZE(cluster_size), GENESIS_BLOCK_TIMESTAMP(genesis_block_timestamp), TARGET_BLOCK_TIME(target_block_time)
 {
   BOOST_LOG_TRIVIAL(trace) << "Setup fixture ReplicaSetFixture";
@@ -21,6 +22,7 @@ PrologTestFixture(), CLUSTER_SIZE(cluster_size), GENESIS_BLOCK_TIMESTAMP(genesis
     config->set_target_block_time(TARGET_BLOCK_TIME);
     config->set_fbft_db_reset(true);
     config->set_fbft_db_filename("/tmp/miner.fbft.db");
+    config->set_fbft_request_buffer_len(request_buffer_len);
     m_configs.emplace_back(move(config));
 
     auto wallet = std::make_unique<DummyRoastWallet>(*m_configs.at(i));
@@ -44,3 +46,15 @@ void ReplicaStateFixture::set_synthetic_time(double time)
     p_state->set_synthetic_time(time);
   }
 }
+
+std::shared_ptr<Action> ReplicaStateFixture::find_active(ReplicaState& replica_state, ACTION_TYPE type)
+{
+  for (auto& p_action: replica_state.active_actions())
+  {
+    if (p_action->type() == type)
+    {
+      return p_action;
+    }
+  }
+  return nullptr;
+}
@@ -65,10 +65,14 @@ struct PrologTestFixture
 
 struct ReplicaStateFixture : PrologTestFixture
 {
-  ReplicaStateFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time);
+  ReplicaStateFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time,
+    uint32_t request_buffer_len = 1);
 
   void set_synthetic_time(double time);
 
+  // The first active action of the given type, nullptr if there is none
+  static std::shared_ptr<Action> find_active(ReplicaState& replica_state, ACTION_TYPE type);
+
   itcoin::SIGNATURE_ALGO_TYPE SIG_ALGO;
   uint32_t CLUSTER_SIZE;
   uint32_t GENESIS_BLOCK_TIMESTAMP;
@@ -84,11 +88,16 @@ struct ReplicaStateFixture : PrologTestFixture
 
 struct ReplicaSetFixture : ReplicaStateFixture
 {
-  ReplicaSetFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time);
+  ReplicaSetFixture(uint32_t cluster_size, uint32_t genesis_block_timestamp, uint32_t target_block_time,
+    uint32_t request_buffer_len = 1);
 
+  // Moves the clock of the replicas as well, they mirror it apart from the states
+  void set_synthetic_time(double time);
   void kill(uint32_t replica_id);
   void wake(uint32_t replica_id);
   void move_forward(int time_delta);
+  // As move_forward, but each replica is stepped on its own thread
+  void move_forward_in_parallel(int time_delta);
 
   std::vector<std::unique_ptr<DummyNetwork>> m_transports;
   std::vector<std::shared_ptr<Replica2>> m_replica;
@@ -36,6 +36,12 @@ CBlock DummyBlockchain::GenerateBlock(uint32_t block_timestamp) {
   return block;
 }
 
+CBlock DummyBlockchain::GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block) {
+  CBlock block = GenerateBlock(block_timestamp);
+  block.hashPrevBlock = parent_block.GetHash();
+  return block;
+}
+
 bool DummyBlockchain::TestBlockValidity(const uint32_t height, const CBlock& block, bool check_signet_solution)
 {
   return true;
@@ -46,21 +52,25 @@ void DummyBlockchain::SubmitBlock(const uint32_t height, const CBlock& block)
   BOOST_LOG_TRIVIAL(debug) << "Submitting a block to blockchain";
   CBlock b_copy{block};
 
-  if( height < chain.size() && chain[height].GetHash() != block.GetHash() )
-  {
-    throw runtime_error("submitting a different block at same height, double spending!");
-  }
-  if( height < chain.size() && chain[height].GetHash() == block.GetHash() )
   {
-    BOOST_LOG_TRIVIAL(debug) << "Block already present in the blockchain";
-    return;
-  }
-  if (height > chain.size())
-  {
-    throw runtime_error("submitting a block at height too far in the future, invalid chain!");
-  }
+    // The listeners are notified without the lock, they may submit blocks in turn
+    std::lock_guard<std::mutex> lock(m_mutex);
+    if( height < chain.size() && chain[height].GetHash() != block.GetHash() )
+    {
+      throw runtime_error("submitting a different block at same height, double spending!");
+    }
+    if( height < chain.size() && chain[height].GetHash() == block.GetHash() )
+    {
+      BOOST_LOG_TRIVIAL(debug) << "Block already present in the blockchain";
+      return;
+    }
+    if (height > chain.size())
+    {
+      throw runtime_error("submitting a block at height too far in the future, invalid chain!");
+    }
 
-  chain.emplace_back(b_copy);
+    chain.emplace_back(b_copy);
+  }
   for (shared_ptr<NetworkListener> p_listener: listeners)
   {
     unique_ptr<msgs::Block> p_msg = make_unique<msgs::Block>(height, b_copy.nTime, b_copy.GetHash().GetHex());
@@ -27,7 +27,7 @@ NetworkTransport(conf)
 {
 }
 
-void DummyNetwork::BroadcastMessage(std::unique_ptr<msgs::Message> p_msg)
+void DummyNetwork::BroadcastMessage(std::shared_ptr<const msgs::Message> p_msg)
 {
   if (!active) return;
 
@@ -49,13 +49,20 @@ void DummyNetwork::SimulateReceiveMessages()
     {
       if (p_listener->id() != m_conf.id())
       {
-        unique_ptr<msgs::Message> p_msg_clone = p_msg->clone();
-        p_listener->ReceiveIncomingMessage(move(p_msg_clone));
+        // Messages are immutable, every listener gets the same one
+        p_listener->ReceiveIncomingMessage(p_msg);
       }
     }
   }
   m_buffer.clear();
 }
 
+std::vector<std::shared_ptr<const msgs::Message>> DummyNetwork::TakeBufferedMessages()
+{
+  std::vector<std::shared_ptr<const msgs::Message>> result;
+  result.swap(m_buffer);
+  return result;
+}
+
 }
 }
@@ -4,6 +4,8 @@
 #ifndef ITCOIN_TEST_STUBS_STUBS_H
 #define ITCOIN_TEST_STUBS_STUBS_H
 
+#include <mutex>
+
 #include <boost/log/trivial.hpp>
 
 #include "../../blockchain/blockchain.h"
@@ -32,11 +34,13 @@ class DummyNetwork: public network::NetworkTransport, public NetworkStub
 {
   public:
     DummyNetwork(const itcoin::FbftConfig& conf);
-    void BroadcastMessage(std::unique_ptr<messages::Message> p_msg);
+    void BroadcastMessage(std::shared_ptr<const messages::Message> p_msg);
     void SimulateReceiveMessages();
+    // Hands over the messages broadcast since the previous call, instead of delivering them to the listeners
+    std::vector<std::shared_ptr<const messages::Message>> TakeBufferedMessages();
 
   private:
-    std::vector<std::unique_ptr<messages::Message>> m_buffer;
+    std::vector<std::shared_ptr<const messages::Message>> m_buffer;
 };
 
 class DummyBlockchain: public blockchain::Blockchain, public NetworkStub
@@ -49,12 +53,17 @@ class DummyBlockchain: public blockchain::Blockchain, public NetworkStub
     CBlock GenerateBlock(uint32_t block_timestamp);
     bool TestBlockValidity(const uint32_t height, const CBlock&, bool check_signet_solution);
     void SubmitBlock(const uint32_t height, const CBlock&);
-    uint32_t height(){ return chain.size()-1; }
+    bool CanGenerateOnPendingBlock() const { return true; }
+    CBlock GenerateBlockOnTopOf(uint32_t height, uint32_t block_timestamp, const CBlock& parent_block);
+    uint32_t height(){ std::lock_guard<std::mutex> lock(m_mutex); return chain.size()-1; }
 
     // Public attributes
     std::vector<CBlock> chain;
 
   private:
+    // Replicas stepped on different threads may submit the same block at the same time
+    std::mutex m_mutex;
+
     void Init();
 };
 
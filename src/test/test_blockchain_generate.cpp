@@ -102,4 +102,28 @@ BOOST_FIXTURE_TEST_CASE(test_block_generate_00, BitcoinInfraFixture)
   }
 } // test_generate_block
 
+// Integration test with Bitcoind for the generation of a block on top of one that is not on the chain yet
+BOOST_FIXTURE_TEST_CASE(test_block_generate_01, BitcoinInfraFixture)
+{
+  itcoin::transport::BtcClient& bitcoind0 = *m_bitcoinds.at(0);
+  std::string address0 = address_at(0);
+
+  uint32_t height = bitcoind0.getblockchaininfo()["blocks"].asUInt() + 2;
+  uint32_t block_time = get_present_block_time();
+  CBlock parent_block = generateBlock(bitcoind0, address0, block_time);
+  CBlock block = generateBlockOnTopOf(bitcoind0, address0, height, block_time + 60, parent_block);
+
+  BOOST_TEST(block.hashPrevBlock == parent_block.GetHash());
+  BOOST_TEST(block.vtx.size() == 1, "only coinbase tx expected, got nb of transactions " << block.vtx.size());
+  BOOST_TEST(isHashSmallerThanTarget(CBlockHeader(block)), "block nonce is not valid");
+  BOOST_CHECK_NO_THROW(checkBlockOnTopOf(bitcoind0, height, block, parent_block));
+
+  // A block for a different height, or with a timestamp not above the parent one, is rejected
+  BOOST_CHECK_THROW(checkBlockOnTopOf(bitcoind0, height + 1, block, parent_block), std::runtime_error);
+  CBlock early_block{block};
+  early_block.nTime = parent_block.nTime;
+  BOOST_CHECK_THROW(checkBlockOnTopOf(bitcoind0, height, early_block, parent_block), std::runtime_error);
+  BOOST_CHECK_THROW(generateBlockOnTopOf(bitcoind0, address0, height, block_time, parent_block), std::runtime_error);
+} // test_block_generate_01
+
 BOOST_AUTO_TEST_SUITE_END()
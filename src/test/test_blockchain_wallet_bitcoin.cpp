@@ -43,4 +43,88 @@ BOOST_FIXTURE_TEST_CASE(test_blockchain_wallet_bitcoin_00, BitcoinInfraFixture)
 
 } // test_blockchain_wallet_bitcoin_00
 
+BOOST_FIXTURE_TEST_CASE(test_blockchain_wallet_bitcoin_01, BitcoinInfraFixture)
+{
+  itcoin::wallet::NativeWallet native_wallet_0{*m_configs[0], *m_bitcoinds[0]};
+  itcoin::wallet::NativeWallet native_wallet_1{*m_configs[1], *m_bitcoinds[1]};
+
+  { // The native wallet signs as signmessage does
+  Prepare msg{0, 0, 0, "req_digest"};
+  native_wallet_0.AppendSignature(msg);
+  Prepare same_msg{0, 0, 0, "req_digest"};
+  m_wallets[0]->AppendSignature(same_msg);
+  BOOST_TEST( msg.signature() == same_msg.signature() );
+  BOOST_TEST( m_wallets[1]->VerifySignature(msg) == true );
+  BOOST_TEST( native_wallet_1.VerifySignature(same_msg) == true );
+  }
+
+  { // Signatures of another sender or message are rejected
+  Prepare msg{0, 0, 0, "req_digest"};
+  native_wallet_0.AppendSignature(msg);
+  Prepare other_msg{0, 0, 1, "req_digest"};
+  other_msg.set_signature(msg.signature());
+  BOOST_TEST( native_wallet_1.VerifySignature(other_msg) == false );
+  Prepare other_sender_msg{2, 0, 0, "req_digest"};
+  other_sender_msg.set_signature(msg.signature());
+  BOOST_TEST( native_wallet_1.VerifySignature(other_sender_msg) == false );
+  other_msg.set_signature("not a signature");
+  BOOST_TEST( native_wallet_1.VerifySignature(other_msg) == false );
+  }
+
+  // A wallet only signs the messages of its own replica
+  Prepare msg{1, 0, 0, "req_digest"};
+  BOOST_CHECK_THROW(native_wallet_0.AppendSignature(msg), std::runtime_error);
+} // test_blockchain_wallet_bitcoin_01
+
 BOOST_AUTO_TEST_SUITE_END() // test_blockchain_wallet_bitcoin
+
+// Measures the microseconds needed to sign and to verify a message, with the signmessage and verifymessage
+// calls to bitcoind and with the in-process native wallet.
+// Run explicitly with: --run_test=test_blockchain_wallet_bitcoin_benchmark
+BOOST_AUTO_TEST_SUITE(test_blockchain_wallet_bitcoin_benchmark, *utf::disabled())
+
+BOOST_FIXTURE_TEST_CASE(test_blockchain_wallet_bitcoin_benchmark_00, BitcoinInfraFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_MESSAGES = 200;
+
+  itcoin::wallet::NativeWallet native_wallet_0{*m_configs[0], *m_bitcoinds[0]};
+  itcoin::wallet::NativeWallet native_wallet_1{*m_configs[1], *m_bitcoinds[1]};
+
+  auto measure = [NUM_MESSAGES](const itcoin::wallet::Wallet& signer, const itcoin::wallet::Wallet& verifier) {
+    std::vector<Prepare> msgs;
+    for (uint32_t i = 0; i < NUM_MESSAGES; i++)
+    {
+      msgs.emplace_back(0, 0, i, "req_digest");
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (Prepare& msg : msgs)
+    {
+      signer.AppendSignature(msg);
+    }
+    auto signed_at = std::chrono::steady_clock::now();
+    uint32_t num_valid = 0;
+    for (const Prepare& msg : msgs)
+    {
+      num_valid += verifier.VerifySignature(msg);
+    }
+    auto verified_at = std::chrono::steady_clock::now();
+    BOOST_TEST(num_valid == NUM_MESSAGES);
+
+    auto sign_us = std::chrono::duration_cast<std::chrono::microseconds>(signed_at - start).count();
+    auto verify_us = std::chrono::duration_cast<std::chrono::microseconds>(verified_at - signed_at).count();
+    return std::make_pair(sign_us/(double) NUM_MESSAGES, verify_us/(double) NUM_MESSAGES);
+  };
+
+  BOOST_TEST_MESSAGE("wallet\tsign_us_per_msg\tverify_us_per_msg");
+  auto [rpc_sign_us, rpc_verify_us] = measure(*m_wallets[0], *m_wallets[1]);
+  BOOST_TEST_MESSAGE(str(boost::format("rpc\t%1$.1f\t%2$.1f") % rpc_sign_us % rpc_verify_us));
+  auto [native_sign_us, native_verify_us] = measure(native_wallet_0, native_wallet_1);
+  BOOST_TEST_MESSAGE(str(boost::format("native\t%1$.1f\t%2$.1f") % native_sign_us % native_verify_us));
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_blockchain_wallet_bitcoin_benchmark
@@ -0,0 +1,113 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+#include "../fbft/scheduler/scheduler.h"
+
+using namespace std;
+using namespace itcoin::fbft::scheduler;
+
+struct ActionSchedulerFixture: ReplicaStateFixture
+{
+  ActionSchedulerFixture(): ReplicaStateFixture(4,0,60)
+  {
+    Request request = Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 60);
+    Request other_request = Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 120);
+    m_active_actions = {
+      make_shared<ReceiveRequest>(0, request),
+      make_shared<SendViewChange>(0, 1),
+      make_shared<ReceivePrepare>(0, Prepare(1, 0, 1, "req_digest")),
+      make_shared<ReceiveRequest>(0, other_request),
+      make_shared<RoastReceiveSignatureShare>(0, RoastSignatureShare(1, "signature_share", "pre_signature_share")),
+      make_shared<RecoverView>(0, 1),
+      make_shared<ReceiveCommit>(0, Commit(1, 0, 1, "pre_signature")),
+    };
+  }
+
+  vector<shared_ptr<Action>> m_active_actions;
+};
+
+BOOST_AUTO_TEST_SUITE(test_fbft_action_scheduler, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_action_scheduler_00, ActionSchedulerFixture)
+{
+  // The priority scheduler is the default one
+  unique_ptr<ActionScheduler> p_scheduler = ActionScheduler::BuildFromConfig(*m_configs[0]);
+  BOOST_TEST(p_scheduler->name() == "priority");
+
+  // View recovery first, then the latest phases, starting a view change last
+  vector<shared_ptr<Action>> schedule = p_scheduler->Schedule(m_active_actions);
+  BOOST_REQUIRE(schedule.size() == m_active_actions.size());
+  vector<ACTION_TYPE> expected_types = {
+    ACTION_TYPE::RECOVER_VIEW,
+    ACTION_TYPE::ROAST_RECEIVE_SIGNATURE_SHARE,
+    ACTION_TYPE::RECEIVE_COMMIT,
+    ACTION_TYPE::RECEIVE_PREPARE,
+    ACTION_TYPE::RECEIVE_REQUEST,
+    ACTION_TYPE::RECEIVE_REQUEST,
+    ACTION_TYPE::SEND_VIEW_CHANGE,
+  };
+  for (size_t i=0; i<schedule.size(); i++)
+  {
+    BOOST_CHECK_MESSAGE(schedule[i]->type() == expected_types[i],
+      "Action " << i << " is " << schedule[i]->identify());
+  }
+
+  // Actions with the same priority keep their order
+  BOOST_TEST(schedule[4] == m_active_actions[0]);
+  BOOST_TEST(schedule[5] == m_active_actions[3]);
+
+  // Scheduling is a pure function of the active actions
+  BOOST_CHECK(p_scheduler->Schedule(m_active_actions) == schedule);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_action_scheduler_01, ActionSchedulerFixture)
+{
+  m_configs[0]->set_fbft_scheduler("random");
+  m_configs[0]->set_fbft_scheduler_seed(42);
+
+  // Two random schedulers with the same seed make the same choices
+  unique_ptr<ActionScheduler> p_scheduler = ActionScheduler::BuildFromConfig(*m_configs[0]);
+  unique_ptr<ActionScheduler> p_same_scheduler = ActionScheduler::BuildFromConfig(*m_configs[0]);
+  BOOST_TEST(p_scheduler->name() == "random");
+  for (int i=0; i<10; i++)
+  {
+    vector<shared_ptr<Action>> schedule = p_scheduler->Schedule(m_active_actions);
+    BOOST_TEST(schedule.size() == m_active_actions.size());
+    BOOST_CHECK(p_same_scheduler->Schedule(m_active_actions) == schedule);
+  }
+
+  // Unknown schedulers are rejected
+  m_configs[0]->set_fbft_scheduler("unknown");
+  BOOST_CHECK_THROW(ActionScheduler::BuildFromConfig(*m_configs[0]), std::runtime_error);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_action_scheduler_02, ActionSchedulerFixture)
+{
+  unique_ptr<ActionScheduler> p_scheduler = ActionScheduler::BuildFromConfig(*m_configs[0]);
+  BOOST_TEST(p_scheduler->budget() == ActionScheduler::MIN_BUDGET);
+
+  // The budget grows while cycles end with actions left, up to the maximum
+  uint32_t previous_budget = p_scheduler->budget();
+  for (int i=0; i<10; i++)
+  {
+    p_scheduler->AdaptBudget(p_scheduler->budget(), true);
+    BOOST_TEST(p_scheduler->budget() >= previous_budget);
+    previous_budget = p_scheduler->budget();
+  }
+  BOOST_TEST(p_scheduler->budget() == ActionScheduler::MAX_BUDGET);
+
+  // A busy cycle keeps the budget
+  p_scheduler->AdaptBudget(ActionScheduler::MAX_BUDGET/2, false);
+  BOOST_TEST(p_scheduler->budget() == ActionScheduler::MAX_BUDGET);
+
+  // And it shrinks back on idle cycles, down to the minimum
+  for (int i=0; i<10; i++)
+  {
+    p_scheduler->AdaptBudget(1, false);
+  }
+  BOOST_TEST(p_scheduler->budget() == ActionScheduler::MIN_BUDGET);
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_action_scheduler
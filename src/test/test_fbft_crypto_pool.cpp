@@ -0,0 +1,493 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+#include <chrono>
+#include <thread>
+
+#include <boost/log/expressions.hpp>
+
+#include <util/strencodings.h>
+
+#include "../utils/utils.h"
+
+using namespace std;
+using namespace itcoin::fbft::messages;
+
+namespace wallet = itcoin::wallet;
+
+struct CryptoPoolFixture: ReplicaStateFixture { CryptoPoolFixture(): ReplicaStateFixture(4,0,60) {} };
+
+// Builds in-process wallets with test keys, since the public keys of the configuration belong to the bitcoind wallets
+static vector<unique_ptr<wallet::NativeWallet>> build_native_wallets(const vector<unique_ptr<itcoin::FbftConfig>>& configs)
+{
+  secp256k1_context* ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN);
+  vector<vector<unsigned char>> private_keys;
+  vector<string> pubkeys;
+  for (uint32_t i = 0; i < configs.size(); i++)
+  {
+    vector<unsigned char> private_key(32, i + 1);
+    secp256k1_pubkey pubkey;
+    BOOST_REQUIRE(secp256k1_ec_pubkey_create(ctx, &pubkey, private_key.data()));
+    unsigned char serialized_pubkey[33];
+    size_t serialized_pubkey_len = 33;
+    secp256k1_ec_pubkey_serialize(ctx, serialized_pubkey, &serialized_pubkey_len, &pubkey, SECP256K1_EC_COMPRESSED);
+    pubkeys.emplace_back(itcoin::utils::stringToHex(string((const char*) serialized_pubkey, serialized_pubkey_len)));
+    private_keys.emplace_back(private_key);
+  }
+  secp256k1_context_destroy(ctx);
+
+  vector<unique_ptr<wallet::NativeWallet>> wallets;
+  for (uint32_t i = 0; i < configs.size(); i++)
+  {
+    wallets.emplace_back(make_unique<wallet::NativeWallet>(*configs[i], private_keys[i], pubkeys));
+  }
+  return wallets;
+}
+
+BOOST_AUTO_TEST_SUITE(test_fbft_crypto_pool, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_00, CryptoPoolFixture)
+{
+  // Every fifth message carries the signature of another replica
+  vector<shared_ptr<const Message>> msgs;
+  vector<bool> expected_valid;
+  for (uint32_t i = 0; i < 64; i++)
+  {
+    uint32_t sender_id = 1 + i % 3;
+    Prepare prepare(sender_id, 0, i, "req_digest");
+    m_wallets[sender_id]->AppendSignature(prepare);
+    if (i % 5 == 0)
+    {
+      prepare.set_signature("Sig_0");
+    }
+    expected_valid.push_back(i % 5 != 0);
+    msgs.emplace_back(make_shared<Prepare>(prepare));
+  }
+
+  // The outcome of each message is the same with and without workers, and follows the order of the batch
+  wallet::CryptoPool serial_pool(*m_wallets[0], 0, 0);
+  wallet::CryptoPool parallel_pool(*m_wallets[0], 4, 0);
+  BOOST_TEST(serial_pool.num_threads() == 0u);
+  BOOST_TEST(parallel_pool.num_threads() == 4u);
+  BOOST_CHECK(serial_pool.VerifyAll(msgs) == expected_valid);
+  for (int round = 0; round < 10; round++)
+  {
+    BOOST_CHECK(parallel_pool.VerifyAll(msgs) == expected_valid);
+  }
+
+  // Signing a batch signs each message
+  vector<unique_ptr<Message>> out_msgs;
+  for (uint32_t i = 0; i < 16; i++)
+  {
+    out_msgs.emplace_back(make_unique<Commit>(0, 0, i, "pre_signature"));
+  }
+  parallel_pool.SignAll(out_msgs);
+  for (const unique_ptr<Message>& p_msg : out_msgs)
+  {
+    BOOST_TEST(p_msg->signature() == "Sig_0");
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_01, CryptoPoolFixture)
+{
+  m_configs[1]->set_fbft_crypto_threads(2);
+  DummyNetwork transport(*m_configs[1]);
+  Replica2 replica(*m_configs[1], *m_blockchain, *m_wallets[1], transport, 0, "genesis", 0);
+  replica.set_synthetic_time(0);
+
+  // The messages for H=2 wait for H=1 to reach the chain, those with an invalid signature are discarded
+  Prepare prepare(2, 0, 2, "req_digest");
+  m_wallets[2]->AppendSignature(prepare);
+  Prepare forged_prepare(3, 0, 2, "req_digest");
+  forged_prepare.set_signature("Sig_2");
+  Commit commit(2, 0, 2, "pre_signature");
+  m_wallets[2]->AppendSignature(commit);
+  replica.ReceiveIncomingMessages({
+    make_shared<Prepare>(prepare),
+    make_shared<Prepare>(forged_prepare),
+    make_shared<Commit>(commit),
+  });
+  BOOST_TEST(replica.future_msg_buffer_size() == 2u);
+  BOOST_TEST(replica.duplicate_messages() == 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_02, CryptoPoolFixture)
+{
+  wallet::VerificationCache cache(3);
+
+  Prepare prepare_1(1, 0, 1, "req_digest");
+  m_wallets[1]->AppendSignature(prepare_1);
+  BOOST_TEST(cache.Lookup(prepare_1) == false);
+  cache.Insert(prepare_1);
+  BOOST_TEST(cache.Lookup(prepare_1) == true);
+
+  // The same content with another signature is not known to be valid
+  Prepare forged_prepare_1(1, 0, 1, "req_digest");
+  forged_prepare_1.set_signature("Sig_2");
+  BOOST_TEST(cache.Lookup(forged_prepare_1) == false);
+
+  // Once full, the oldest entry is evicted
+  Prepare prepare_2(2, 0, 2, "req_digest");
+  Commit commit_3(3, 0, 3, "pre_signature");
+  RoastSignatureShare signature_share(1, "signature_share", "next_pre_signature_share");
+  for (Message* p_msg : std::initializer_list<Message*>{&prepare_2, &commit_3, &signature_share})
+  {
+    m_wallets[p_msg->sender_id()]->AppendSignature(*p_msg);
+    cache.Insert(*p_msg);
+  }
+  BOOST_TEST(cache.Lookup(prepare_1) == false);
+  BOOST_TEST(cache.Lookup(prepare_2) == true);
+
+  wallet::VerificationCacheMetrics metrics = cache.metrics();
+  BOOST_TEST(metrics.size == 3u);
+  BOOST_TEST(metrics.capacity == 3u);
+  BOOST_TEST(metrics.hits == 2u);
+  BOOST_TEST(metrics.misses == 3u);
+  BOOST_TEST(metrics.evictions == 1u);
+
+  // Collecting H=2 forgets the messages up to H=2, and those without a height verified before H=2
+  cache.CollectGarbage(2);
+  BOOST_TEST(cache.Lookup(prepare_2) == false);
+  BOOST_TEST(cache.Lookup(signature_share) == false);
+  BOOST_TEST(cache.Lookup(commit_3) == true);
+  BOOST_TEST(cache.metrics().size == 1u);
+
+  // With capacity 0 nothing is remembered nor counted
+  wallet::VerificationCache no_cache(0);
+  no_cache.Insert(commit_3);
+  BOOST_TEST(no_cache.Lookup(commit_3) == false);
+  BOOST_TEST(no_cache.metrics().misses == 0u);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_03, CryptoPoolFixture)
+{
+  wallet::CryptoPool crypto_pool(*m_wallets[0], 2, 16);
+
+  // A retransmitted message is verified once, an invalid one every time
+  Prepare prepare(1, 0, 1, "req_digest");
+  m_wallets[1]->AppendSignature(prepare);
+  Prepare forged_prepare(2, 0, 1, "req_digest");
+  forged_prepare.set_signature("Sig_1");
+  vector<shared_ptr<const Message>> msgs{make_shared<Prepare>(prepare), make_shared<Prepare>(forged_prepare)};
+  BOOST_CHECK(crypto_pool.VerifyAll(msgs) == vector<bool>({true, false}));
+  BOOST_CHECK(crypto_pool.VerifyAll(msgs) == vector<bool>({true, false}));
+
+  wallet::VerificationCacheMetrics metrics = crypto_pool.verification_cache().metrics();
+  BOOST_TEST(metrics.size == 1u);
+  BOOST_TEST(metrics.hits == 1u);
+  BOOST_TEST(metrics.misses == 3u);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_04, CryptoPoolFixture)
+{
+  for (auto& config : m_configs)
+  {
+    config->set_fbft_signature_scheme("bip340");
+  }
+  vector<unique_ptr<wallet::NativeWallet>> wallets = build_native_wallets(m_configs);
+  BOOST_REQUIRE(wallets[0]->signature_scheme() == wallet::SIGNATURE_SCHEME::BIP340);
+
+  // A Schnorr signature is valid for its sender and content only
+  Prepare prepare(1, 0, 1, "req_digest");
+  wallets[1]->AppendSignature(prepare);
+  bool invalid_base64 = false;
+  BOOST_TEST(DecodeBase64(prepare.signature(), &invalid_base64).size() == 64u);
+  BOOST_TEST(wallets[0]->VerifySignature(prepare) == true);
+  Prepare other_prepare(1, 0, 2, "req_digest");
+  other_prepare.set_signature(prepare.signature());
+  BOOST_TEST(wallets[0]->VerifySignature(other_prepare) == false);
+  Prepare other_sender_prepare(2, 0, 1, "req_digest");
+  other_sender_prepare.set_signature(prepare.signature());
+  BOOST_TEST(wallets[0]->VerifySignature(other_sender_prepare) == false);
+
+  // The primary signs its own VIEW_CHANGE in the NEW_VIEW, the others come signed from its log
+  vector<ViewChange> view_changes;
+  for (uint32_t sender_id : {1, 2, 3})
+  {
+    ViewChange vc(sender_id, 1, 0, "checkpoint", view_change_prepared_t{}, view_change_pre_prepared_t{});
+    if (sender_id != 1)
+    {
+      wallets[sender_id]->AppendSignature(vc);
+    }
+    view_changes.emplace_back(vc);
+  }
+  wallet::CryptoPool signing_pool(*wallets[1], 2, 0);
+  vector<unique_ptr<Message>> out_msgs;
+  out_msgs.emplace_back(make_unique<NewView>(1, 1, view_changes, vector<PrePrepare>{}));
+  signing_pool.SignAll(out_msgs);
+  shared_ptr<const Message> p_new_view = move(out_msgs.front());
+  for (const ViewChange& vc : static_cast<const NewView&>(*p_new_view).view_changes())
+  {
+    BOOST_TEST(wallets[0]->VerifySignature(vc) == true);
+  }
+
+  // The embedded VIEW_CHANGEs are verified in the same batch, those already received are found in the cache
+  wallet::CryptoPool crypto_pool(*wallets[0], 2, 16);
+  shared_ptr<const Message> p_view_change = make_shared<ViewChange>(view_changes[1]);
+  BOOST_CHECK(crypto_pool.VerifyAll({p_view_change}) == vector<bool>({true}));
+  BOOST_CHECK(crypto_pool.VerifyAll({p_new_view, make_shared<Prepare>(prepare)}) == vector<bool>({true, true}));
+  BOOST_TEST(crypto_pool.verification_cache().metrics().hits == 1u);
+
+  // A NEW_VIEW carrying a forged VIEW_CHANGE is discarded, even if its own signature is valid
+  view_changes[2].set_signature(view_changes[1].signature());
+  NewView forged_new_view(1, 1, view_changes, vector<PrePrepare>{});
+  wallets[1]->AppendSignature(forged_new_view);
+  BOOST_CHECK(crypto_pool.VerifyAll({make_shared<NewView>(forged_new_view)}) == vector<bool>({false}));
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_05, CryptoPoolFixture)
+{
+  for (auto& config : m_configs)
+  {
+    config->set_fbft_mac_authenticators(true);
+  }
+  vector<unique_ptr<wallet::NativeWallet>> wallets = build_native_wallets(m_configs);
+
+  // A PREPARE carries one tag per replica, each recipient checks its own
+  Prepare prepare(1, 0, 1, "req_digest");
+  wallets[1]->AppendSignature(prepare);
+  bool invalid_base64 = false;
+  BOOST_TEST(DecodeBase64(prepare.signature(), &invalid_base64).size() == CLUSTER_SIZE*32u);
+  for (uint32_t recipient_id : {0, 2, 3})
+  {
+    BOOST_TEST(wallets[recipient_id]->VerifySignature(prepare) == true);
+  }
+  Prepare other_prepare(1, 0, 2, "req_digest");
+  other_prepare.set_signature(prepare.signature());
+  BOOST_TEST(wallets[0]->VerifySignature(other_prepare) == false);
+  Prepare other_sender_prepare(2, 0, 1, "req_digest");
+  other_sender_prepare.set_signature(prepare.signature());
+  BOOST_TEST(wallets[0]->VerifySignature(other_sender_prepare) == false);
+
+  // The tag of another recipient does not authenticate the message
+  string authenticator = DecodeBase64(prepare.signature(), &invalid_base64);
+  std::copy(authenticator.begin() + 2*32, authenticator.begin() + 3*32, authenticator.begin());
+  Prepare forged_prepare(1, 0, 1, "req_digest");
+  forged_prepare.set_signature(EncodeBase64(authenticator));
+  BOOST_TEST(wallets[0]->VerifySignature(forged_prepare) == false);
+  BOOST_TEST(wallets[2]->VerifySignature(forged_prepare) == true);
+
+  // A VIEW_CHANGE keeps its signature
+  ViewChange vc(1, 1, 0, "checkpoint", view_change_prepared_t{}, view_change_pre_prepared_t{});
+  wallets[1]->AppendSignature(vc);
+  BOOST_TEST(DecodeBase64(vc.signature(), &invalid_base64).size() == 65u);
+  BOOST_TEST(wallets[0]->VerifySignature(vc) == true);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_06, CryptoPoolFixture)
+{
+  vector<shared_ptr<const Message>> msgs;
+  for (uint32_t i = 0; i < 64; i++)
+  {
+    uint32_t sender_id = 1 + i % 3;
+    Prepare prepare(sender_id, 0, i, "req_digest");
+    m_wallets[sender_id]->AppendSignature(prepare);
+    msgs.emplace_back(make_shared<Prepare>(prepare));
+    // The digests are computed on this thread, the only one bound to a Prolog engine
+    msgs.back()->digest();
+  }
+  vector<bool> expected_valid(msgs.size(), true);
+
+  // Concurrent callers share the pool and its verification cache, their batches run one at a time
+  wallet::CryptoPool pool(*m_wallets[0], 4, 16);
+  vector<std::thread> callers;
+  vector<char> outcomes(4, false);
+  for (size_t c = 0; c < outcomes.size(); c++)
+  {
+    callers.emplace_back([&, c]() {
+      bool all_valid = true;
+      for (int round = 0; round < 10; round++)
+      {
+        all_valid = all_valid && pool.VerifyAll(msgs) == expected_valid;
+      }
+      outcomes[c] = all_valid;
+    });
+  }
+  for (std::thread& caller : callers)
+  {
+    caller.join();
+  }
+  for (char outcome : outcomes)
+  {
+    BOOST_TEST(outcome);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_crypto_pool
+
+// Measures the PREPARE and COMMIT messages per second verified by a replica flooded by the other ones,
+// and the messages per second it signs, with the in-process wallet and an increasing number of workers.
+// The flood is then received again, as if retransmitted, and found in the verification cache.
+// The second case compares the ECDSA and BIP340 signatures, verifying the messages in batches of increasing size.
+// The third one compares the CPU time spent by a replica to sign and verify a COMMIT, with the ECDSA or BIP340
+// signatures and with the MAC authenticators, along with the size of the base64 signature or authenticator.
+// Run explicitly with: --run_test=test_fbft_crypto_pool_benchmark
+BOOST_AUTO_TEST_SUITE(test_fbft_crypto_pool_benchmark, *utf::disabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_benchmark_00, CryptoPoolFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_MSGS = 4096;
+
+  vector<unique_ptr<wallet::NativeWallet>> wallets = build_native_wallets(m_configs);
+
+  // The other replicas flood R0 with PREPAREs and COMMITs
+  vector<shared_ptr<const Message>> in_msgs;
+  for (uint32_t i = 0; i < NUM_MSGS; i++)
+  {
+    uint32_t sender_id = 1 + i % (CLUSTER_SIZE-1);
+    unique_ptr<Message> p_msg;
+    if (i % 2 == 0)
+    {
+      p_msg = make_unique<Prepare>(sender_id, 0, i, "req_digest");
+    }
+    else
+    {
+      p_msg = make_unique<Commit>(sender_id, 0, i, "pre_signature");
+    }
+    wallets[sender_id]->AppendSignature(*p_msg);
+    in_msgs.emplace_back(move(p_msg));
+  }
+
+  BOOST_TEST_MESSAGE("crypto_threads\tverified_msgs_per_s\tcached_msgs_per_s\tsigned_msgs_per_s");
+  for (uint32_t num_threads : {0, 1, 2, 4, 8})
+  {
+    wallet::CryptoPool crypto_pool(*wallets[0], num_threads, NUM_MSGS);
+
+    auto start = std::chrono::steady_clock::now();
+    vector<bool> valid = crypto_pool.VerifyAll(in_msgs);
+    auto verify_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BOOST_TEST(std::count(valid.begin(), valid.end(), true) == NUM_MSGS);
+
+    start = std::chrono::steady_clock::now();
+    valid = crypto_pool.VerifyAll(in_msgs);
+    auto cached_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+    BOOST_TEST(crypto_pool.verification_cache().metrics().hits == NUM_MSGS);
+
+    vector<unique_ptr<Message>> out_msgs;
+    for (uint32_t i = 0; i < NUM_MSGS; i++)
+    {
+      out_msgs.emplace_back(make_unique<Prepare>(0, 0, i, "req_digest"));
+    }
+    start = std::chrono::steady_clock::now();
+    crypto_pool.SignAll(out_msgs);
+    auto sign_elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+
+    BOOST_TEST_MESSAGE(str(
+      boost::format("%1%\t%2$.0f\t%3$.0f\t%4$.0f")
+        % num_threads
+        % (NUM_MSGS/verify_elapsed)
+        % (NUM_MSGS/cached_elapsed)
+        % (NUM_MSGS/sign_elapsed)
+    ));
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_benchmark_01, CryptoPoolFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_MSGS = 4096;
+  const uint32_t NUM_THREADS = 4;
+
+  BOOST_TEST_MESSAGE("signature_scheme\tbatch_size\tverified_msgs_per_s");
+  for (const string& signature_scheme : {"ecdsa", "bip340"})
+  {
+    for (auto& config : m_configs)
+    {
+      config->set_fbft_signature_scheme(signature_scheme);
+    }
+    vector<unique_ptr<wallet::NativeWallet>> wallets = build_native_wallets(m_configs);
+    vector<shared_ptr<const Message>> in_msgs;
+    for (uint32_t i = 0; i < NUM_MSGS; i++)
+    {
+      uint32_t sender_id = 1 + i % (CLUSTER_SIZE-1);
+      unique_ptr<Message> p_msg = make_unique<Commit>(sender_id, 0, i, "pre_signature");
+      wallets[sender_id]->AppendSignature(*p_msg);
+      in_msgs.emplace_back(move(p_msg));
+    }
+
+    // The messages gathered in a cycle are verified as a batch
+    wallet::CryptoPool crypto_pool(*wallets[0], NUM_THREADS, 0);
+    for (uint32_t batch_size : {1, 4, 16, 64, 256})
+    {
+      uint32_t num_valid = 0;
+      auto start = std::chrono::steady_clock::now();
+      for (uint32_t first = 0; first < NUM_MSGS; first += batch_size)
+      {
+        vector<shared_ptr<const Message>> batch(in_msgs.begin() + first, in_msgs.begin() + std::min(first + batch_size, NUM_MSGS));
+        vector<bool> valid = crypto_pool.VerifyAll(batch);
+        num_valid += std::count(valid.begin(), valid.end(), true);
+      }
+      auto elapsed = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+      BOOST_TEST(num_valid == NUM_MSGS);
+
+      BOOST_TEST_MESSAGE(str(
+        boost::format("%1%\t%2%\t%3$.0f")
+          % signature_scheme
+          % batch_size
+          % (NUM_MSGS/elapsed)
+      ));
+    }
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_crypto_pool_benchmark_02, CryptoPoolFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_MSGS = 4096;
+
+  BOOST_TEST_MESSAGE("authentication\tsign_us_per_msg\tverify_us_per_msg\tbytes_per_msg");
+  for (const string& authentication : {"ecdsa", "bip340", "mac"})
+  {
+    for (auto& config : m_configs)
+    {
+      config->set_fbft_signature_scheme(authentication == "mac" ? "ecdsa" : authentication);
+      config->set_fbft_mac_authenticators(authentication == "mac");
+    }
+    vector<unique_ptr<wallet::NativeWallet>> wallets = build_native_wallets(m_configs);
+
+    vector<Commit> msgs;
+    for (uint32_t i = 0; i < NUM_MSGS; i++)
+    {
+      msgs.emplace_back(1, 0, i, "pre_signature");
+      msgs.back().digest();
+    }
+
+    auto start = std::chrono::steady_clock::now();
+    for (Commit& msg : msgs)
+    {
+      wallets[1]->AppendSignature(msg);
+    }
+    auto sign_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+
+    uint32_t num_valid = 0;
+    start = std::chrono::steady_clock::now();
+    for (const Commit& msg : msgs)
+    {
+      num_valid += wallets[0]->VerifySignature(msg);
+    }
+    auto verify_elapsed = std::chrono::duration_cast<std::chrono::microseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_TEST(num_valid == NUM_MSGS);
+
+    BOOST_TEST_MESSAGE(str(
+      boost::format("%1%\t%2$.2f\t%3$.2f\t%4%")
+        % authentication
+        % (sign_elapsed.count()/(double) NUM_MSGS)
+        % (verify_elapsed.count()/(double) NUM_MSGS)
+        % msgs.front().signature().size()
+    ));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_crypto_pool_benchmark
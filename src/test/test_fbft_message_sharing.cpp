@@ -0,0 +1,40 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+using namespace std;
+using namespace itcoin::fbft::actions;
+using namespace itcoin::fbft::messages;
+
+namespace state = itcoin::fbft::state;
+
+struct MessageSharingFixture: ReplicaStateFixture { MessageSharingFixture(): ReplicaStateFixture(4,0,60) {} };
+
+BOOST_AUTO_TEST_SUITE(test_fbft_message_sharing, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_message_sharing_00, MessageSharingFixture)
+{
+  state::ReplicaState& replica = *m_states[1];
+  set_synthetic_time(60);
+
+  Request request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 60);
+  auto p_pre_prepare = std::make_shared<PrePrepare>(0, 0, 1, request.digest(), m_blockchain->GenerateBlock(60));
+  replica.ReceiveIncomingMessage(p_pre_prepare);
+
+  // The receive action refers to the message in the input buffer
+  BOOST_REQUIRE(replica.in_msg_buffer().size() == 1u);
+  BOOST_TEST(replica.in_msg_buffer().front().get() == p_pre_prepare.get());
+  std::shared_ptr<Action> receive_pre_prepare = find_active(replica, ACTION_TYPE::RECEIVE_PRE_PREPARE);
+  BOOST_REQUIRE(receive_pre_prepare != nullptr);
+  BOOST_TEST(&receive_pre_prepare->message().value().get() == p_pre_prepare.get());
+
+  // A new time rebuilds the action, not the message
+  set_synthetic_time(61);
+  std::shared_ptr<Action> rebuilt_receive_pre_prepare = find_active(replica, ACTION_TYPE::RECEIVE_PRE_PREPARE);
+  BOOST_REQUIRE(rebuilt_receive_pre_prepare != nullptr);
+  BOOST_TEST(rebuilt_receive_pre_prepare != receive_pre_prepare);
+  BOOST_TEST(&rebuilt_receive_pre_prepare->message().value().get() == p_pre_prepare.get());
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_message_sharing
@@ -0,0 +1,134 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+#include <atomic>
+#include <cstdlib>
+#include <new>
+
+#include <boost/log/expressions.hpp>
+
+using namespace std;
+using namespace itcoin::fbft::actions;
+using namespace itcoin::fbft::messages;
+
+namespace state = itcoin::fbft::state;
+
+// Counts the heap allocations of this binary, read by the benchmarks below
+static std::atomic<uint64_t> g_num_allocations{0};
+
+void* operator new(std::size_t size)
+{
+  g_num_allocations.fetch_add(1, std::memory_order_relaxed);
+  if (void* p = std::malloc(size == 0 ? 1 : size))
+  {
+    return p;
+  }
+  throw std::bad_alloc();
+}
+
+void operator delete(void* p) noexcept
+{
+  std::free(p);
+}
+
+void operator delete(void* p, std::size_t) noexcept
+{
+  std::free(p);
+}
+
+struct MessageSharingBenchmarkFixture: ReplicaStateFixture { MessageSharingBenchmarkFixture(): ReplicaStateFixture(4,0,60) {} };
+
+// Measures the heap allocations per cycle.
+// The first case fills the input buffer of a replica with PRE_PREPAREs, and moves the time forward, so that
+// all the receive actions are rebuilt at each cycle. The second one runs the replica set as in the pipelining
+// benchmark, and reports the allocations per cycle and per block.
+// The global operator new above would count the allocations of every test, hence this suite is built
+// in its own binary, see src/CMakeLists.txt.
+// Run explicitly with: main-test-allocations --run_test=test_fbft_message_sharing_benchmark
+BOOST_AUTO_TEST_SUITE(test_fbft_message_sharing_benchmark, *utf::disabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_message_sharing_benchmark_00, MessageSharingBenchmarkFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_CYCLES = 100;
+
+  state::ReplicaState& replica = *m_states[1];
+  set_synthetic_time(60);
+
+  BOOST_TEST_MESSAGE("in_msg_buffer\tallocations_per_cycle");
+  uint32_t seq_number = 0;
+  double synthetic_time = 60;
+  for (uint32_t in_msg_buffer_len: {1, 4, 16, 64})
+  {
+    while (replica.in_msg_buffer().size() < in_msg_buffer_len)
+    {
+      seq_number += 1;
+      Request request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, seq_number*TARGET_BLOCK_TIME);
+      replica.ReceiveIncomingMessage(std::make_shared<PrePrepare>(
+        0, 0, seq_number, request.digest(), m_blockchain->GenerateBlock(seq_number*TARGET_BLOCK_TIME)));
+    }
+
+    uint64_t num_allocations_before = g_num_allocations.load();
+    for (uint32_t i = 0; i < NUM_CYCLES; i++)
+    {
+      synthetic_time += 1;
+      replica.set_synthetic_time(synthetic_time);
+    }
+    uint64_t num_allocations = g_num_allocations.load() - num_allocations_before;
+
+    BOOST_TEST_MESSAGE(str(
+      boost::format("%1%\t%2$.1f")
+        % in_msg_buffer_len
+        % (num_allocations/(double) NUM_CYCLES)
+    ));
+  }
+}
+
+BOOST_AUTO_TEST_CASE(test_fbft_message_sharing_benchmark_01)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t TARGET_BLOCK_TIME = 4;
+  const double HOP_LATENCY = 0.25;
+  const double MAX_SYNTHETIC_TIME = 100*TARGET_BLOCK_TIME;
+
+  ReplicaSetFixture fixture(4, 0, TARGET_BLOCK_TIME);
+
+  uint64_t num_cycles = 0;
+  uint64_t num_allocations_before = g_num_allocations.load();
+  double synthetic_time = 0;
+  while (synthetic_time < MAX_SYNTHETIC_TIME)
+  {
+    for (size_t i = 0; i < fixture.CLUSTER_SIZE; i++)
+    {
+      fixture.m_replica[i]->CheckTimedActions();
+    }
+    for (size_t i = 0; i < fixture.CLUSTER_SIZE; i++)
+    {
+      fixture.m_transports[i]->SimulateReceiveMessages();
+    }
+    num_cycles += fixture.CLUSTER_SIZE;
+    synthetic_time += HOP_LATENCY;
+    fixture.set_synthetic_time(synthetic_time);
+  }
+  uint64_t num_allocations = g_num_allocations.load() - num_allocations_before;
+
+  uint32_t height = fixture.m_blockchain->height();
+  BOOST_TEST(height > 0u);
+  BOOST_TEST_MESSAGE("height\tallocations_per_cycle\tallocations_per_block");
+  BOOST_TEST_MESSAGE(str(
+    boost::format("%1%\t%2$.1f\t%3$.1f")
+      % height
+      % (num_allocations/(double) num_cycles)
+      % (height > 0 ? num_allocations/(double) height : 0)
+  ));
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_message_sharing_benchmark
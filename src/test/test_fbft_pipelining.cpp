@@ -0,0 +1,111 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+#include <chrono>
+
+#include <boost/log/expressions.hpp>
+
+using namespace std;
+using namespace itcoin::fbft::actions;
+using namespace itcoin::fbft::messages;
+
+namespace state = itcoin::fbft::state;
+
+struct PipeliningFixture: ReplicaStateFixture { PipeliningFixture(): ReplicaStateFixture(4,0,60,2) {} };
+
+BOOST_AUTO_TEST_SUITE(test_fbft_pipelining, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_pipelining_00, PipeliningFixture)
+{
+  // R0 is the primary of view 0
+  state::ReplicaState& primary = *m_states[0];
+  set_synthetic_time(60);
+  primary.Apply(ReceiveRequest(0, Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 60)));
+  primary.Apply(ReceiveRequest(0, Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 120)));
+
+  // The primary proposes H=1
+  std::shared_ptr<Action> send_pre_prepare = find_active(primary, ACTION_TYPE::SEND_PRE_PREPARE);
+  BOOST_REQUIRE(send_pre_prepare != nullptr);
+  primary.Apply(*send_pre_prepare);
+  BOOST_REQUIRE(primary.out_msg_buffer().size() == 1u);
+  const PrePrepare& first = dynamic_cast<const PrePrepare&>(*primary.out_msg_buffer().at(0));
+  BOOST_TEST(first.seq_number() == 1u);
+  std::string first_block_hash = first.proposed_block().GetHash().GetHex();
+  primary.ClearOutMessageBuffer();
+
+  // With a window of 2 heights, H=2 is proposed while H=1 is not on the chain yet,
+  // and its block builds on the one proposed for H=1
+  set_synthetic_time(120);
+  primary.UpdateActiveActions();
+  BOOST_TEST(primary.h() == 0u);
+  send_pre_prepare = find_active(primary, ACTION_TYPE::SEND_PRE_PREPARE);
+  BOOST_REQUIRE(send_pre_prepare != nullptr);
+  primary.Apply(*send_pre_prepare);
+  BOOST_REQUIRE(primary.out_msg_buffer().size() == 1u);
+  const PrePrepare& second = dynamic_cast<const PrePrepare&>(*primary.out_msg_buffer().at(0));
+  BOOST_TEST(second.seq_number() == 2u);
+  BOOST_TEST(second.proposed_block().hashPrevBlock.GetHex() == first_block_hash);
+  primary.ClearOutMessageBuffer();
+
+  // H=3 is outside the window until H=1 is checkpointed
+  primary.Apply(ReceiveRequest(0, Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 180)));
+  set_synthetic_time(180);
+  primary.UpdateActiveActions();
+  BOOST_TEST(find_active(primary, ACTION_TYPE::SEND_PRE_PREPARE) == nullptr);
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_pipelining
+
+// Measures the blocks per second produced by the replica set with different watermark windows.
+// Each step delivers one hop of messages and moves the synthetic time forward by HOP_LATENCY, so the
+// target block time is short when compared with the hops needed to agree on a block.
+// Run explicitly with: --run_test=test_fbft_pipelining_benchmark
+BOOST_AUTO_TEST_SUITE(test_fbft_pipelining_benchmark, *utf::disabled())
+
+BOOST_AUTO_TEST_CASE(test_fbft_pipelining_benchmark_00)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t TARGET_BLOCK_TIME = 4;
+  const double HOP_LATENCY = 0.25;
+  const double MAX_SYNTHETIC_TIME = 100*TARGET_BLOCK_TIME;
+
+  BOOST_TEST_MESSAGE("request_buffer_len\theight\tblocks_per_s\twall_ms_per_block");
+  for (uint32_t request_buffer_len: {1, 2, 3, 4})
+  {
+    ReplicaSetFixture fixture(4, 0, TARGET_BLOCK_TIME, request_buffer_len);
+
+    auto start = std::chrono::steady_clock::now();
+    double synthetic_time = 0;
+    while (synthetic_time < MAX_SYNTHETIC_TIME)
+    {
+      for (size_t i = 0; i < fixture.CLUSTER_SIZE; i++)
+      {
+        fixture.m_replica[i]->CheckTimedActions();
+      }
+      for (size_t i = 0; i < fixture.CLUSTER_SIZE; i++)
+      {
+        fixture.m_transports[i]->SimulateReceiveMessages();
+      }
+      synthetic_time += HOP_LATENCY;
+      fixture.set_synthetic_time(synthetic_time);
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now() - start);
+
+    uint32_t height = fixture.m_blockchain->height();
+    BOOST_TEST(height > 0u);
+    BOOST_TEST_MESSAGE(str(
+      boost::format("%1%\t%2%\t%3$.3f\t%4$.1f")
+        % request_buffer_len
+        % height
+        % (height/MAX_SYNTHETIC_TIME)
+        % (height > 0 ? elapsed.count()/(double) height : 0)
+    ));
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_pipelining_benchmark
@@ -4,7 +4,9 @@
 #include "fixtures/fixtures.h"
 
 #include <algorithm>
+#include <chrono>
 #include <cmath>
+#include <thread>
 
 #include <boost/format.hpp>
 #include <boost/log/expressions.hpp>
@@ -184,4 +186,125 @@ catch(const std::exception& e)
 }
 }
 
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica2_02, Replica2Fixture)
+{
+  // Before the first cycle, the requests have to be generated right away
+  BOOST_REQUIRE( m_replica[0]->NextDeadline().has_value() );
+  BOOST_TEST( m_replica[0]->NextDeadline().value() <= m_replica[0]->current_time() );
+
+  // Then, the replica waits for the timestamp of the first request
+  m_replica[0]->CheckTimedActions();
+  BOOST_TEST( m_replica[0]->latest_request_time() == 5*TARGET_BLOCK_TIME);
+  BOOST_TEST( m_replica[0]->NextDeadline().value() == TARGET_BLOCK_TIME );
+
+  // If the first request is not replied, the next deadline is the view change timeout
+  set_synthetic_time(TARGET_BLOCK_TIME+1);
+  BOOST_TEST( m_replica[0]->NextDeadline().value() == TARGET_BLOCK_TIME + TARGET_BLOCK_TIME/2 );
+
+  // Past the timeout, the replica sends the VIEW_CHANGE when it wakes up
+  set_synthetic_time(m_replica[0]->NextDeadline().value() + 1);
+  m_replica[0]->CheckTimedActions();
+  BOOST_TEST( m_replica[0]->view() == 1u );
+  BOOST_TEST( m_replica[0]->NextDeadline().value() > m_replica[0]->current_time() );
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica2_03, Replica2Fixture)
+{
+  set_synthetic_time(TARGET_BLOCK_TIME+1);
+  for (int i=0; i<10; i++)
+  {
+    move_forward(0);
+  }
+  BOOST_TEST(m_blockchain->height() == 1);
+
+  // The primary coordinates ROAST and signs as well, so its own ROAST messages
+  // are delivered to itself through the trusted local path
+  BOOST_TEST(m_replica[0]->primary() == 0u);
+  BOOST_TEST(m_replica[0]->self_delivered_messages() > 0u);
+
+  // The signature shares of the other replicas go to the coordinator only
+  for (uint32_t i=1; i<CLUSTER_SIZE; i++)
+  {
+    BOOST_TEST(m_replica[i]->self_delivered_messages() == 0u);
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica2_04, Replica2Fixture)
+{
+  // Woken up just after each deadline, as ZComm::run_forever does, the backup sends the VIEW_CHANGE.
+  // A deadline handled by a cycle is never reported again, otherwise the loop would spin on it
+  Replica2& replica = *m_replica.at(1);
+  for (int cycle=0; cycle<5 && replica.view()==0; cycle++)
+  {
+    double cycle_start = replica.current_time();
+    replica.CheckTimedActions();
+    std::optional<double> deadline = replica.NextDeadline();
+    BOOST_REQUIRE( deadline.has_value() );
+    BOOST_TEST( deadline.value() >= cycle_start );
+
+    set_synthetic_time(deadline.value() + 1);
+  }
+  BOOST_TEST( replica.view() == 1u );
+
+  // After the VIEW_CHANGE, the next deadline is the doubled timeout
+  double cycle_start = replica.current_time();
+  replica.CheckTimedActions();
+  BOOST_TEST( replica.NextDeadline().value() >= cycle_start );
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica2_05, Replica2Fixture)
+{
+  // The whole normal case, each replica on its own thread and with its own Prolog engine
+  const int NUM_BLOCKS = 10;
+  set_synthetic_time(0);
+  while (m_replica[0]->current_time() < NUM_BLOCKS*TARGET_BLOCK_TIME)
+  {
+    move_forward_in_parallel(10);
+  }
+
+  BOOST_TEST(m_blockchain->height() == NUM_BLOCKS-1);
+  for (auto& p_replica: m_replica)
+  {
+    BOOST_TEST(p_replica->h() == NUM_BLOCKS-1);
+    BOOST_TEST(p_replica->view() == 0u);
+  }
+}
+
 BOOST_AUTO_TEST_SUITE_END() // test_fbft_replica2
+
+// The same deadline loop of test_fbft_replica2_04, on the wall clock and with real sleeps.
+// Run explicitly with: --run_test=test_fbft_replica2_wall_clock
+BOOST_AUTO_TEST_SUITE(test_fbft_replica2_wall_clock, *utf::disabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica2_wall_clock_00, Replica2Fixture)
+{
+  // A backup running on the wall clock, with blocks every 2 seconds and a view change timeout of 1 second
+  itcoin::FbftConfig config{*m_configs.at(1)};
+  uint32_t genesis_block_timestamp = std::chrono::duration_cast<std::chrono::seconds>(std::chrono::system_clock::now().time_since_epoch()).count();
+  config.set_genesis_block_timestamp(genesis_block_timestamp);
+  config.set_target_block_time(2);
+  DummyNetwork transport{config};
+  Replica2 replica{config, *m_blockchain, *m_wallets.at(1), transport, 0, "genesis", genesis_block_timestamp};
+
+  // Woken up at each deadline, as ZComm::run_forever does, the backup sends the VIEW_CHANGE.
+  // A deadline handled by a cycle is never reported again, otherwise the loop would spin on it
+  for (int cycle=0; cycle<5 && replica.view()==0; cycle++)
+  {
+    double cycle_start = replica.current_time();
+    replica.CheckTimedActions();
+    std::optional<double> deadline = replica.NextDeadline();
+    BOOST_REQUIRE( deadline.has_value() );
+    BOOST_TEST( deadline.value() >= cycle_start );
+
+    std::this_thread::sleep_until(std::chrono::system_clock::time_point(
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(std::chrono::duration<double>(deadline.value()))));
+  }
+  BOOST_TEST( replica.view() == 1u );
+
+  // After the VIEW_CHANGE, the next deadline is the doubled timeout
+  double cycle_start = replica.current_time();
+  replica.CheckTimedActions();
+  BOOST_TEST( replica.NextDeadline().value() >= cycle_start );
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_replica2_wall_clock
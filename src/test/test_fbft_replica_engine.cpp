@@ -0,0 +1,282 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include <thread>
+
+#include "fixtures/fixtures.h"
+
+using namespace std;
+using namespace itcoin::fbft::actions;
+using namespace itcoin::fbft::messages;
+
+namespace state = itcoin::fbft::state;
+
+struct ReplicaEngineFixture: ReplicaStateFixture { ReplicaEngineFixture(): ReplicaStateFixture(4,0,60) {} };
+
+BOOST_AUTO_TEST_SUITE(test_fbft_replica_engine, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_00, ReplicaEngineFixture)
+{
+  // The state getters are served by the engine
+  set_synthetic_time(60);
+  for (auto& p_state: m_states)
+  {
+    BOOST_TEST(p_state->current_time() == p_state->engine().current_time());
+    BOOST_TEST(p_state->h() == p_state->engine().h());
+    BOOST_TEST(p_state->view() == p_state->engine().view());
+    BOOST_TEST(p_state->primary() == p_state->engine().primary());
+    BOOST_TEST(p_state->latest_request_time() == p_state->engine().latest_request_time());
+    BOOST_TEST(p_state->latest_reply_time() == p_state->engine().latest_reply_time());
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_02, ReplicaEngineFixture)
+{
+  state::ReplicaState& replica = *m_states.at(0);
+
+  // Without state changes, no precondition is evaluated again
+  uint64_t evaluations = replica.precondition_evaluations();
+  uint64_t skipped = replica.skipped_precondition_evaluations();
+  replica.UpdateActiveActions();
+  BOOST_TEST(replica.precondition_evaluations() == evaluations);
+  BOOST_TEST(replica.skipped_precondition_evaluations() == skipped + 9);
+
+  // Moving the clock only affects SEND_PRE_PREPARE and SEND_VIEW_CHANGE
+  evaluations = replica.precondition_evaluations();
+  skipped = replica.skipped_precondition_evaluations();
+  replica.set_synthetic_time(30);
+  BOOST_TEST(replica.precondition_evaluations() == evaluations + 2);
+  BOOST_TEST(replica.skipped_precondition_evaluations() == skipped + 7);
+
+  // A received request is materialized once, and only affects the preconditions reading the requests
+  Request request = Request(m_configs[0]->genesis_block_timestamp(), m_configs[0]->target_block_time(), 60);
+  replica.set_synthetic_time(60);
+  replica.ReceiveIncomingMessage(std::make_unique<Request>(request));
+  BOOST_TEST(replica.active_actions().size() == 1u);
+  const actions::Action* receive_request = replica.active_actions().at(0).get();
+  replica.UpdateActiveActions();
+  BOOST_TEST(replica.active_actions().at(0).get() == receive_request);
+
+  evaluations = replica.precondition_evaluations();
+  replica.Apply(*replica.active_actions().at(0));
+  BOOST_TEST(replica.precondition_evaluations() == evaluations + 7);
+  BOOST_TEST(replica.active_actions().size() == 1u);
+  BOOST_CHECK(replica.active_actions().at(0)->type() == ACTION_TYPE::SEND_PRE_PREPARE);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_03, ReplicaEngineFixture)
+{
+  // The fixture sets the synthetic time, this replica starts over without it
+  m_states.at(0) = std::make_unique<state::ReplicaState>(*m_configs.at(0), *m_blockchain, *m_wallets.at(0), 0, "genesis", 0);
+  state::ReplicaState& replica = *m_states.at(0);
+
+  // Without synthetic time, the current time is the system time
+  double before = std::chrono::duration<double>(std::chrono::system_clock::now().time_since_epoch()).count();
+  BOOST_TEST(replica.current_time() >= before);
+  BOOST_TEST(replica.snapshot().current_time >= before);
+
+  // The mirror follows the synthetic time
+  replica.set_synthetic_time(60);
+  BOOST_TEST(replica.current_time() == 60);
+  BOOST_TEST(replica.snapshot().current_time == 60);
+
+  // And the effect of the applied actions
+  Request request = Request(m_configs[0]->genesis_block_timestamp(), m_configs[0]->target_block_time(), 60);
+  ReceiveRequest receive_request(m_configs[0]->id(), request);
+  replica.Apply(receive_request);
+  BOOST_TEST(replica.latest_request_time() == 60);
+
+  state::ReplicaStateSnapshot snapshot = replica.snapshot();
+  BOOST_TEST(snapshot.replica_id == m_configs[0]->id());
+  BOOST_TEST(snapshot.h == replica.engine().h());
+  BOOST_TEST(snapshot.view == replica.engine().view());
+  BOOST_TEST(snapshot.primary == replica.engine().primary());
+  BOOST_TEST(snapshot.latest_request_time == replica.engine().latest_request_time());
+  BOOST_TEST(snapshot.latest_reply_time == replica.engine().latest_reply_time());
+  BOOST_TEST(snapshot.current_time == replica.engine().current_time());
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_04, ReplicaEngineFixture)
+{
+  // Each replica runs on its own Prolog engine, with its own target block time
+  const uint32_t NUM_ROUNDS = 50;
+  std::vector<std::unique_ptr<itcoin::FbftConfig>> configs;
+  for (size_t i=0; i<m_states.size(); i++)
+  {
+    m_states.at(i).reset();
+    auto config = std::make_unique<itcoin::FbftConfig>(*m_configs.at(i));
+    config->set_target_block_time(60*(i+1));
+    m_states.at(i) = std::make_unique<state::ReplicaState>(*config, *m_blockchain, *m_wallets.at(i), 0, "genesis", 0);
+    configs.emplace_back(std::move(config));
+  }
+
+  // The replicas are stepped in parallel, each thread records what its replica sees
+  std::vector<std::vector<std::string>> failures(m_states.size());
+  std::vector<std::thread> threads;
+  for (size_t i=0; i<m_states.size(); i++)
+  {
+    threads.emplace_back([&, i]() {
+      state::ReplicaState& replica = *m_states.at(i);
+      const itcoin::FbftConfig& config = *configs.at(i);
+      for (uint32_t k=1; k<=NUM_ROUNDS; k++)
+      {
+        uint32_t req_timestamp = k*config.target_block_time();
+        replica.set_synthetic_time(req_timestamp);
+        Request request(config.genesis_block_timestamp(), config.target_block_time(), req_timestamp);
+        replica.Apply(ReceiveRequest(config.id(), request));
+
+        if (replica.latest_request_time() != req_timestamp)
+          failures.at(i).emplace_back("latest request time " + std::to_string(replica.latest_request_time()));
+
+        // Finding the request back uses the global variables of the engine
+        state::ReplicaEngine::ThreadGuard engine_guard{replica.engine()};
+        Request found = Request::FindByDigest(config.id(), request.digest());
+        if (found.digest() != request.digest())
+          failures.at(i).emplace_back("request " + found.digest() + " instead of " + request.digest());
+      }
+    });
+  }
+  for (auto& thread: threads)
+  {
+    thread.join();
+  }
+
+  for (size_t i=0; i<m_states.size(); i++)
+  {
+    BOOST_CHECK_MESSAGE(failures.at(i).empty(), "R" << i << " saw " << failures.at(i).size() << " failures, the first one: " << (failures.at(i).empty() ? "" : failures.at(i).front()));
+    state::ReplicaStateSnapshot snapshot = m_states.at(i)->snapshot();
+    BOOST_TEST(snapshot.latest_request_time == NUM_ROUNDS*configs.at(i)->target_block_time());
+    BOOST_TEST(snapshot.h == 0u);
+    BOOST_TEST(snapshot.view == 0u);
+  }
+
+  // The states must go before the configurations they refer to
+  for (auto& p_state: m_states)
+  {
+    p_state.reset();
+  }
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_05, ReplicaEngineFixture)
+{
+  set_synthetic_time(60);
+
+  // A batch of receive actions is applied and refreshes the replicas as a single Apply
+  for (auto& p_state: m_states)
+  {
+    Request request = Request(m_configs[0]->genesis_block_timestamp(), m_configs[0]->target_block_time(), 60);
+    std::vector<std::shared_ptr<Action>> batch{ std::make_shared<ReceiveRequest>(p_state->snapshot().replica_id, request) };
+    state::BatchStats stats = p_state->ApplyBatch(batch);
+    BOOST_TEST(stats.applied == 1);
+    BOOST_TEST(stats.failed == 0);
+    BOOST_TEST(stats.deferred == 0);
+    BOOST_TEST(stats.estimated_saved_refresh_time == 0);
+    BOOST_TEST(p_state->latest_request_time() == 60);
+  }
+
+  // The primary can now send the PRE_PREPARE
+  std::shared_ptr<Action> send_pre_prepare;
+  state::ReplicaState* p_primary = nullptr;
+  for (auto& p_state: m_states)
+  {
+    for (auto& p_action: p_state->active_actions())
+    {
+      if (p_action->type() == ACTION_TYPE::SEND_PRE_PREPARE)
+      {
+        send_pre_prepare = p_action;
+        p_primary = p_state.get();
+      }
+    }
+  }
+  BOOST_REQUIRE(p_primary != nullptr);
+
+  // A state dependent action is deferred when a previous effect of the batch wrote what its precondition reads
+  set_synthetic_time(120);
+  Request request = Request(m_configs[0]->genesis_block_timestamp(), m_configs[0]->target_block_time(), 120);
+  std::vector<std::shared_ptr<Action>> batch{
+    std::make_shared<ReceiveRequest>(p_primary->snapshot().replica_id, request),
+    send_pre_prepare
+  };
+  state::BatchStats stats = p_primary->ApplyBatch(batch);
+  BOOST_TEST(stats.applied == 1);
+  BOOST_TEST(stats.deferred == 1);
+  BOOST_TEST(p_primary->latest_request_time() == 120);
+  BOOST_TEST(p_primary->out_msg_buffer().empty());
+
+  // The deferred action is still active after the refresh
+  bool send_pre_prepare_active = false;
+  for (auto& p_action: p_primary->active_actions())
+  {
+    send_pre_prepare_active |= (p_action->type() == ACTION_TYPE::SEND_PRE_PREPARE);
+  }
+  BOOST_TEST(send_pre_prepare_active);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_06, ReplicaEngineFixture)
+{
+  // A backup, with a view change timeout of half the target block time
+  state::ReplicaState& replica = *m_states.at(1);
+
+  auto has_view_change = [&replica]() {
+    for (auto& p_action: replica.active_actions())
+    {
+      if (p_action->type() == ACTION_TYPE::SEND_VIEW_CHANGE)
+        return true;
+    }
+    return false;
+  };
+
+  // A request for the next block is not late yet
+  set_synthetic_time(TARGET_BLOCK_TIME);
+  uint32_t req_timestamp = 2*TARGET_BLOCK_TIME;
+  Request request = Request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, req_timestamp);
+  replica.Apply(ReceiveRequest(m_configs.at(1)->id(), request));
+  BOOST_TEST(!has_view_change());
+
+  // Once the timeout expires, a refresh alone must notice it, nothing else changed in the state
+  set_synthetic_time(req_timestamp + TARGET_BLOCK_TIME/2 + 1);
+  replica.UpdateActiveActions();
+  BOOST_TEST(has_view_change());
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_replica_engine
+
+// The view change timeout of test_fbft_replica_engine_06, on the wall clock and with real sleeps:
+// without synthetic time, the refresh itself has to notice that the time went by.
+// Run explicitly with: --run_test=test_fbft_replica_engine_wall_clock
+BOOST_AUTO_TEST_SUITE(test_fbft_replica_engine_wall_clock, *utf::disabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_replica_engine_wall_clock_00, ReplicaEngineFixture)
+{
+  // A backup running on the wall clock, with a view change timeout of 1 second
+  itcoin::FbftConfig config{*m_configs.at(1)};
+  config.set_target_block_time(2);
+  m_states.at(1).reset();
+  m_states.at(1) = std::make_unique<state::ReplicaState>(config, *m_blockchain, *m_wallets.at(1), 0, "genesis", 0);
+  state::ReplicaState& replica = *m_states.at(1);
+
+  auto has_view_change = [&replica]() {
+    for (auto& p_action: replica.active_actions())
+    {
+      if (p_action->type() == ACTION_TYPE::SEND_VIEW_CHANGE)
+        return true;
+    }
+    return false;
+  };
+
+  // A request from the next second is not late yet
+  uint32_t req_timestamp = static_cast<uint32_t>(replica.current_time()) + 1;
+  Request request = Request(config.genesis_block_timestamp(), config.target_block_time(), req_timestamp);
+  replica.Apply(ReceiveRequest(config.id(), request));
+  BOOST_TEST(!has_view_change());
+
+  // Once the timeout expires, a refresh alone must notice it, nothing else changed in the state
+  std::this_thread::sleep_until(std::chrono::system_clock::time_point(std::chrono::milliseconds((req_timestamp + 1)*1000 + 500)));
+  replica.UpdateActiveActions();
+  BOOST_TEST(has_view_change());
+
+  // The state must go before the configuration it refers to
+  m_states.at(1).reset();
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_replica_engine_wall_clock
@@ -0,0 +1,48 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+#include "../fbft/scheduler/scheduler.h"
+
+using namespace std;
+using namespace itcoin::fbft::scheduler;
+
+struct RequestHorizonFixture: ReplicaStateFixture { RequestHorizonFixture(): ReplicaStateFixture(4,0,60) {} };
+
+BOOST_AUTO_TEST_SUITE(test_fbft_request_horizon, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_request_horizon_00, RequestHorizonFixture)
+{
+  RequestHorizon request_horizon(*m_configs[0]);
+  BOOST_TEST(request_horizon.horizon() == RequestHorizon::INITIAL_HORIZON);
+
+  // The first observation is the starting point
+  BOOST_TEST(!request_horizon.Observe(0, 0, 0));
+  BOOST_TEST(request_horizon.horizon() == RequestHorizon::INITIAL_HORIZON);
+
+  // Fast replies in a stable view shrink the horizon down to the minimum
+  double reply_time = 0;
+  for (int i=0; i<20; i++)
+  {
+    reply_time += TARGET_BLOCK_TIME;
+    request_horizon.Observe(reply_time + 1, reply_time, 0);
+  }
+  BOOST_TEST(request_horizon.horizon() == RequestHorizon::MIN_HORIZON);
+  BOOST_TEST(request_horizon.view_change_rate() == 0);
+
+  // A view change grows the horizon right away, before the next reply
+  BOOST_TEST(request_horizon.Observe(reply_time + TARGET_BLOCK_TIME, reply_time, 1));
+  BOOST_TEST(request_horizon.horizon() == RequestHorizon::MIN_HORIZON + 1);
+
+  // Slow replies grow it further, up to the maximum
+  for (int i=0; i<50; i++)
+  {
+    reply_time += TARGET_BLOCK_TIME;
+    request_horizon.Observe(reply_time + 100*TARGET_BLOCK_TIME, reply_time, 1);
+  }
+  BOOST_TEST(request_horizon.horizon() == RequestHorizon::MAX_HORIZON);
+  BOOST_TEST(request_horizon.commit_latency() <= RequestHorizon::MAX_HORIZON*TARGET_BLOCK_TIME);
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_request_horizon
@@ -0,0 +1,74 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "fixtures/fixtures.h"
+
+using namespace std;
+using namespace itcoin::fbft::actions;
+using namespace itcoin::fbft::messages;
+
+namespace state = itcoin::fbft::state;
+
+struct StateBuffersFixture: ReplicaStateFixture { StateBuffersFixture(): ReplicaStateFixture(4,0,60) {} };
+
+BOOST_AUTO_TEST_SUITE(test_fbft_state_buffers, *utf::enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_state_buffers_00, StateBuffersFixture)
+{
+  state::ReplicaState& replica = *m_states[1];
+  set_synthetic_time(60);
+
+  // The same message is buffered once, whatever its signature
+  Prepare prepare(2, 0, 1, "req_digest");
+  Prepare same_prepare(2, 0, 1, "req_digest");
+  same_prepare.set_signature("another_signature");
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(prepare));
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(same_prepare));
+  BOOST_TEST(replica.in_msg_buffer().size() == 1u);
+  BOOST_TEST(replica.duplicate_messages() == 1u);
+
+  // The same payload from another sender is another message
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(3, 0, 1, "req_digest"));
+  BOOST_TEST(replica.in_msg_buffer().size() == 2u);
+  BOOST_TEST(replica.duplicate_messages() == 1u);
+
+  // Applying an equal action removes the buffered message
+  replica.Apply(ReceivePrepare(1, prepare));
+  BOOST_TEST(replica.in_msg_buffer().size() == 1u);
+}
+
+BOOST_FIXTURE_TEST_CASE(test_fbft_state_buffers_01, StateBuffersFixture)
+{
+  state::ReplicaState& replica = *m_states[1];
+  set_synthetic_time(60);
+  Request request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 60);
+  replica.Apply(ReceiveRequest(1, request));
+
+  // With the default windows, the messages for H=2 wait for H=1 to reach the chain, those for H=3 are dropped
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(2, 0, 2, "req_digest_2"));
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(2, 0, 3, "req_digest_3"));
+  BOOST_TEST(replica.in_msg_buffer().size() == 2u);
+  while (std::shared_ptr<Action> receive_prepare = find_active(replica, ACTION_TYPE::RECEIVE_PREPARE))
+  {
+    replica.Apply(*receive_prepare);
+  }
+  BOOST_TEST(replica.in_msg_buffer().size() == 0u);
+  BOOST_TEST(replica.future_msg_buffer_size() == 1u);
+
+  // A parked message is not buffered twice
+  replica.ReceiveIncomingMessage(std::make_shared<Prepare>(2, 0, 2, "req_digest_2"));
+  BOOST_TEST(replica.in_msg_buffer().size() == 0u);
+  BOOST_TEST(replica.duplicate_messages() == 1u);
+
+  // Once H=1 is on the chain, H=2 is the current height and its messages go back to the input buffer
+  replica.ReceiveIncomingMessage(std::make_shared<Block>(1, 60, m_blockchain->GenerateBlock(60).GetHash().GetHex()));
+  std::shared_ptr<Action> receive_block = find_active(replica, ACTION_TYPE::RECEIVE_BLOCK);
+  BOOST_REQUIRE(receive_block != nullptr);
+  replica.Apply(*receive_block);
+  BOOST_TEST(replica.h() == 1u);
+  BOOST_TEST(replica.future_msg_buffer_size() == 0u);
+  BOOST_REQUIRE(replica.in_msg_buffer().size() == 1u);
+  BOOST_TEST(replica.in_msg_buffer().front()->seq_number_as_opt().value() == 2u);
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_fbft_state_buffers
@@ -0,0 +1,213 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include <boost/log/trivial.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "../fbft/messages/messages.h"
+
+#include "fixtures/fixtures.h"
+
+using namespace std;
+using namespace boost::unit_test;
+using namespace itcoin::fbft::messages;
+
+struct MessagesDigestFixture: ReplicaStateFixture
+{
+  MessagesDigestFixture(): ReplicaStateFixture(4,0,60) {}
+  // The digest scheme is process-wide, restore the default one
+  ~MessagesDigestFixture() { set_digest_scheme(DIGEST_SCHEME::PROLOG); }
+};
+
+// Computes the digest of msg with the given scheme, on a fresh copy of the message
+template<typename T>
+string digest_with(DIGEST_SCHEME scheme, const T& msg)
+{
+  DIGEST_SCHEME previous_scheme = digest_scheme();
+  set_digest_scheme(scheme);
+  shared_ptr<const Message> copy = Message::BuildFromBinBuffer(msg.ToBinBuffer()).value();
+  string digest = copy->digest();
+  set_digest_scheme(previous_scheme);
+  return digest;
+}
+
+// Both schemes must tell apart the same messages
+template<typename T>
+void check_cross_digests(const T& msg, const T& same_msg, const vector<T>& different_msgs)
+{
+  string native = digest_with(DIGEST_SCHEME::NATIVE, msg);
+  string prolog = digest_with(DIGEST_SCHEME::PROLOG, msg);
+  BOOST_TEST(native.size() == 64);
+  BOOST_TEST(native != prolog);
+
+  BOOST_TEST(digest_with(DIGEST_SCHEME::NATIVE, same_msg) == native);
+  BOOST_TEST(digest_with(DIGEST_SCHEME::PROLOG, same_msg) == prolog);
+
+  for (const T& different_msg: different_msgs)
+  {
+    BOOST_TEST(digest_with(DIGEST_SCHEME::NATIVE, different_msg) != native);
+    BOOST_TEST(digest_with(DIGEST_SCHEME::PROLOG, different_msg) != prolog);
+  }
+}
+
+BOOST_AUTO_TEST_SUITE(test_messages_digest, *enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_messages_digest_00, MessagesDigestFixture)
+{
+  // The legacy scheme is the default one
+  BOOST_CHECK(digest_scheme() == DIGEST_SCHEME::PROLOG);
+  BOOST_CHECK(digest_scheme_from_string("native") == DIGEST_SCHEME::NATIVE);
+  BOOST_CHECK(digest_scheme_from_string("prolog") == DIGEST_SCHEME::PROLOG);
+  BOOST_CHECK_THROW(digest_scheme_from_string("unknown"), std::runtime_error);
+
+  // The legacy scheme gives the same digests of the digest_* predicates
+  set_digest_scheme(DIGEST_SCHEME::PROLOG);
+  Prepare prepare(1, 2, 3, "req_digest");
+  PlTerm Digest;
+  BOOST_TEST(PlCall("digest_prepare", PlTermv(
+    PlTerm{(long) 2}, PlTerm{(long) 3}, PlString("req_digest"), PlTerm{(long) 1}, Digest
+  )));
+  BOOST_TEST(prepare.digest() == string{(const char*) Digest});
+
+  // The memoized digest follows the scheme
+  set_digest_scheme(DIGEST_SCHEME::NATIVE);
+  BOOST_TEST(prepare.digest() != string{(const char*) Digest});
+  BOOST_TEST(Prepare(1, 2, 3, "req_digest").digest() == prepare.digest());
+  set_digest_scheme(DIGEST_SCHEME::PROLOG);
+  BOOST_TEST(prepare.digest() == string{(const char*) Digest});
+}
+
+BOOST_FIXTURE_TEST_CASE(test_messages_digest_01, MessagesDigestFixture)
+{
+  check_cross_digests(
+    Prepare(1, 2, 3, "req_digest"),
+    Prepare(1, 2, 3, "req_digest"),
+    {
+      Prepare(0, 2, 3, "req_digest"),
+      Prepare(1, 0, 3, "req_digest"),
+      Prepare(1, 2, 0, "req_digest"),
+      Prepare(1, 2, 3, "other_digest"),
+    }
+  );
+
+  check_cross_digests(
+    Commit(1, 2, 3, "pre_signature"),
+    Commit(1, 2, 3, "pre_signature"),
+    {
+      Commit(0, 2, 3, "pre_signature"),
+      Commit(1, 0, 3, "pre_signature"),
+      Commit(1, 2, 0, "pre_signature"),
+      Commit(1, 2, 3, "other_pre_signature"),
+    }
+  );
+
+  CBlock block = m_blockchain->GenerateBlock(666);
+  CBlock other_block = m_blockchain->GenerateBlock(667);
+  check_cross_digests(
+    PrePrepare(1, 2, 3, "req_digest", block),
+    PrePrepare(1, 2, 3, "req_digest", block),
+    {
+      PrePrepare(1, 0, 3, "req_digest", block),
+      PrePrepare(1, 2, 0, "req_digest", block),
+      PrePrepare(1, 2, 3, "other_digest", block),
+      PrePrepare(1, 2, 3, "req_digest", other_block),
+    }
+  );
+
+  check_cross_digests(
+    RoastPreSignature(1, {0, 1, 2}, "pre_signature"),
+    RoastPreSignature(1, {0, 1, 2}, "pre_signature"),
+    {
+      RoastPreSignature(0, {0, 1, 2}, "pre_signature"),
+      RoastPreSignature(1, {0, 1, 3}, "pre_signature"),
+      RoastPreSignature(1, {0, 1, 2}, "other_pre_signature"),
+    }
+  );
+
+  check_cross_digests(
+    RoastSignatureShare(1, "signature_share", "pre_signature_share"),
+    RoastSignatureShare(1, "signature_share", "pre_signature_share"),
+    {
+      RoastSignatureShare(0, "signature_share", "pre_signature_share"),
+      RoastSignatureShare(1, "other_signature_share", "pre_signature_share"),
+      RoastSignatureShare(1, "signature_share", "other_pre_signature_share"),
+    }
+  );
+}
+
+BOOST_FIXTURE_TEST_CASE(test_messages_digest_02, MessagesDigestFixture)
+{
+  view_change_prepared_t pi = {make_tuple(18, "req_digest", 10)};
+  view_change_pre_prepared_t qi = {make_tuple(18, "req_digest", "block_hash", 10)};
+  view_change_prepared_t other_pi = {make_tuple(18, "req_digest", 9)};
+  view_change_pre_prepared_t other_qi = {make_tuple(18, "req_digest", "other_block_hash", 10)};
+
+  ViewChange vc(1, 11, 17, "c", pi, qi);
+  check_cross_digests(
+    vc,
+    ViewChange(1, 11, 17, "c", pi, qi),
+    {
+      ViewChange(0, 11, 17, "c", pi, qi),
+      ViewChange(1, 12, 17, "c", pi, qi),
+      ViewChange(1, 11, 16, "c", pi, qi),
+      ViewChange(1, 11, 17, "other_c", pi, qi),
+      ViewChange(1, 11, 17, "c", other_pi, qi),
+      ViewChange(1, 11, 17, "c", pi, other_qi),
+    }
+  );
+
+  // The engine computes the same VIEW_CHANGE digests, they are referenced by NEW_VIEW messages
+  for (DIGEST_SCHEME scheme: {DIGEST_SCHEME::PROLOG, DIGEST_SCHEME::NATIVE})
+  {
+    set_digest_scheme(scheme);
+    PlTerm Digest;
+    BOOST_TEST(PlCall("digest_view_change", PlTermv(
+      PlTerm{(long) 11}, PlTerm{(long) 17}, PlString("c"),
+      vc.pi_as_plterm(), vc.qi_as_plterm(), PlTerm{(long) 1}, Digest
+    )));
+    BOOST_TEST(digest_with(scheme, vc) == string{(const char*) Digest});
+  }
+
+  CBlock block = m_blockchain->GenerateBlock(666);
+  PrePrepare ppp(0, 11, 18, "req_digest", block);
+  ViewChange other_vc(2, 11, 17, "c", pi, qi);
+  check_cross_digests(
+    NewView(0, 11, {vc, other_vc}, {ppp}),
+    NewView(0, 11, {vc, other_vc}, {ppp}),
+    {
+      NewView(0, 12, {vc, other_vc}, {ppp}),
+      NewView(0, 11, {vc}, {ppp}),
+      NewView(0, 11, {vc, other_vc}, {}),
+    }
+  );
+}
+
+BOOST_FIXTURE_TEST_CASE(test_messages_digest_03, MessagesDigestFixture)
+{
+  // The legacy scheme digests the whole proposed blocks, as the previous releases did
+  set_digest_scheme(DIGEST_SCHEME::PROLOG);
+  CBlock block = m_blockchain->GenerateBlock(666);
+  string block_hex = itcoin::blockchain::HexSerializableCBlock(block).GetHex();
+
+  PrePrepare ppp(0, 11, 18, "req_digest", block);
+  PlTerm Ppp_digest;
+  BOOST_TEST(PlCall("digest_pre_prepare", PlTermv(
+    PlTerm{(long) 11}, PlTerm{(long) 18}, PlString("req_digest"), PlString(block_hex.c_str()), Ppp_digest
+  )));
+  BOOST_TEST(ppp.digest() == string{(const char*) Ppp_digest});
+
+  view_change_prepared_t pi = {make_tuple(18, "req_digest", 10)};
+  view_change_pre_prepared_t qi = {make_tuple(18, "req_digest", "block_hash", 10)};
+  ViewChange vc(1, 11, 17, "c", pi, qi);
+  NewView nv(0, 11, {vc}, {ppp});
+  PlTerm Nv_digest;
+  BOOST_TEST(PlCall("digest_new_view", PlTermv(
+    PlTerm{(long) 11},
+    NewView::nu_as_plterm(nv.nu()),
+    NewView::chi_as_plterm({make_tuple(18, "req_digest", block_hex)}),
+    Nv_digest
+  )));
+  BOOST_TEST(nv.digest() == string{(const char*) Nv_digest});
+}
+
+BOOST_AUTO_TEST_SUITE_END()
@@ -0,0 +1,156 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include <chrono>
+
+#include <boost/log/expressions.hpp>
+#include <boost/log/trivial.hpp>
+#include <boost/test/unit_test.hpp>
+
+#include "../fbft/messages/messages.h"
+#include "../utils/utils.h"
+
+#include "fixtures/fixtures.h"
+
+using namespace std;
+using namespace boost::unit_test;
+using namespace itcoin::fbft::messages;
+
+struct MessagesDispatchFixture: ReplicaStateFixture
+{
+  MessagesDispatchFixture(): ReplicaStateFixture(4,0,60)
+  {
+    Request request(GENESIS_BLOCK_TIMESTAMP, TARGET_BLOCK_TIME, 60);
+    m_msgs = {
+      make_shared<Block>(1, 60, "block_hash"),
+      make_shared<Request>(request),
+      make_shared<PrePrepare>(0, 0, 1, request.digest(), CBlock()),
+      make_shared<Prepare>(1, 0, 1, request.digest()),
+      make_shared<Commit>(2, 0, 1, "pre_signature"),
+      make_shared<ViewChange>(3, 1, 0, "checkpoint", view_change_prepared_t{}, view_change_pre_prepared_t{}),
+      make_shared<NewView>(1, 1, vector<ViewChange>{}, vector<PrePrepare>{}),
+      make_shared<RoastPreSignature>(0, vector<uint32_t>{1, 2, 3}, "pre_signature"),
+      make_shared<RoastSignatureShare>(1, "signature_share", "next_pre_signature_share"),
+    };
+  }
+
+  vector<shared_ptr<const Message>> m_msgs;
+};
+
+// Returns the sender of msg, going through the variant
+static uint32_t visit_sender_id(const shared_ptr<const Message>& p_msg)
+{
+  return std::visit([](const auto& p_typed_msg) { return p_typed_msg->sender_id(); }, AllMessages::AsVariant(p_msg));
+}
+
+BOOST_AUTO_TEST_SUITE(test_messages_dispatch, *enabled())
+
+BOOST_FIXTURE_TEST_CASE(test_messages_dispatch_00, MessagesDispatchFixture)
+{
+  // Each message is converted to the alternative of its own type
+  for (const shared_ptr<const Message>& p_msg : m_msgs)
+  {
+    AllMessages::variant_t msg_variant = AllMessages::AsVariant(p_msg);
+    MSG_TYPE visited_type = std::visit(itcoin::utils::overloaded{
+      [](const shared_ptr<const Block>&) { return Block::TYPE; },
+      [](const shared_ptr<const Request>&) { return Request::TYPE; },
+      [](const shared_ptr<const PrePrepare>&) { return PrePrepare::TYPE; },
+      [](const shared_ptr<const Prepare>&) { return Prepare::TYPE; },
+      [](const shared_ptr<const Commit>&) { return Commit::TYPE; },
+      [](const shared_ptr<const ViewChange>&) { return ViewChange::TYPE; },
+      [](const shared_ptr<const NewView>&) { return NewView::TYPE; },
+      [](const shared_ptr<const RoastPreSignature>&) { return RoastPreSignature::TYPE; },
+      [](const shared_ptr<const RoastSignatureShare>&) { return RoastSignatureShare::TYPE; },
+    }, msg_variant);
+    BOOST_CHECK_MESSAGE(visited_type == p_msg->type(), "Wrong alternative for " << p_msg->name());
+
+    // The alternative shares the message
+    std::visit([&p_msg](const auto& p_typed_msg) {
+      BOOST_TEST(static_cast<const Message*>(p_typed_msg.get()) == p_msg.get());
+    }, msg_variant);
+  }
+
+  // Messages exchanged by the replicas are rebuilt from the wire by the registry
+  for (const shared_ptr<const Message>& p_msg : m_msgs)
+  {
+    if (p_msg->type() == MSG_TYPE::BLOCK || p_msg->type() == MSG_TYPE::REQUEST)
+    {
+      continue;
+    }
+    optional<shared_ptr<const Message>> p_msg_built = Message::BuildFromBinBuffer(p_msg->ToBinBuffer());
+    BOOST_REQUIRE(p_msg_built.has_value());
+    BOOST_CHECK(p_msg_built.value()->type() == p_msg->type());
+    BOOST_CHECK(p_msg_built.value()->digest() == p_msg->digest());
+  }
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_messages_dispatch
+
+// Measures the nanoseconds needed to get the sender of a message through its concrete type, with a chain
+// of dynamic_cast, with a switch on type() followed by a static_cast, and with the variant of the registry.
+// Run explicitly with: --run_test=test_messages_dispatch_benchmark
+BOOST_AUTO_TEST_SUITE(test_messages_dispatch_benchmark, *disabled())
+
+static uint32_t dynamic_cast_sender_id(const Message& msg)
+{
+  if (auto p = dynamic_cast<const Block*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const Request*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const PrePrepare*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const Prepare*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const Commit*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const ViewChange*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const NewView*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const RoastPreSignature*>(&msg)) return p->sender_id();
+  if (auto p = dynamic_cast<const RoastSignatureShare*>(&msg)) return p->sender_id();
+  return 0;
+}
+
+static uint32_t switch_sender_id(const Message& msg)
+{
+  switch (msg.type()) {
+  case MSG_TYPE::BLOCK: return static_cast<const Block&>(msg).sender_id();
+  case MSG_TYPE::REQUEST: return static_cast<const Request&>(msg).sender_id();
+  case MSG_TYPE::PRE_PREPARE: return static_cast<const PrePrepare&>(msg).sender_id();
+  case MSG_TYPE::PREPARE: return static_cast<const Prepare&>(msg).sender_id();
+  case MSG_TYPE::COMMIT: return static_cast<const Commit&>(msg).sender_id();
+  case MSG_TYPE::VIEW_CHANGE: return static_cast<const ViewChange&>(msg).sender_id();
+  case MSG_TYPE::NEW_VIEW: return static_cast<const NewView&>(msg).sender_id();
+  case MSG_TYPE::ROAST_PRE_SIGNATURE: return static_cast<const RoastPreSignature&>(msg).sender_id();
+  case MSG_TYPE::ROAST_SIGNATURE_SHARE: return static_cast<const RoastSignatureShare&>(msg).sender_id();
+  }
+  return 0;
+}
+
+BOOST_FIXTURE_TEST_CASE(test_messages_dispatch_benchmark_00, MessagesDispatchFixture)
+{
+  boost::log::core::get()->set_filter (
+    boost::log::trivial::severity >= boost::log::trivial::warning
+  );
+
+  const uint32_t NUM_ROUNDS = 100000;
+
+  auto measure = [this](auto&& dispatch) {
+    uint64_t checksum = 0;
+    auto start = std::chrono::steady_clock::now();
+    for (uint32_t i = 0; i < NUM_ROUNDS; i++)
+    {
+      for (const shared_ptr<const Message>& p_msg : m_msgs)
+      {
+        checksum += dispatch(p_msg);
+      }
+    }
+    auto elapsed = std::chrono::duration_cast<std::chrono::nanoseconds>(std::chrono::steady_clock::now() - start);
+    BOOST_TEST(checksum > 0u);
+    return elapsed.count()/(double) (NUM_ROUNDS*m_msgs.size());
+  };
+
+  BOOST_TEST_MESSAGE("dispatch\tns_per_message");
+  BOOST_TEST_MESSAGE(str(boost::format("dynamic_cast\t%1$.2f")
+    % measure([](const shared_ptr<const Message>& p_msg) { return dynamic_cast_sender_id(*p_msg); })));
+  BOOST_TEST_MESSAGE(str(boost::format("switch\t%1$.2f")
+    % measure([](const shared_ptr<const Message>& p_msg) { return switch_sender_id(*p_msg); })));
+  BOOST_TEST_MESSAGE(str(boost::format("variant\t%1$.2f")
+    % measure([](const shared_ptr<const Message>& p_msg) { return visit_sender_id(p_msg); })));
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_messages_dispatch_benchmark
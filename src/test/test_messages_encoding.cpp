@@ -34,13 +34,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::COMMIT);
 
-  Commit typed_msg_built{ dynamic_cast<Commit&>(*msg_built) };
+  Commit typed_msg_built{ dynamic_cast<const Commit&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.view() == v);
   BOOST_CHECK(typed_msg_built.seq_number() == n);
   BOOST_CHECK(typed_msg_built.pre_signature() == msg.pre_signature());
@@ -77,13 +77,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::NEW_VIEW);
 
-  NewView typed_msg_built{ dynamic_cast<NewView&>(*msg_built) };
+  NewView typed_msg_built{ dynamic_cast<const NewView&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.view() == v);
   BOOST_CHECK(typed_msg_built.view_changes() == msg.view_changes());
   BOOST_CHECK(typed_msg_built.pre_prepares() == msg.pre_prepares());
@@ -102,13 +102,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::PREPARE);
 
-  Prepare typed_msg_built{ dynamic_cast<Prepare&>(*msg_built) };
+  Prepare typed_msg_built{ dynamic_cast<const Prepare&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.view() == v);
   BOOST_CHECK(typed_msg_built.seq_number() == n);
   BOOST_CHECK(typed_msg_built.req_digest() == req_digest);
@@ -128,13 +128,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::PRE_PREPARE);
 
-  PrePrepare typed_msg_built{ dynamic_cast<PrePrepare&>(*msg_built) };
+  PrePrepare typed_msg_built{ dynamic_cast<const PrePrepare&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.view() == v);
   BOOST_CHECK(typed_msg_built.seq_number() == n);
   BOOST_CHECK(typed_msg_built.req_digest() == req_digest);
@@ -159,13 +159,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::VIEW_CHANGE);
 
-  ViewChange typed_msg_built{ dynamic_cast<ViewChange&>(*msg_built) };
+  ViewChange typed_msg_built{ dynamic_cast<const ViewChange&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.view() == v);
   BOOST_CHECK(typed_msg_built.hi() == hi);
   BOOST_CHECK(typed_msg_built.c() == c);
@@ -175,6 +175,37 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   BOOST_CHECK(typed_msg_built.digest() == msg.digest());
   }
 
+  //
+  // ViewChange, with the Qi blocks taken from the block store
+  //
+  {
+  uint32_t sender_id = 3, v = 11, hi = 17;
+  std::string c = "This is the checkpoint digest";
+  CBlock block = m_blockchain->GenerateBlock(666);
+  std::shared_ptr<const CBlock> stored_block = itcoin::blockchain::BlockStore::Instance().Put(sender_id, hi+1, block);
+  std::string block_hash = stored_block->GetHash().GetHex();
+  view_change_prepared_t pi = {};
+  view_change_pre_prepared_elem_t q_elem = make_tuple(hi+1, "req_digest", block_hash, 10);
+  view_change_pre_prepared_t qi = {q_elem};
+
+  ViewChange msg = ViewChange(sender_id, v, hi, c, pi, qi);
+  BOOST_CHECK(msg.qi_blocks().size() == 1);
+
+  m_wallets[sender_id]->AppendSignature(msg);
+  string msg_as_bin = msg.ToBinBuffer();
+
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  BOOST_TEST(msg_built_opt.has_value());
+
+  ViewChange typed_msg_built{ dynamic_cast<const ViewChange&>(*msg_built_opt.value()) };
+  BOOST_CHECK(typed_msg_built.qi() == qi);
+  BOOST_CHECK(typed_msg_built.qi_blocks().size() == 1);
+  BOOST_CHECK(typed_msg_built.qi_blocks().at(block_hash)->GetHash() == block.GetHash());
+
+  itcoin::blockchain::BlockStore::Instance().Release(sender_id, hi+1);
+  BOOST_CHECK(itcoin::blockchain::BlockStore::Instance().Get(block_hash) == nullptr);
+  }
+
   //
   // RoastSignatureShare
   //
@@ -188,13 +219,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::ROAST_SIGNATURE_SHARE);
 
-  RoastSignatureShare typed_msg_built{ dynamic_cast<RoastSignatureShare&>(*msg_built) };
+  RoastSignatureShare typed_msg_built{ dynamic_cast<const RoastSignatureShare&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.sender_id() == sender_id);
   BOOST_CHECK(typed_msg_built.signature_share() == signature_share);
   BOOST_CHECK(typed_msg_built.next_pre_signature_share() == next_presignature_share);
@@ -215,13 +246,13 @@ BOOST_FIXTURE_TEST_CASE(test_messages_encoding_00, MessagesEncodingFixture)
   m_wallets[sender_id]->AppendSignature(msg);
   string msg_as_bin = msg.ToBinBuffer();
 
-  optional<unique_ptr<Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
+  optional<shared_ptr<const Message>> msg_built_opt = Message::BuildFromBinBuffer(msg_as_bin);
   BOOST_TEST(msg_built_opt.has_value());
 
-  unique_ptr<Message>& msg_built = msg_built_opt.value();
+  const shared_ptr<const Message>& msg_built = msg_built_opt.value();
   BOOST_CHECK(msg_built->type() == MSG_TYPE::ROAST_PRE_SIGNATURE);
 
-  RoastPreSignature typed_msg_built{ dynamic_cast<RoastPreSignature&>(*msg_built) };
+  RoastPreSignature typed_msg_built{ dynamic_cast<const RoastPreSignature&>(*msg_built) };
   BOOST_CHECK(typed_msg_built.sender_id() == sender_id);
   BOOST_CHECK(typed_msg_built.pre_signature() == pre_signature);
   BOOST_CHECK(typed_msg_built.signers() == signers);
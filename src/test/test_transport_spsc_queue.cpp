@@ -0,0 +1,71 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include <boost/test/unit_test.hpp>
+
+#include <memory>
+#include <thread>
+
+#include "../transport/spsc_queue.h"
+
+using namespace boost::unit_test;
+using namespace itcoin::transport;
+
+BOOST_AUTO_TEST_SUITE(test_transport_spsc_queue, *enabled())
+
+BOOST_AUTO_TEST_CASE(test_transport_spsc_queue_00)
+{
+  SpscQueue<std::unique_ptr<int>> queue{2};
+  BOOST_TEST(queue.capacity() == 2u);
+  BOOST_TEST(queue.empty());
+  BOOST_TEST(!queue.TryPop().has_value());
+
+  BOOST_TEST(queue.TryPush(std::make_unique<int>(1)));
+  BOOST_TEST(queue.TryPush(std::make_unique<int>(2)));
+  BOOST_TEST(queue.size() == 2u);
+
+  // A full queue leaves the item to the producer
+  std::unique_ptr<int> third = std::make_unique<int>(3);
+  BOOST_TEST(!queue.TryPush(std::move(third)));
+  BOOST_REQUIRE(third != nullptr);
+
+  BOOST_TEST(*queue.TryPop().value() == 1);
+  BOOST_TEST(queue.TryPush(std::move(third)));
+  BOOST_TEST(*queue.TryPop().value() == 2);
+  BOOST_TEST(*queue.TryPop().value() == 3);
+  BOOST_TEST(queue.empty());
+}
+
+BOOST_AUTO_TEST_CASE(test_transport_spsc_queue_01)
+{
+  // The consumer gets all the items, in order, while the producer runs on another thread
+  const int NUM_ITEMS = 100000;
+  SpscQueue<int> queue{16};
+
+  std::thread producer([&queue, NUM_ITEMS]() {
+    for (int i = 0; i < NUM_ITEMS; i++) {
+      int item = i;
+      while (!queue.TryPush(std::move(item))) {
+        std::this_thread::yield();
+      }
+    }
+  });
+
+  int expected = 0;
+  bool in_order = true;
+  while (expected < NUM_ITEMS) {
+    std::optional<int> item = queue.TryPop();
+    if (!item.has_value()) {
+      std::this_thread::yield();
+      continue;
+    }
+    in_order = in_order && (item.value() == expected);
+    expected++;
+  }
+  producer.join();
+
+  BOOST_TEST(in_order);
+  BOOST_TEST(queue.empty());
+}
+
+BOOST_AUTO_TEST_SUITE_END() // test_transport_spsc_queue
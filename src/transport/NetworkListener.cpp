@@ -10,5 +10,13 @@ NetworkListener::NetworkListener()
 {
 }
 
+void NetworkListener::ReceiveIncomingMessages(const std::vector<std::shared_ptr<const messages::Message>>& msgs)
+{
+  for (const auto& p_msg : msgs)
+  {
+    this->ReceiveIncomingMessage(p_msg);
+  }
+}
+
 }
 }
@@ -19,14 +19,17 @@ class NetworkListener
   public:
     NetworkListener();
     virtual const uint32_t id() const = 0;
-    virtual void ReceiveIncomingMessage(std::unique_ptr<messages::Message> msg) = 0;
+    virtual void ReceiveIncomingMessage(std::shared_ptr<const messages::Message> msg) = 0;
+    // Messages received together, in arrival order. By default they are received one at a time
+    virtual void ReceiveIncomingMessages(const std::vector<std::shared_ptr<const messages::Message>>& msgs);
 };
 
 class NetworkTransport
 {
   public:
     NetworkTransport(const itcoin::FbftConfig& conf);
-    virtual void BroadcastMessage(std::unique_ptr<messages::Message> p_msg) = 0;
+    // The message is signed and no longer changes, the transport may share it with the listeners
+    virtual void BroadcastMessage(std::shared_ptr<const messages::Message> p_msg) = 0;
 
   protected:
     const itcoin::FbftConfig& m_conf;
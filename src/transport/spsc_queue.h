@@ -0,0 +1,89 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#ifndef ITCOIN_TRANSPORT_SPSC_QUEUE_H
+#define ITCOIN_TRANSPORT_SPSC_QUEUE_H
+
+#include <atomic>
+#include <optional>
+#include <vector>
+
+namespace itcoin {
+namespace transport {
+
+/**
+ * A bounded, lock-free queue between exactly one producer thread and one
+ * consumer thread.
+ *
+ * TryPush() must only be called by the producer, TryPop() only by the
+ * consumer. size() can be called by any thread, and is exact only when
+ * called by one of the two.
+ */
+template<typename T>
+class SpscQueue {
+  public:
+    SpscQueue(size_t capacity):
+      m_buffer(capacity + 1),
+      m_head(0),
+      m_tail(0)
+    {
+    }
+
+    /**
+     * Moves item at the end of the queue. If the queue is full, item is left
+     * untouched and false is returned.
+     */
+    bool TryPush(T&& item)
+    {
+      size_t tail = m_tail.load(std::memory_order_relaxed);
+      size_t next_tail = next(tail);
+      if (next_tail == m_head.load(std::memory_order_acquire)) {
+        return false;
+      }
+      m_buffer[tail] = std::move(item);
+      m_tail.store(next_tail, std::memory_order_release);
+      return true;
+    }
+
+    /**
+     * Removes the first item of the queue, if any.
+     */
+    std::optional<T> TryPop()
+    {
+      size_t head = m_head.load(std::memory_order_relaxed);
+      if (head == m_tail.load(std::memory_order_acquire)) {
+        return std::nullopt;
+      }
+      std::optional<T> item{std::move(m_buffer[head])};
+      m_head.store(next(head), std::memory_order_release);
+      return item;
+    }
+
+    size_t size() const
+    {
+      size_t head = m_head.load(std::memory_order_acquire);
+      size_t tail = m_tail.load(std::memory_order_acquire);
+      return (tail + m_buffer.size() - head) % m_buffer.size();
+    }
+
+    bool empty() const { return size() == 0; }
+
+    size_t capacity() const { return m_buffer.size() - 1; }
+
+  private:
+    size_t next(size_t index) const { return (index + 1) % m_buffer.size(); }
+
+    // one slot is always left free, to tell a full queue from an empty one
+    std::vector<T> m_buffer;
+
+    // index of the next item to pop, only written by the consumer
+    alignas(64) std::atomic<size_t> m_head;
+
+    // index of the next slot to fill, only written by the producer
+    alignas(64) std::atomic<size_t> m_tail;
+}; // class SpscQueue
+
+} // namespace transport
+} // namespace itcoin
+
+#endif // ITCOIN_TRANSPORT_SPSC_QUEUE_H
@@ -3,7 +3,9 @@
 
 #include "zcomm.h"
 
+#include <algorithm>
 #include <csignal>
+#include <pthread.h>
 
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
@@ -93,7 +95,9 @@ ZComm::ZComm(const itcoin::FbftConfig& conf):
     NetworkTransport{conf},
     ctx{std::make_unique<zmq::context_t>()},
     my_group{std::string{"replica" + std::to_string(conf.id())}},
-    itcoinblock_topic_name{"itcoinblock"}
+    itcoinblock_topic_name{"itcoinblock"},
+    inbound_queue{QUEUE_CAPACITY},
+    outbound_queue{QUEUE_CAPACITY}
 {
   // setup dish (rx)
   this->dish_socket = std::make_unique<zmq::socket_t>(*(this->ctx), zmq::socket_type::dish);
@@ -140,6 +144,13 @@ ZComm::ZComm(const itcoin::FbftConfig& conf):
   BOOST_LOG_TRIVIAL(info) << "itcoinblock: subscribing topic " << this->itcoinblock_topic_name << " on " << conf.getItcoinblockConnectionString();
   this->itcoin_sub_socket->connect(conf.getItcoinblockConnectionString());
   this->itcoin_sub_socket->set(zmq::sockopt::subscribe, this->itcoinblock_topic_name);
+
+  // setup the doorbell of the I/O thread (outbound frames)
+  const std::string doorbell_address = "inproc://outbound-doorbell-" + this->my_group;
+  this->outbound_doorbell_rx = std::make_unique<zmq::socket_t>(*(this->ctx), zmq::socket_type::pair);
+  this->outbound_doorbell_rx->bind(doorbell_address);
+  this->outbound_doorbell_tx = std::make_unique<zmq::socket_t>(*(this->ctx), zmq::socket_type::pair);
+  this->outbound_doorbell_tx->connect(doorbell_address);
 } // ZComm::ZComm()
 
 void ZComm::handler_dish(zmq::event_flags e)
@@ -150,8 +161,17 @@ void ZComm::handler_dish(zmq::event_flags e)
     zmq::recv_result_t res = this->dish_socket->recv(msg, zmq::recv_flags::none);
     if (res.has_value()) {
       BOOST_LOG_TRIVIAL(info) << "Received " << res.value() << " bytes from network on group " << msg.group();
-      // emit the replica_message_received() signal
-      this->replica_message_received(std::string{msg.group()}, msg.to_string());
+      // decode the frame here, the consensus thread only gets valid messages
+      auto p_msg = fbft::messages::Message::BuildFromBinBuffer(msg.to_string());
+      if (p_msg.has_value() == false) {
+        BOOST_LOG_TRIVIAL(error) << "Discarding an undecodable message received on group " << msg.group();
+        return;
+      }
+      InboundFrame frame;
+      frame.type = InboundFrame::REPLICA_MESSAGE;
+      frame.group_name = std::string{msg.group()};
+      frame.p_msg = std::move(p_msg.value());
+      this->push_inbound_frame(std::move(frame));
     } else {
       BOOST_LOG_TRIVIAL(error) << "Errore durante la ricezione";
     }
@@ -200,9 +220,15 @@ void ZComm::handler_itcoin_block(zmq::event_flags e)
     // part 3: sequence number
     uint32_t seqNumber = bytesToInt(recv_msgs[2].data(), recv_msgs[2].size());
 
-    // emit the rawblock_received() signal
+    // hand off the block to the consensus thread
     BOOST_LOG_TRIVIAL(trace) << "new block received. Hash: " << hash_hex_string << ", height: " << block_height << ", time: " << block_time << ", seqnum: " << seqNumber;
-    this->itcoinblock_received(hash_hex_string, block_height, block_time, seqNumber);
+    InboundFrame frame;
+    frame.type = InboundFrame::ITCOIN_BLOCK;
+    frame.block_hash = hash_hex_string;
+    frame.block_height = block_height;
+    frame.block_time = block_time;
+    frame.block_seq_number = seqNumber;
+    this->push_inbound_frame(std::move(frame));
   } else if (zmq::event_flags::none != (e & ~zmq::event_flags::pollout)) {
     throw std::runtime_error("Unexpected event type " + std::to_string(static_cast<short>(e)));
   }
@@ -229,68 +255,75 @@ int ZComm::run_forever()
     return EXIT_FAILURE;
   }
 
-  zmq::active_poller_t poller;
-
-  poller.add(*(this->dish_socket), zmq::event_flags::pollin, [&](zmq::event_flags e) {
-    this->handler_dish(e);
-  });
-  poller.add(*(this->itcoin_sub_socket), zmq::event_flags::pollin, [&](zmq::event_flags e) {
-    this->handler_itcoin_block(e);
-  });
+  // Start the I/O thread, from now on this is the consensus thread
+  this->io_thread_stopping = false;
+  this->io_thread = std::thread(&ZComm::io_loop, this);
 
   // TODO: m_conf.target_block_time() should be a std::duration already, not a double
   std::chrono::milliseconds target_block_time{int(this->m_conf.target_block_time() * 1000)};
 
-  std::chrono::milliseconds network_timeout;
-  std::chrono::milliseconds elapsed{0};
+  /*
+   * The unix signals do not interrupt the wait on the inbound queue, hence we
+   * wake up at least once per MAX_WAIT_SLICE to check for them.
+   */
+  const std::chrono::milliseconds MAX_WAIT_SLICE{1000};
+
+  // Set when the previous iteration fired a deadline
+  bool deadline_fired = false;
   while (true) {
     try {
-      std::chrono::steady_clock::time_point before_wait = std::chrono::steady_clock::now();
-
-      std::chrono::milliseconds time_margin = (target_block_time - elapsed);
-      if (time_margin.count() < 1) {
-        BOOST_LOG_TRIVIAL(warning) << boost::format("ACHTUNG: the system is operating without any time margin. target_block_time: %1% ms, cycle elapsed time: %2% ms")
-          % target_block_time.count()
-          % elapsed.count();
-        network_timeout = std::chrono::milliseconds{1};
-      } else {
-        network_timeout = std::chrono::milliseconds{time_margin / 2};
-      }
-      // TODO REMOVE ME: Added to make experiments deterministic
-      if (is_first_time)
-      {
-        // the first time is better to have bigger timeout in order to trigger view changes
-        network_timeout = std::chrono::milliseconds{10000};
-        is_first_time = false;
+      std::chrono::system_clock::time_point now = std::chrono::system_clock::now();
+      this->refresh_timer_queue(now, target_block_time / 2);
+      std::chrono::system_clock::time_point next_deadline = this->timer_queue.top();
+
+      /*
+       * A deadline already reached is fired right away, after dispatching the
+       * pending frames. If it is still there after being fired, we wait at
+       * least 1 ms, not to spin while the replica cannot handle it.
+       */
+      std::chrono::system_clock::time_point wake_up = std::min(next_deadline, now + MAX_WAIT_SLICE);
+      if (deadline_fired) {
+        wake_up = std::max(wake_up, now + std::chrono::milliseconds{1});
       }
-      else
+      BOOST_LOG_TRIVIAL(trace) << "WAITING AT MOST "
+        << std::chrono::duration_cast<std::chrono::milliseconds>(wake_up - now).count() << " ms";
+
       {
-        // A determinist and small timeout
-        network_timeout = std::chrono::milliseconds{5};
+        std::unique_lock<std::mutex> lock(this->inbound_mutex);
+        this->inbound_cv.wait_until(lock, wake_up, [this]() {
+          return !this->inbound_queue.empty() || s_interrupted;
+        });
       }
-      // TODO REMOVE ME END
-      BOOST_LOG_TRIVIAL(trace) << "WAITING AT MOST " << network_timeout.count() << " ms";
-
-      auto event_count = poller.wait(network_timeout);
-      std::chrono::steady_clock::time_point after_wait = std::chrono::steady_clock::now();
 
-      elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(after_wait - before_wait);
+      size_t frame_count = this->dispatch_inbound_frames();
+      std::chrono::system_clock::time_point after_wait = std::chrono::system_clock::now();
 
-      BOOST_LOG_TRIVIAL(trace) << "ELAPSED: " << elapsed.count() << " ms, EVENT COUNT: " << event_count << ", POLLING TIMEOUT WAS: " << network_timeout.count() << " ms";
+      BOOST_LOG_TRIVIAL(trace) << "FRAME COUNT: " << frame_count;
 
-      if (event_count > 0) {
+      if (frame_count > 0) {
         // at least an event happened on the network: start the cycle again
-        continue;
-      }
-
-      /*
-       * Nothing happened on the network: emit the network_timeout_expired()
-       * signal
-       */
-        std::chrono::steady_clock::time_point before_idle = std::chrono::steady_clock::now();
+        deadline_fired = false;
+      } else if (after_wait >= next_deadline) {
+        /*
+         * The next deadline was reached without network events: emit the
+         * network_timeout_expired() signal
+         */
+        BOOST_LOG_TRIVIAL(trace) << "DEADLINE REACHED, WOKE UP "
+          << std::chrono::duration_cast<std::chrono::microseconds>(after_wait - next_deadline).count() << " us LATE";
         this->network_timeout_expired();
-        std::chrono::steady_clock::time_point after_idle = std::chrono::steady_clock::now();
-        elapsed = std::chrono::duration_cast<std::chrono::milliseconds>(after_idle - before_idle);
+        deadline_fired = true;
+
+        ZCommMetrics current_metrics = this->metrics();
+        BOOST_LOG_TRIVIAL(debug) << boost::format("ZComm queues: inbound depth %1%, frames %2%, dropped %3%, max hand-off %4% s; outbound depth %5%, frames %6%, dropped %7%, max hand-off %8% s")
+          % current_metrics.inbound_queue_depth
+          % current_metrics.inbound_frames
+          % current_metrics.dropped_inbound_frames
+          % current_metrics.max_inbound_handoff_latency
+          % current_metrics.outbound_queue_depth
+          % current_metrics.outbound_frames
+          % current_metrics.dropped_outbound_frames
+          % current_metrics.max_outbound_handoff_latency;
+      }
     } catch (zmq::error_t &e) {
         BOOST_LOG_TRIVIAL(info) << "Interrupt received: " << e.what();
     }
@@ -300,6 +333,8 @@ int ZComm::run_forever()
     }
   } // while (true)
 
+  this->stop_io_thread();
+
   /*
    * Restore the old handlers for SIGTERM and SIGINT.
    *
@@ -312,25 +347,191 @@ int ZComm::run_forever()
   return EXIT_SUCCESS;
 } // ZComm::run_forever()
 
-void ZComm::BroadcastMessage(std::unique_ptr<fbft::messages::Message> p_msg)
+void ZComm::refresh_timer_queue(std::chrono::system_clock::time_point now, std::chrono::milliseconds idle_timeout)
+{
+  this->timer_queue = TimerQueue_t{};
+  this->timer_queue.push(now + idle_timeout);
+
+  std::vector<double> deadlines;
+  this->deadlines_requested(deadlines);
+  for (double deadline: deadlines) {
+    std::chrono::duration<double> since_epoch{deadline};
+    this->timer_queue.push(std::chrono::system_clock::time_point{
+      std::chrono::duration_cast<std::chrono::system_clock::duration>(since_epoch)
+    });
+  }
+} // ZComm::refresh_timer_queue()
+
+void ZComm::BroadcastMessage(std::shared_ptr<const fbft::messages::Message> p_msg)
 {
   this->broadcast(p_msg->ToBinBuffer());
 } // ZComm::BroadcastMessage()
 
 void ZComm::broadcast(const std::string& bin_buffer)
 {
-  zmq::message_t msg(bin_buffer);
+  OutboundFrame frame{bin_buffer, std::chrono::steady_clock::now()};
+  if (this->outbound_queue.TryPush(std::move(frame)) == false) {
+    this->dropped_outbound_frames++;
+    BOOST_LOG_TRIVIAL(error) << "The outbound queue is full, discarding " << bin_buffer.length() << " bytes for group " << this->my_group;
+    return;
+  }
+
+  // wake up the I/O thread. If the doorbell is already ringing, once is enough
+  zmq::message_t bell;
+  this->outbound_doorbell_tx->send(bell, zmq::send_flags::dontwait);
+} // ZComm::broadcast()
+
+ZCommMetrics ZComm::metrics() const
+{
+  ZCommMetrics result;
+  result.inbound_queue_depth = this->inbound_queue.size();
+  result.outbound_queue_depth = this->outbound_queue.size();
+  result.inbound_frames = this->inbound_frames;
+  result.outbound_frames = this->outbound_frames;
+  result.dropped_inbound_frames = this->dropped_inbound_frames;
+  result.dropped_outbound_frames = this->dropped_outbound_frames;
+  result.latest_inbound_handoff_latency = this->latest_inbound_handoff_latency;
+  result.max_inbound_handoff_latency = this->max_inbound_handoff_latency;
+  result.latest_outbound_handoff_latency = this->latest_outbound_handoff_latency;
+  result.max_outbound_handoff_latency = this->max_outbound_handoff_latency;
+  return result;
+} // ZComm::metrics()
+
+void ZComm::io_loop()
+{
+  // the unix signals are handled by the consensus thread
+  sigset_t signal_set;
+  sigemptyset(&signal_set);
+  sigaddset(&signal_set, SIGINT);
+  sigaddset(&signal_set, SIGTERM);
+  pthread_sigmask(SIG_BLOCK, &signal_set, nullptr);
+
+  zmq::active_poller_t poller;
+
+  poller.add(*(this->dish_socket), zmq::event_flags::pollin, [&](zmq::event_flags e) {
+    this->handler_dish(e);
+  });
+  poller.add(*(this->itcoin_sub_socket), zmq::event_flags::pollin, [&](zmq::event_flags e) {
+    this->handler_itcoin_block(e);
+  });
+  poller.add(*(this->outbound_doorbell_rx), zmq::event_flags::pollin, [&](zmq::event_flags e) {
+    this->handler_outbound_doorbell(e);
+  });
+
+  while (this->io_thread_stopping == false) {
+    try {
+      // there are no timers here, sleep until the next frame or doorbell
+      poller.wait(std::chrono::milliseconds{-1});
+    } catch (zmq::error_t &e) {
+      BOOST_LOG_TRIVIAL(error) << "I/O thread: " << e.what();
+    }
+  }
+  BOOST_LOG_TRIVIAL(debug) << "I/O thread exiting";
+} // ZComm::io_loop()
+
+void ZComm::handler_outbound_doorbell(zmq::event_flags e)
+{
+  if ((e & zmq::event_flags::pollin) != zmq::event_flags::none) {
+    // consume all the pending rings at once
+    zmq::message_t bell;
+    while (this->outbound_doorbell_rx->recv(bell, zmq::recv_flags::dontwait).has_value()) {
+    }
+
+    while (std::optional<OutboundFrame> frame = this->outbound_queue.TryPop()) {
+      this->send_outbound_frame(frame.value());
+    }
+  } else if (zmq::event_flags::none != (e & ~zmq::event_flags::pollout)) {
+    throw std::runtime_error("Unexpected event type " + std::to_string(static_cast<short>(e)));
+  }
+} // ZComm::handler_outbound_doorbell()
+
+void ZComm::push_inbound_frame(InboundFrame&& frame)
+{
+  frame.received_at = std::chrono::steady_clock::now();
+  if (frame.type == InboundFrame::ITCOIN_BLOCK) {
+    // a missed block would stall the replica, wait for the consensus thread to make room
+    while (this->inbound_queue.TryPush(std::move(frame)) == false) {
+      if (this->io_thread_stopping) {
+        return;
+      }
+      std::this_thread::sleep_for(INBOUND_BACKPRESSURE_SLICE);
+    }
+  } else if (this->inbound_queue.TryPush(std::move(frame)) == false) {
+    this->dropped_inbound_frames++;
+    BOOST_LOG_TRIVIAL(error) << "The inbound queue is full, discarding a frame";
+    return;
+  }
+
+  // the lock only orders the notification with the predicate check of the consensus thread
+  {
+    std::lock_guard<std::mutex> lock(this->inbound_mutex);
+  }
+  this->inbound_cv.notify_one();
+} // ZComm::push_inbound_frame()
+
+void ZComm::send_outbound_frame(const OutboundFrame& frame)
+{
+  double handoff_latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame.enqueued_at).count();
+  this->latest_outbound_handoff_latency = handoff_latency;
+  this->max_outbound_handoff_latency = std::max(this->max_outbound_handoff_latency.load(), handoff_latency);
+  this->outbound_frames++;
+
+  zmq::message_t msg(frame.bin_buffer);
   msg.set_group(this->my_group.c_str());
 
-  BOOST_LOG_TRIVIAL(info) << "broadcasting " << bin_buffer.length() << " bytes on group " << msg.group();
+  BOOST_LOG_TRIVIAL(info) << "broadcasting " << frame.bin_buffer.length() << " bytes on group " << msg.group();
   zmq::send_result_t res = this->radio_socket->send(msg, zmq::send_flags::none);
   if (res.has_value() == false) {
-    BOOST_LOG_TRIVIAL(error) << "Error while trying to broadcast " << bin_buffer.length() << "bytes on group " << msg.group();
+    BOOST_LOG_TRIVIAL(error) << "Error while trying to broadcast " << frame.bin_buffer.length() << "bytes on group " << msg.group();
   }
-} // ZComm::broadcast()
+} // ZComm::send_outbound_frame()
+
+size_t ZComm::dispatch_inbound_frames()
+{
+  // do not dispatch the frames arriving meanwhile, so that the deadlines are not starved
+  size_t frame_count = this->inbound_queue.size();
+  std::vector<std::shared_ptr<const fbft::messages::Message>> replica_msgs;
+  for (size_t i = 0; i < frame_count; i++) {
+    std::optional<InboundFrame> frame = this->inbound_queue.TryPop();
+
+    double handoff_latency = std::chrono::duration<double>(std::chrono::steady_clock::now() - frame->received_at).count();
+    this->latest_inbound_handoff_latency = handoff_latency;
+    this->max_inbound_handoff_latency = std::max(this->max_inbound_handoff_latency.load(), handoff_latency);
+    this->inbound_frames++;
+
+    if (frame->type == InboundFrame::REPLICA_MESSAGE) {
+      replica_msgs.emplace_back(std::move(frame->p_msg));
+    } else {
+      // the messages received before the block are dispatched first
+      if (!replica_msgs.empty()) {
+        this->replica_messages_received(replica_msgs);
+        replica_msgs.clear();
+      }
+      // emit the itcoinblock_received() signal
+      this->itcoinblock_received(frame->block_hash, frame->block_height, frame->block_time, frame->block_seq_number);
+    }
+  }
+  if (!replica_msgs.empty()) {
+    // emit the replica_messages_received() signal
+    this->replica_messages_received(replica_msgs);
+  }
+  return frame_count;
+} // ZComm::dispatch_inbound_frames()
+
+void ZComm::stop_io_thread()
+{
+  if (this->io_thread.joinable() == false) {
+    return;
+  }
+  this->io_thread_stopping = true;
+  zmq::message_t bell;
+  this->outbound_doorbell_tx->send(bell, zmq::send_flags::dontwait);
+  this->io_thread.join();
+} // ZComm::stop_io_thread()
 
 ZComm::~ZComm()
 {
+  this->stop_io_thread();
 } // ZComm::~ZComm()
 
 
@@ -6,6 +6,13 @@
 
 #include "config/FbftConfig.h"
 #include "network.h"
+#include "spsc_queue.h"
+#include <atomic>
+#include <condition_variable>
+#include <functional>
+#include <mutex>
+#include <queue>
+#include <thread>
 #include <boost/signals2.hpp>
 
 #define ZMQ_BUILD_DRAFT_API
@@ -43,6 +50,27 @@ using namespace std::chrono_literals;
  */
 std::optional<std::tuple<std::string, int32_t, uint32_t>> decode_itcoinblock_payload(const std::string& bin_buffer);
 
+/**
+ * A copy of the counters of a ZComm object, see ZComm::metrics().
+ *
+ * The hand-off latency is the time spent by a frame in a queue, i.e. from
+ * its receipt by the I/O thread to its dispatch by the consensus thread, or
+ * from its broadcast by the consensus thread to its sending by the I/O thread.
+ */
+struct ZCommMetrics {
+  size_t inbound_queue_depth = 0;
+  size_t outbound_queue_depth = 0;
+  uint64_t inbound_frames = 0;
+  uint64_t outbound_frames = 0;
+  uint64_t dropped_inbound_frames = 0;
+  uint64_t dropped_outbound_frames = 0;
+  // seconds
+  double latest_inbound_handoff_latency = 0;
+  double max_inbound_handoff_latency = 0;
+  double latest_outbound_handoff_latency = 0;
+  double max_outbound_handoff_latency = 0;
+};
+
 class ZComm : public network::NetworkTransport {
   public:
     /**
@@ -54,6 +82,8 @@ class ZComm : public network::NetworkTransport {
      * retransmissions and discarding of new messages when the send queue is
      * full.
      *
+     * The sockets are only used by the I/O thread started by run_forever().
+     *
      * conf:
      *     A FbftConfig object
      */
@@ -67,19 +97,35 @@ class ZComm : public network::NetworkTransport {
      * come back online.
      *
      * The messages will be sent on a group named "replicaX", where X is my_id.
+     *
+     * The message is handed off to the I/O thread through the outbound queue,
+     * hence this must always be called by the same thread, i.e. the consensus
+     * thread. If the outbound queue is full, the message is discarded.
      */
     void broadcast(const std::string& bin_buffer);
 
-    void BroadcastMessage(std::unique_ptr<fbft::messages::Message> p_msg);
+    void BroadcastMessage(std::shared_ptr<const fbft::messages::Message> p_msg);
 
     /**
-     * Runs forever. Relevant events are published via the following
+     * Runs forever. The calling thread becomes the consensus thread, while a
+     * dedicated I/O thread receives and decodes the incoming frames, and sends
+     * the outgoing ones. The two threads exchange the frames through bounded
+     * single-producer/single-consumer queues of QUEUE_CAPACITY frames. When
+     * the inbound queue is full, replica messages are discarded, while block
+     * notifications wait for room, leaving the new frames in the zmq sockets.
+     *
+     * Relevant events are published on the consensus thread via the following
      * boost.signals2 signals:
-     * - replica_message_received, if a message from a replica was received;
+     * - replica_messages_received, with the messages from the replicas received
+     *   one after the other, between two itcoinblock notifications;
      * - itcoinblock_received, if the itcoin-core process local to this miner
      *   has notified us of the appearance of a new block;
-     * - network_timeout_expired, if there was no network traffic for more than
-     *   half the target_block_time.
+     * - network_timeout_expired, when the earliest deadline of the timer queue
+     *   is reached without network traffic in between.
+     *
+     * Before each wait, the timer queue is filled with the deadlines collected
+     * via deadlines_requested, plus half the target_block_time from now, so that
+     * the loop sleeps until the next deadline or network event.
      *
      * If SIGINT or SIGTERM are caught, returns EXIT_SUCCESS.
      *
@@ -89,10 +135,13 @@ class ZComm : public network::NetworkTransport {
     int run_forever();
 
     /**
-     * typedef for the signal emitted when receiving a message from a miner
-     * replica: (group_name, bin_buffer)
+     * typedef for the signal emitted when receiving messages from the miner
+     * replicas: (p_msgs), in arrival order. The messages are delivered as a
+     * batch, so that their signatures can be verified in parallel. They have
+     * already been decoded by the I/O thread, they are immutable and a slot
+     * may keep a reference to them.
      */
-    typedef bs2::signal<void (std::string, std::string)> SigReplicaMessageReceived_t;
+    typedef bs2::signal<void (const std::vector<std::shared_ptr<const fbft::messages::Message>>&)> SigReplicaMessagesReceived_t;
 
     /**
      * typedef for the signal emitted when receiving a itcoinblock: (block hash
@@ -101,14 +150,23 @@ class ZComm : public network::NetworkTransport {
     typedef bs2::signal<void (const std::string&, int32_t, uint32_t, uint32_t)> SigItcoinBlockReceived_t;
 
     /**
-     * typedef for the signal emitted when no events have happened on the
-     * network for half the expected cycle time (target_block_time / 2)
+     * typedef for the signal emitted when a deadline of the timer queue is
+     * reached, or no events have happened on the network for half the expected
+     * cycle time (target_block_time / 2)
      */
     typedef bs2::signal<void (void)> SigNetworkTimeoutExpired_t;
 
-    SigReplicaMessageReceived_t replica_message_received;
+    /**
+     * typedef for the signal emitted before waiting for network events. The
+     * slots append the times, in seconds since the Epoch, at which they have
+     * timed work to do: (deadlines)
+     */
+    typedef bs2::signal<void (std::vector<double>&)> SigDeadlinesRequested_t;
+
+    SigReplicaMessagesReceived_t replica_messages_received;
     SigItcoinBlockReceived_t itcoinblock_received;
     SigNetworkTimeoutExpired_t network_timeout_expired;
+    SigDeadlinesRequested_t deadlines_requested;
 
     /**
      * Messages on the "itcoinblock" topic must be of a fixed size of 40 bits
@@ -116,10 +174,65 @@ class ZComm : public network::NetworkTransport {
      */
     static constexpr uint16_t ITCOINBLOCK_MSG_SIZE = 40;
 
+    /**
+     * Maximum number of frames waiting in each direction
+     */
+    static constexpr size_t QUEUE_CAPACITY = 1024;
+
+    /**
+     * How long the I/O thread sleeps between two attempts to queue a block
+     * notification, while the inbound queue is full
+     */
+    static constexpr std::chrono::milliseconds INBOUND_BACKPRESSURE_SLICE{1};
+
+    /**
+     * Returns the current queue depths and the hand-off counters. Can be
+     * called from any thread.
+     */
+    ZCommMetrics metrics() const;
+
     ~ZComm();
 
   private:
-    bool is_first_time = true; // TODO REMOVE: the first time is better to have bigger timeout in order to trigger view changes
+    /**
+     * a frame received by the I/O thread, waiting for the consensus thread
+     */
+    struct InboundFrame {
+      enum FRAME_TYPE : unsigned int {
+        REPLICA_MESSAGE = 0,
+        ITCOIN_BLOCK = 1,
+      };
+      FRAME_TYPE type = REPLICA_MESSAGE;
+      // REPLICA_MESSAGE
+      std::string group_name;
+      std::shared_ptr<const fbft::messages::Message> p_msg;
+      // ITCOIN_BLOCK
+      std::string block_hash;
+      int32_t block_height = 0;
+      uint32_t block_time = 0;
+      uint32_t block_seq_number = 0;
+
+      std::chrono::steady_clock::time_point received_at;
+    };
+
+    /**
+     * a frame broadcast by the consensus thread, waiting for the I/O thread
+     */
+    struct OutboundFrame {
+      std::string bin_buffer;
+      std::chrono::steady_clock::time_point enqueued_at;
+    };
+
+    typedef std::priority_queue<
+      std::chrono::system_clock::time_point,
+      std::vector<std::chrono::system_clock::time_point>,
+      std::greater<std::chrono::system_clock::time_point>
+    > TimerQueue_t;
+
+    /**
+     * the upcoming deadlines, the earliest one on top
+     */
+    TimerQueue_t timer_queue;
 
     const std::string my_group;
     const std::string itcoinblock_topic_name;
@@ -142,8 +255,57 @@ class ZComm : public network::NetworkTransport {
      */
     std::unique_ptr<zmq::socket_t> itcoin_sub_socket;
 
+    /**
+     * the consensus thread wakes up the I/O thread, when there are outbound
+     * frames, by sending an empty message from outbound_doorbell_tx to
+     * outbound_doorbell_rx
+     */
+    std::unique_ptr<zmq::socket_t> outbound_doorbell_rx;
+    std::unique_ptr<zmq::socket_t> outbound_doorbell_tx;
+
+    SpscQueue<InboundFrame> inbound_queue;
+    SpscQueue<OutboundFrame> outbound_queue;
+
+    /**
+     * only used to put the consensus thread to sleep while the inbound queue
+     * is empty, the frames do not go through the lock
+     */
+    std::mutex inbound_mutex;
+    std::condition_variable inbound_cv;
+
+    std::thread io_thread;
+    std::atomic<bool> io_thread_stopping{false};
+
+    std::atomic<uint64_t> inbound_frames{0};
+    std::atomic<uint64_t> outbound_frames{0};
+    std::atomic<uint64_t> dropped_inbound_frames{0};
+    std::atomic<uint64_t> dropped_outbound_frames{0};
+    std::atomic<double> latest_inbound_handoff_latency{0};
+    std::atomic<double> max_inbound_handoff_latency{0};
+    std::atomic<double> latest_outbound_handoff_latency{0};
+    std::atomic<double> max_outbound_handoff_latency{0};
+
+    // I/O thread
+    void io_loop();
     void handler_dish(zmq::event_flags e);
     void handler_itcoin_block(zmq::event_flags e);
+    void handler_outbound_doorbell(zmq::event_flags e);
+    void push_inbound_frame(InboundFrame&& frame);
+    void send_outbound_frame(const OutboundFrame& frame);
+
+    // consensus thread
+    /**
+     * Emits the signals of the frames in the inbound queue, returns how many
+     * frames were dispatched.
+     */
+    size_t dispatch_inbound_frames();
+    void stop_io_thread();
+
+    /**
+     * Refills the timer queue with the deadlines of the listeners and the
+     * idle deadline, i.e. now + idle_timeout.
+     */
+    void refresh_timer_queue(std::chrono::system_clock::time_point now, std::chrono::milliseconds idle_timeout);
 }; // class ZComm
 
 } // namespace transport
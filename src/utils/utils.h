@@ -131,6 +131,22 @@ constexpr auto type_name() {
   return name;
 } // type_name()
 
+/**
+ * Builds a visitor for std::visit out of a set of lambdas, one for each
+ * alternative of the variant.
+ *
+ * EXAMPLE:
+ *     std::variant<int, std::string> v = 42;
+ *     std::visit(overloaded{
+ *       [](int i) { std::cout << "int " << i; },
+ *       [](const std::string& s) { std::cout << "string " << s; },
+ *     }, v);
+ *
+ * source: https://en.cppreference.com/w/cpp/utility/variant/visit
+ */
+template<class... Fs> struct overloaded : Fs... { using Fs::operator()...; };
+template<class... Fs> overloaded(Fs...) -> overloaded<Fs...>;
+
 } // namespace utils
 } // namespace itcoin
 
@@ -20,6 +20,25 @@ namespace wallet {
 BitcoinRpcWallet::BitcoinRpcWallet(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind):
 Wallet(conf), m_bitcoind(bitcoind)
 {
+  if (m_signature_scheme != SIGNATURE_SCHEME::ECDSA)
+  {
+    string error_msg = str(
+      boost::format("R%1% BitcoinRpcWallet only supports the %2% signatures.")
+        % m_conf.id()
+        % SIGNATURE_SCHEME_AS_STRING[SIGNATURE_SCHEME::ECDSA]
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw runtime_error(error_msg);
+  }
+  if (m_conf.fbft_mac_authenticators())
+  {
+    string error_msg = str(
+      boost::format("R%1% BitcoinRpcWallet does not support the MAC authenticators.")
+        % m_conf.id()
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw runtime_error(error_msg);
+  }
   m_pubkey_address = m_conf.replica_set_v().at(m_conf.id()).p2pkh();
   BOOST_LOG_TRIVIAL(debug) << str(
     boost::format("R%1% BitcoinRpcWallet will sign using pubkey address %2%.")
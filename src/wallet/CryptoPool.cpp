@@ -0,0 +1,227 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "wallet.h"
+
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+
+#include "../fbft/messages/messages.h"
+
+using namespace std;
+using Message = itcoin::fbft::messages::Message;
+using MSG_TYPE = itcoin::fbft::messages::MSG_TYPE;
+using NewView = itcoin::fbft::messages::NewView;
+using ViewChange = itcoin::fbft::messages::ViewChange;
+
+namespace itcoin {
+namespace wallet {
+
+CryptoPool::CryptoPool(const Wallet& wallet, uint32_t num_threads, size_t verification_cache_size):
+m_wallet(wallet), m_verification_cache(verification_cache_size), m_task(nullptr), m_num_tasks(0), m_batch_id(0), m_busy_workers(0), m_stopping(false),
+m_next_task(0), m_done_tasks(0)
+{
+  for (uint32_t i = 0; i < num_threads; i++)
+  {
+    m_workers.emplace_back(&CryptoPool::WorkerLoop, this);
+  }
+}
+
+CryptoPool::~CryptoPool()
+{
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_stopping = true;
+  }
+  m_batch_cv.notify_all();
+  for (std::thread& worker : m_workers)
+  {
+    worker.join();
+  }
+}
+
+vector<const Message*> CryptoPool::SignedParts(const Message& msg) const
+{
+  vector<const Message*> parts;
+  if (m_wallet.signature_scheme() == SIGNATURE_SCHEME::BIP340 && msg.type() == MSG_TYPE::NEW_VIEW)
+  {
+    for (const ViewChange& vc : static_cast<const NewView&>(msg).view_changes())
+    {
+      parts.emplace_back(&vc);
+    }
+  }
+  parts.emplace_back(&msg);
+  return parts;
+}
+
+vector<bool> CryptoPool::VerifyAll(const vector<shared_ptr<const Message>>& msgs)
+{
+  // One batch at a time, the verification cache and the batch state are shared by the callers
+  std::lock_guard<std::mutex> batch_lock(m_batch_mutex);
+
+  // All the signatures of the batch, including those embedded in the messages, are verified together
+  vector<const Message*> parts;
+  vector<size_t> part_owners;
+  vector<bool> valid_digests(msgs.size(), true);
+  for (size_t i = 0; i < msgs.size(); i++)
+  {
+    try
+    {
+      vector<const Message*> msg_parts = SignedParts(*msgs[i]);
+      for (const Message* p_part : msg_parts)
+      {
+        p_part->digest();
+      }
+      for (const Message* p_part : msg_parts)
+      {
+        parts.emplace_back(p_part);
+        part_owners.emplace_back(i);
+      }
+    }
+    catch (const std::exception& e)
+    {
+      BOOST_LOG_TRIVIAL(error) << str(
+        boost::format("CryptoPool cannot verify %1%: %2%")
+          % msgs[i]->identify()
+          % e.what()
+      );
+      valid_digests[i] = false;
+    }
+  }
+
+  // vector<bool> packs the results in shared words, each task writes its own byte
+  vector<char> valid(parts.size(), false);
+  vector<char> to_be_verified(parts.size(), false);
+  for (size_t j = 0; j < parts.size(); j++)
+  {
+    valid[j] = m_verification_cache.Lookup(*parts[j]);
+    to_be_verified[j] = !valid[j];
+  }
+
+  ParallelFor(parts.size(), [this, &parts, &valid, &to_be_verified](size_t j) {
+    if (to_be_verified[j])
+    {
+      valid[j] = m_wallet.VerifySignature(*parts[j]);
+    }
+  });
+
+  vector<bool> result(valid_digests);
+  for (size_t j = 0; j < parts.size(); j++)
+  {
+    if (to_be_verified[j] && valid[j])
+    {
+      m_verification_cache.Insert(*parts[j]);
+    }
+    result[part_owners[j]] = result[part_owners[j]] && valid[j];
+  }
+  return result;
+}
+
+void CryptoPool::SignAll(vector<unique_ptr<Message>>& msgs)
+{
+  std::lock_guard<std::mutex> batch_lock(m_batch_mutex);
+
+  for (const unique_ptr<Message>& p_msg : msgs)
+  {
+    for (const Message* p_part : SignedParts(*p_msg))
+    {
+      p_part->digest();
+    }
+  }
+
+  vector<std::exception_ptr> errors(msgs.size());
+  ParallelFor(msgs.size(), [this, &msgs, &errors](size_t i) {
+    try
+    {
+      if (m_wallet.signature_scheme() == SIGNATURE_SCHEME::BIP340 && msgs[i]->type() == MSG_TYPE::NEW_VIEW)
+      {
+        static_cast<NewView&>(*msgs[i]).SignViewChanges(m_wallet);
+      }
+      msgs[i]->Sign(m_wallet);
+    }
+    catch (...)
+    {
+      errors[i] = std::current_exception();
+    }
+  });
+  for (const std::exception_ptr& error : errors)
+  {
+    if (error)
+    {
+      std::rethrow_exception(error);
+    }
+  }
+}
+
+void CryptoPool::ParallelFor(size_t num_tasks, const std::function<void(size_t)>& task)
+{
+  if (m_workers.empty() || num_tasks < 2)
+  {
+    for (size_t i = 0; i < num_tasks; i++)
+    {
+      task(i);
+    }
+    return;
+  }
+
+  {
+    std::lock_guard<std::mutex> lock(m_mutex);
+    m_task = &task;
+    m_num_tasks = num_tasks;
+    m_next_task = 0;
+    m_done_tasks = 0;
+    m_batch_id += 1;
+  }
+  m_batch_cv.notify_all();
+
+  RunTasks(task, num_tasks);
+
+  // Workers joining the batch late may still hold a reference to task
+  std::unique_lock<std::mutex> lock(m_mutex);
+  m_done_cv.wait(lock, [this, num_tasks]() { return m_done_tasks == num_tasks && m_busy_workers == 0; });
+  m_task = nullptr;
+}
+
+void CryptoPool::RunTasks(const std::function<void(size_t)>& task, size_t num_tasks)
+{
+  for (size_t i = m_next_task.fetch_add(1); i < num_tasks; i = m_next_task.fetch_add(1))
+  {
+    task(i);
+    m_done_tasks.fetch_add(1);
+  }
+}
+
+void CryptoPool::WorkerLoop()
+{
+  uint64_t last_batch_id = 0;
+  while (true)
+  {
+    const std::function<void(size_t)>* task;
+    size_t num_tasks;
+    {
+      std::unique_lock<std::mutex> lock(m_mutex);
+      m_batch_cv.wait(lock, [this, last_batch_id]() {
+        return m_stopping || (m_task != nullptr && m_batch_id != last_batch_id);
+      });
+      if (m_stopping)
+      {
+        return;
+      }
+      task = m_task;
+      num_tasks = m_num_tasks;
+      last_batch_id = m_batch_id;
+      m_busy_workers += 1;
+    }
+
+    RunTasks(*task, num_tasks);
+
+    {
+      std::lock_guard<std::mutex> lock(m_mutex);
+      m_busy_workers -= 1;
+    }
+    m_done_cv.notify_one();
+  }
+}
+
+}
+}
@@ -0,0 +1,351 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "wallet.h"
+
+#include <base58.h>
+#include <boost/format.hpp>
+#include <boost/log/trivial.hpp>
+#include <crypto/hmac_sha256.h>
+#include <util/message.h>
+#include <util/strencodings.h>
+
+#include <secp256k1/include/secp256k1_recovery.h>
+#include <secp256k1/include/secp256k1_schnorrsig.h>
+
+#include "config/FbftConfig.h"
+#include "../fbft/messages/messages.h"
+#include "../transport/btcclient.h"
+
+using namespace std;
+using Message = itcoin::fbft::messages::Message;
+using MSG_TYPE = itcoin::fbft::messages::MSG_TYPE;
+
+namespace itcoin {
+namespace wallet {
+
+// Size of the compact signatures produced by signmessage: one header byte, then r and s
+const size_t COMPACT_SIGNATURE_SIZE = 65;
+// The header is 27 + recovery id, plus 4 when the public key is compressed
+const unsigned char COMPACT_SIGNATURE_HEADER_COMPRESSED = 27 + 4;
+const size_t COMPRESSED_PUBKEY_SIZE = 33;
+const size_t SCHNORR_SIGNATURE_SIZE = 64;
+// Tag of the BIP340 hash of the message digests, so that a signature is never valid for another protocol
+const string SCHNORR_MESSAGE_TAG = "itcoin-fbft/message";
+// Tag of the hash of the ECDH point from which the session keys are derived
+const string SESSION_KEY_TAG = "itcoin-fbft/session-key";
+const size_t MAC_SIZE = CHMAC_SHA256::OUTPUT_SIZE;
+
+static vector<string> replica_pubkeys(const itcoin::FbftConfig& conf)
+{
+  vector<string> pubkeys;
+  for (const auto& replica_config : conf.replica_set_v())
+  {
+    pubkeys.emplace_back(replica_config.pubkey());
+  }
+  return pubkeys;
+}
+
+NativeWallet::NativeWallet(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind):
+NativeWallet(conf, DumpPrivateKey(conf, bitcoind))
+{
+}
+
+NativeWallet::NativeWallet(const itcoin::FbftConfig& conf, const std::vector<unsigned char>& private_key):
+NativeWallet(conf, private_key, replica_pubkeys(conf))
+{
+}
+
+NativeWallet::NativeWallet(const itcoin::FbftConfig& conf, const std::vector<unsigned char>& private_key,
+  const std::vector<std::string>& pubkeys):
+Wallet(conf), m_private_key(private_key)
+{
+  m_pubkey_address = m_conf.replica_set_v().at(m_conf.id()).p2pkh();
+  m_ctx = secp256k1_context_create(SECP256K1_CONTEXT_SIGN | SECP256K1_CONTEXT_VERIFY);
+
+  if (m_private_key.size() != 32 || !secp256k1_keypair_create(m_ctx, &m_keypair, m_private_key.data()))
+  {
+    secp256k1_context_destroy(m_ctx);
+    string error_msg = str(
+      boost::format("R%1% NativeWallet got an invalid private key.")
+        % m_conf.id()
+    );
+    throw runtime_error(error_msg);
+  }
+
+  for (uint32_t replica_id = 0; replica_id < pubkeys.size(); replica_id++)
+  {
+    vector<unsigned char> pubkey = ParseHex(pubkeys[replica_id]);
+    secp256k1_pubkey parsed_pubkey;
+    if (pubkey.size() != COMPRESSED_PUBKEY_SIZE
+      || !secp256k1_ec_pubkey_parse(m_ctx, &parsed_pubkey, pubkey.data(), pubkey.size()))
+    {
+      secp256k1_context_destroy(m_ctx);
+      string error_msg = str(
+        boost::format("R%1% NativeWallet cannot load the compressed public key of R%2%: %3%.")
+          % m_conf.id()
+          % replica_id
+          % pubkeys[replica_id]
+      );
+      throw runtime_error(error_msg);
+    }
+    secp256k1_xonly_pubkey xonly_pubkey;
+    secp256k1_xonly_pubkey_from_pubkey(m_ctx, &xonly_pubkey, nullptr, &parsed_pubkey);
+
+    // Both replicas of a pair get the same point, i.e. the product of the two private keys times the generator
+    secp256k1_pubkey shared_point = parsed_pubkey;
+    secp256k1_ec_pubkey_tweak_mul(m_ctx, &shared_point, m_private_key.data());
+    unsigned char serialized_shared_point[COMPRESSED_PUBKEY_SIZE];
+    size_t serialized_shared_point_len = COMPRESSED_PUBKEY_SIZE;
+    secp256k1_ec_pubkey_serialize(m_ctx, serialized_shared_point, &serialized_shared_point_len, &shared_point, SECP256K1_EC_COMPRESSED);
+    std::array<unsigned char, 32> session_key;
+    secp256k1_tagged_sha256(m_ctx, session_key.data(), (const unsigned char*) SESSION_KEY_TAG.data(), SESSION_KEY_TAG.size(),
+      serialized_shared_point, serialized_shared_point_len);
+
+    m_pubkeys.emplace_back(move(pubkey));
+    m_xonly_pubkeys.emplace_back(xonly_pubkey);
+    m_session_keys.emplace_back(session_key);
+  }
+
+  BOOST_LOG_TRIVIAL(debug) << str(
+    boost::format("R%1% NativeWallet will sign using pubkey address %2% and %3% signatures.")
+      % m_conf.id()
+      % m_pubkey_address
+      % SIGNATURE_SCHEME_AS_STRING[m_signature_scheme]
+  );
+}
+
+NativeWallet::~NativeWallet()
+{
+  secp256k1_context_destroy(m_ctx);
+}
+
+vector<unsigned char> NativeWallet::DumpPrivateKey(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind)
+{
+  string pubkey_address = conf.replica_set_v().at(conf.id()).p2pkh();
+  string b58_privkey = bitcoind.dumpprivkey(pubkey_address);
+  vector<unsigned char> raw_privkey;
+  // The private key is coded as base58check({80|ef} || private key || 01), the last byte marking a compressed public key
+  if (!DecodeBase58Check(b58_privkey, raw_privkey, 256 + 8) || raw_privkey.size() < 33)
+  {
+    string error_msg = str(
+      boost::format("R%1% NativeWallet cannot parse the private key of address %2%.")
+        % conf.id()
+        % pubkey_address
+    );
+    BOOST_LOG_TRIVIAL(error) << error_msg;
+    throw runtime_error(error_msg);
+  }
+  return vector<unsigned char>(raw_privkey.begin() + 1, raw_privkey.begin() + 33);
+}
+
+void NativeWallet::AppendSignature(Message& message) const
+{
+  if(message.sender_id() != m_conf.id())
+  {
+    string error_msg = str(
+      boost::format("R%1% NativeWallet cannot sign message with sender_id = %2%.")
+        % m_conf.id()
+        % message.sender_id()
+    );
+    throw runtime_error(error_msg);
+  }
+
+  if (IsAuthenticated(message))
+  {
+    AppendAuthenticator(message);
+  }
+  else if (m_signature_scheme == SIGNATURE_SCHEME::BIP340)
+  {
+    AppendSchnorrSignature(message);
+  }
+  else
+  {
+    AppendEcdsaSignature(message);
+  }
+}
+
+bool NativeWallet::VerifySignature(const Message& message) const
+{
+  if (message.sender_id() >= m_pubkeys.size())
+  {
+    return false;
+  }
+
+  if (IsAuthenticated(message))
+  {
+    return VerifyAuthenticator(message);
+  }
+  if (m_signature_scheme == SIGNATURE_SCHEME::BIP340)
+  {
+    return VerifySchnorrSignature(message);
+  }
+  return VerifyEcdsaSignature(message);
+}
+
+void NativeWallet::AppendEcdsaSignature(Message& message) const
+{
+  string msg_digest = message.digest();
+  uint256 msg_hash = MessageHash(msg_digest);
+
+  // Same deterministic nonce as bitcoind, hence the same signature signmessage would return
+  secp256k1_ecdsa_recoverable_signature sig;
+  if (!secp256k1_ecdsa_sign_recoverable(m_ctx, &sig, msg_hash.begin(), m_private_key.data(), nullptr, nullptr))
+  {
+    string error_msg = str(
+      boost::format("R%1% NativeWallet cannot sign message with digest = %2%.")
+        % m_conf.id()
+        % msg_digest
+    );
+    throw runtime_error(error_msg);
+  }
+  unsigned char compact_sig[COMPACT_SIGNATURE_SIZE];
+  int rec_id;
+  secp256k1_ecdsa_recoverable_signature_serialize_compact(m_ctx, compact_sig + 1, &rec_id, &sig);
+  compact_sig[0] = COMPACT_SIGNATURE_HEADER_COMPRESSED + rec_id;
+
+  BOOST_LOG_TRIVIAL(trace) << str(
+    boost::format("R%1% NativeWallet signing message with digest = %2%.")
+      % m_conf.id()
+      % msg_digest
+  );
+  message.set_signature(EncodeBase64(string((const char*) compact_sig, COMPACT_SIGNATURE_SIZE)));
+}
+
+bool NativeWallet::VerifyEcdsaSignature(const Message& message) const
+{
+  bool invalid_base64 = false;
+  string compact_sig = DecodeBase64(message.signature(), &invalid_base64);
+  if (invalid_base64 || compact_sig.size() != COMPACT_SIGNATURE_SIZE)
+  {
+    return false;
+  }
+  // The replicas sign with compressed public keys only
+  unsigned char header = compact_sig[0];
+  if (header < COMPACT_SIGNATURE_HEADER_COMPRESSED || header > COMPACT_SIGNATURE_HEADER_COMPRESSED + 3)
+  {
+    return false;
+  }
+
+  secp256k1_ecdsa_recoverable_signature sig;
+  if (!secp256k1_ecdsa_recoverable_signature_parse_compact(m_ctx, &sig,
+    (const unsigned char*) compact_sig.data() + 1, header - COMPACT_SIGNATURE_HEADER_COMPRESSED))
+  {
+    return false;
+  }
+  uint256 msg_hash = MessageHash(message.digest());
+  secp256k1_pubkey recovered_pubkey;
+  if (!secp256k1_ecdsa_recover(m_ctx, &recovered_pubkey, &sig, msg_hash.begin()))
+  {
+    return false;
+  }
+
+  // As verifymessage, the signature is valid if it recovers the public key of the sender
+  unsigned char serialized_pubkey[COMPRESSED_PUBKEY_SIZE];
+  size_t serialized_pubkey_len = COMPRESSED_PUBKEY_SIZE;
+  secp256k1_ec_pubkey_serialize(m_ctx, serialized_pubkey, &serialized_pubkey_len, &recovered_pubkey, SECP256K1_EC_COMPRESSED);
+  const vector<unsigned char>& sender_pubkey = m_pubkeys.at(message.sender_id());
+  return equal(sender_pubkey.begin(), sender_pubkey.end(), serialized_pubkey);
+}
+
+void NativeWallet::AppendSchnorrSignature(Message& message) const
+{
+  string msg_digest = message.digest();
+  unsigned char msg_hash[32];
+  secp256k1_tagged_sha256(m_ctx, msg_hash, (const unsigned char*) SCHNORR_MESSAGE_TAG.data(), SCHNORR_MESSAGE_TAG.size(),
+    (const unsigned char*) msg_digest.data(), msg_digest.size());
+
+  // Without auxiliary randomness the nonce is derived from the key and the message only
+  unsigned char sig[SCHNORR_SIGNATURE_SIZE];
+  if (!secp256k1_schnorrsig_sign32(m_ctx, sig, msg_hash, &m_keypair, nullptr))
+  {
+    string error_msg = str(
+      boost::format("R%1% NativeWallet cannot sign message with digest = %2%.")
+        % m_conf.id()
+        % msg_digest
+    );
+    throw runtime_error(error_msg);
+  }
+
+  BOOST_LOG_TRIVIAL(trace) << str(
+    boost::format("R%1% NativeWallet signing message with digest = %2%.")
+      % m_conf.id()
+      % msg_digest
+  );
+  message.set_signature(EncodeBase64(string((const char*) sig, SCHNORR_SIGNATURE_SIZE)));
+}
+
+bool NativeWallet::VerifySchnorrSignature(const Message& message) const
+{
+  bool invalid_base64 = false;
+  string sig = DecodeBase64(message.signature(), &invalid_base64);
+  if (invalid_base64 || sig.size() != SCHNORR_SIGNATURE_SIZE)
+  {
+    return false;
+  }
+
+  string msg_digest = message.digest();
+  unsigned char msg_hash[32];
+  secp256k1_tagged_sha256(m_ctx, msg_hash, (const unsigned char*) SCHNORR_MESSAGE_TAG.data(), SCHNORR_MESSAGE_TAG.size(),
+    (const unsigned char*) msg_digest.data(), msg_digest.size());
+  return secp256k1_schnorrsig_verify(m_ctx, (const unsigned char*) sig.data(), msg_hash, 32,
+    &m_xonly_pubkeys.at(message.sender_id()));
+}
+
+bool NativeWallet::IsAuthenticated(const Message& message) const
+{
+  if (!m_conf.fbft_mac_authenticators())
+  {
+    return false;
+  }
+  // As in PBFT, the messages carried by a VIEW_CHANGE or a NEW_VIEW keep their signatures
+  return message.type() == MSG_TYPE::PRE_PREPARE
+    || message.type() == MSG_TYPE::PREPARE
+    || message.type() == MSG_TYPE::COMMIT;
+}
+
+void NativeWallet::AppendAuthenticator(Message& message) const
+{
+  string msg_digest = message.digest();
+  string authenticator(m_session_keys.size() * MAC_SIZE, '\0');
+  for (size_t replica_id = 0; replica_id < m_session_keys.size(); replica_id++)
+  {
+    CHMAC_SHA256(m_session_keys[replica_id].data(), m_session_keys[replica_id].size())
+      .Write((const unsigned char*) msg_digest.data(), msg_digest.size())
+      .Finalize((unsigned char*) &authenticator[replica_id * MAC_SIZE]);
+  }
+
+  BOOST_LOG_TRIVIAL(trace) << str(
+    boost::format("R%1% NativeWallet authenticating message with digest = %2%.")
+      % m_conf.id()
+      % msg_digest
+  );
+  message.set_signature(EncodeBase64(authenticator));
+}
+
+bool NativeWallet::VerifyAuthenticator(const Message& message) const
+{
+  bool invalid_base64 = false;
+  string authenticator = DecodeBase64(message.signature(), &invalid_base64);
+  if (invalid_base64 || authenticator.size() != m_session_keys.size() * MAC_SIZE)
+  {
+    return false;
+  }
+
+  // Only the tag of this replica can be checked, with the key it shares with the sender
+  string msg_digest = message.digest();
+  const std::array<unsigned char, 32>& session_key = m_session_keys.at(message.sender_id());
+  unsigned char expected_mac[MAC_SIZE];
+  CHMAC_SHA256(session_key.data(), session_key.size())
+    .Write((const unsigned char*) msg_digest.data(), msg_digest.size())
+    .Finalize(expected_mac);
+  unsigned char difference = 0;
+  for (size_t i = 0; i < MAC_SIZE; i++)
+  {
+    difference |= expected_mac[i] ^ (unsigned char) authenticator[m_conf.id() * MAC_SIZE + i];
+  }
+  return difference == 0;
+}
+
+}
+}
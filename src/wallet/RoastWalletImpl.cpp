@@ -3,7 +3,6 @@
 
 #include "wallet.h"
 
-#include <base58.h>
 #include <boost/format.hpp>
 #include <boost/log/trivial.hpp>
 #include <script/interpreter.h>
@@ -27,8 +26,8 @@ namespace itcoin::wallet {
     static std::string const DELIM_COMMITMENTS = "::";
 
     RoastWalletImpl::RoastWalletImpl(const itcoin::FbftConfig &conf, transport::BtcClient &bitcoind)
-        : Wallet(conf), BitcoinRpcWallet(conf, bitcoind), RoastWallet(conf),
-        m_keypair(InitializeKeyPair(conf, bitcoind)) {
+        : Wallet(conf), NativeWallet(conf, bitcoind), RoastWallet(conf),
+        m_keypair(InitializeKeyPair(conf)) {
       BOOST_LOG_TRIVIAL(debug) << boost::str(
             boost::format("R%1% RoastWalletImpl will sign using pubkey address %2%.") % m_conf.id() % m_pubkey_address);
 
@@ -41,24 +40,11 @@ namespace itcoin::wallet {
           "(roast_crypto_pre_sig_aggregate(Replica_id, Pre_signature_shares, Pre_signature) :- roast_crypto_pre_sig_aggregate_impl(Replica_id, Pre_signature_shares, Pre_signature))")));
     }
 
-    secp256k1_frost_keypair *RoastWalletImpl::InitializeKeyPair(const itcoin::FbftConfig &conf, transport::BtcClient &bitcoind) const {
-      auto pubkey_address = conf.replica_set_v().at(conf.id()).p2pkh();
-      std::string b58_privkey = bitcoind.dumpprivkey(pubkey_address);
-      std::vector<unsigned char> raw_privkey;
-      // private key is coded as base58check({90|ef} || privateKey)
-      bool decoded = DecodeBase58Check(b58_privkey, raw_privkey, 256 + 8);
-      if (!decoded) {
-        std::string error = "Error parsing private key: " + b58_privkey;
-        BOOST_LOG_TRIVIAL(error) << error;
-        throw std::runtime_error(error);
-      }
-      // remove first byte that encodes if the private key is for main-net (90) or testnet (ef)
-      raw_privkey.erase(raw_privkey.begin(), raw_privkey.begin() + 1);
-
+    secp256k1_frost_keypair *RoastWalletImpl::InitializeKeyPair(const itcoin::FbftConfig &conf) const {
+      // The private key has already been read from bitcoind by the NativeWallet
       secp256k1_frost_keypair *kp;
       kp = (secp256k1_frost_keypair*) malloc(sizeof(secp256k1_frost_keypair));
-      memcpy(kp->secret, raw_privkey.data(), 32);
-      BOOST_LOG_TRIVIAL(debug) << "Private key correctly parsed!";
+      memcpy(kp->secret, m_private_key.data(), 32);
 
       {
         unsigned char raw_pubkey[33] = {0};
@@ -0,0 +1,92 @@
+// Copyright (c) 2023 Bank of Italy
+// Distributed under the GNU AGPLv3 software license, see the accompanying COPYING file.
+
+#include "wallet.h"
+
+#include "../fbft/messages/messages.h"
+
+using namespace std;
+using Message = itcoin::fbft::messages::Message;
+
+namespace itcoin {
+namespace wallet {
+
+VerificationCache::VerificationCache(size_t capacity):
+m_capacity(capacity), m_collected_height(0), m_size(0), m_hits(0), m_misses(0), m_evictions(0)
+{
+}
+
+VerificationCacheMetrics VerificationCache::metrics() const
+{
+  VerificationCacheMetrics result;
+  result.size = m_size.load();
+  result.capacity = m_capacity;
+  result.hits = m_hits.load();
+  result.misses = m_misses.load();
+  result.evictions = m_evictions.load();
+  return result;
+}
+
+VerificationCache::cache_key_t VerificationCache::BuildKey(const Message& message)
+{
+  return cache_key_t(message.sender_id(), message.digest(), message.signature());
+}
+
+bool VerificationCache::Lookup(const Message& message)
+{
+  if (m_capacity == 0)
+  {
+    return false;
+  }
+  if (m_index.find(BuildKey(message)) != m_index.end())
+  {
+    m_hits += 1;
+    return true;
+  }
+  m_misses += 1;
+  return false;
+}
+
+void VerificationCache::Insert(const Message& message)
+{
+  if (m_capacity == 0)
+  {
+    return;
+  }
+  cache_key_t key = BuildKey(message);
+  if (m_index.find(key) != m_index.end())
+  {
+    return;
+  }
+  if (m_entries.size() == m_capacity)
+  {
+    m_index.erase(m_entries.front().first);
+    m_entries.pop_front();
+    m_evictions += 1;
+  }
+  uint32_t height = message.seq_number_as_opt().value_or(m_collected_height + 1);
+  m_entries.emplace_back(key, height);
+  m_index.emplace(move(key), prev(m_entries.end()));
+  m_size = m_entries.size();
+}
+
+void VerificationCache::CollectGarbage(uint32_t height)
+{
+  m_collected_height = max(m_collected_height, height);
+  for (auto it = m_entries.begin(); it != m_entries.end();)
+  {
+    if (it->second <= m_collected_height)
+    {
+      m_index.erase(it->first);
+      it = m_entries.erase(it);
+    }
+    else
+    {
+      ++it;
+    }
+  }
+  m_size = m_entries.size();
+}
+
+}
+}
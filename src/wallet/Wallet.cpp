@@ -3,11 +3,34 @@
 
 #include "wallet.h"
 
+#include <boost/format.hpp>
+
+#include "config/FbftConfig.h"
+
+using namespace std;
+
 namespace itcoin {
 namespace wallet {
 
+SIGNATURE_SCHEME signature_scheme_from_string(const std::string& scheme_name)
+{
+  if (scheme_name == SIGNATURE_SCHEME_AS_STRING[SIGNATURE_SCHEME::ECDSA])
+  {
+    return SIGNATURE_SCHEME::ECDSA;
+  }
+  else if (scheme_name == SIGNATURE_SCHEME_AS_STRING[SIGNATURE_SCHEME::BIP340])
+  {
+    return SIGNATURE_SCHEME::BIP340;
+  }
+  string error_msg = str(
+    boost::format("Unknown signature scheme %1%")
+      % scheme_name
+  );
+  throw(std::runtime_error(error_msg));
+}
+
 Wallet::Wallet(const itcoin::FbftConfig& conf):
-m_conf(conf)
+m_conf(conf), m_signature_scheme(signature_scheme_from_string(conf.fbft_signature_scheme()))
 {
 }
 
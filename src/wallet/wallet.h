@@ -4,9 +4,24 @@
 #ifndef ITCOIN_WALLET_WALLET_H
 #define ITCOIN_WALLET_WALLET_H
 
+#include <array>
+#include <atomic>
+#include <condition_variable>
+#include <exception>
+#include <functional>
+#include <list>
+#include <map>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <thread>
+#include <tuple>
+#include <vector>
+
 #include <psbt.h>
 #include <primitives/block.h>
 #include <secp256k1/include/secp256k1.h>
+#include <secp256k1/include/secp256k1_extrakeys.h>
 #include <secp256k1/include/secp256k1_frost.h>
 
 namespace itcoin{ namespace fbft{ namespace messages {
@@ -24,17 +39,33 @@ namespace itcoin { namespace transport {
 namespace itcoin {
 namespace wallet {
 
+// The signatures of the messages exchanged by the replicas
+enum SIGNATURE_SCHEME : unsigned int {
+  // Compact recoverable ECDSA signatures, as produced by signmessage
+  ECDSA = 0,
+  // BIP340 Schnorr signatures, the VIEW_CHANGEs in a NEW_VIEW are signed and verified along with it
+  BIP340 = 1,
+};
+
+const std::string SIGNATURE_SCHEME_AS_STRING[] = { "ecdsa", "bip340" };
+
+SIGNATURE_SCHEME signature_scheme_from_string(const std::string& scheme_name);
+
 class Wallet
 {
   public:
     Wallet(const itcoin::FbftConfig& conf);
 
+    // Getters
+    SIGNATURE_SCHEME signature_scheme() const { return m_signature_scheme; }
+
     // These methods are used to sign and verify the signatures on the messages
     virtual void AppendSignature(itcoin::fbft::messages::Message& message) const = 0;
     virtual bool VerifySignature(const itcoin::fbft::messages::Message& message) const = 0;
 
   protected:
     const itcoin::FbftConfig& m_conf;
+    const SIGNATURE_SCHEME m_signature_scheme;
 };
 
 class RoastWallet : virtual public Wallet
@@ -60,7 +91,163 @@ class BitcoinRpcWallet: virtual public Wallet
     std::string m_pubkey_address;
 };
 
-class RoastWalletImpl: public BitcoinRpcWallet, public RoastWallet
+// Signs and verifies the messages in-process with libsecp256k1, instead of a signmessage or verifymessage
+// call to bitcoind for each message. With the ECDSA scheme, the signatures are the compact recoverable ECDSA
+// signatures produced by signmessage, so that a BitcoinRpcWallet verifies them and vice versa. With the BIP340
+// scheme, they are Schnorr signatures of the tagged hash of the digest, by the same keys. The private key is
+// read from bitcoind once, the public keys of the replicas are loaded from the configuration.
+// With fbft_mac_authenticators, the PRE_PREPAREs, PREPAREs and COMMITs carry a PBFT authenticator instead, i.e.
+// the HMAC-SHA256 of the digest under the session key of each recipient, in order of replica id. The session
+// key of two replicas is derived by ECDH from the private key of one and the public key of the other.
+class NativeWallet: virtual public Wallet
+{
+  public:
+    NativeWallet(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind);
+    NativeWallet(const itcoin::FbftConfig& conf, const std::vector<unsigned char>& private_key);
+    // The i-th public key is the hex of the compressed public key of replica i
+    NativeWallet(const itcoin::FbftConfig& conf, const std::vector<unsigned char>& private_key,
+      const std::vector<std::string>& pubkeys);
+    NativeWallet(const NativeWallet&) = delete;
+    ~NativeWallet();
+
+    void AppendSignature(itcoin::fbft::messages::Message& message) const;
+    bool VerifySignature(const itcoin::fbft::messages::Message& message) const;
+
+  protected:
+    // Returns the 32 bytes private key of the replica, as stored in the bitcoind wallet
+    static std::vector<unsigned char> DumpPrivateKey(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind);
+
+    std::string m_pubkey_address;
+    std::vector<unsigned char> m_private_key;
+
+  private:
+    void AppendEcdsaSignature(itcoin::fbft::messages::Message& message) const;
+    bool VerifyEcdsaSignature(const itcoin::fbft::messages::Message& message) const;
+    void AppendSchnorrSignature(itcoin::fbft::messages::Message& message) const;
+    bool VerifySchnorrSignature(const itcoin::fbft::messages::Message& message) const;
+    void AppendAuthenticator(itcoin::fbft::messages::Message& message) const;
+    bool VerifyAuthenticator(const itcoin::fbft::messages::Message& message) const;
+    // Whether the message carries an authenticator rather than a signature
+    bool IsAuthenticated(const itcoin::fbft::messages::Message& message) const;
+
+    secp256k1_context* m_ctx;
+    // The compressed public keys of the replicas, by replica id
+    std::vector<std::vector<unsigned char>> m_pubkeys;
+    // The same keys, parsed once for the Schnorr signatures
+    secp256k1_keypair m_keypair;
+    std::vector<secp256k1_xonly_pubkey> m_xonly_pubkeys;
+    // The keys shared with each replica, by replica id
+    std::vector<std::array<unsigned char, 32>> m_session_keys;
+};
+
+// A copy of the counters of a VerificationCache, see VerificationCache::metrics()
+struct VerificationCacheMetrics {
+  size_t size = 0;
+  size_t capacity = 0;
+  uint64_t hits = 0;
+  uint64_t misses = 0;
+  uint64_t evictions = 0;
+};
+
+// Remembers the messages whose signature is valid, by (sender, digest, signature), so that a message received
+// again, e.g. retransmitted, is not verified twice. Invalid signatures are not remembered, so that forged messages
+// cannot evict the valid ones beyond their own number. Once the capacity is reached, the oldest entry is evicted.
+// The entries are read and written by the consensus thread, the counters may be read from any thread.
+class VerificationCache
+{
+  public:
+    // With capacity 0, nothing is remembered
+    VerificationCache(size_t capacity);
+
+    // Getters
+    VerificationCacheMetrics metrics() const;
+
+    // Operations
+    // Returns whether the signature of the message is known to be valid, the digest must be already computed
+    bool Lookup(const itcoin::fbft::messages::Message& message);
+    // Remembers that the signature of the message is valid
+    void Insert(const itcoin::fbft::messages::Message& message);
+    // Forgets the messages up to the given height, as the engine does upon receipt of a block.
+    // The messages without a height, e.g. VIEW_CHANGEs, belong to the height that was current when they were verified.
+    void CollectGarbage(uint32_t height);
+
+  private:
+    typedef std::tuple<uint32_t, std::string, std::string> cache_key_t;
+    typedef std::list<std::pair<cache_key_t, uint32_t>> cache_entries_t;
+
+    static cache_key_t BuildKey(const itcoin::fbft::messages::Message& message);
+
+    const size_t m_capacity;
+    // The height up to which the messages have been collected
+    uint32_t m_collected_height;
+
+    // The remembered keys with their height, in order of insertion, and indexed by key
+    cache_entries_t m_entries;
+    std::map<cache_key_t, cache_entries_t::iterator> m_index;
+
+    std::atomic<size_t> m_size;
+    std::atomic<uint64_t> m_hits;
+    std::atomic<uint64_t> m_misses;
+    std::atomic<uint64_t> m_evictions;
+};
+
+// Verifies and signs batches of messages on a pool of worker threads, the calling thread works on the batch too.
+// The digests are computed by the calling thread beforehand, since they may need the replica engine,
+// hence the workers only call the wallet, whose AppendSignature and VerifySignature must be thread safe.
+class CryptoPool
+{
+  public:
+    // With 0 threads, the calling thread verifies and signs the messages one at a time.
+    // The messages found in the verification cache are not verified again.
+    CryptoPool(const Wallet& wallet, uint32_t num_threads, size_t verification_cache_size);
+    CryptoPool(const CryptoPool&) = delete;
+    ~CryptoPool();
+
+    // Getters
+    uint32_t num_threads() const { return m_workers.size(); }
+    // Not synchronized with VerifyAll, use it from the thread that verifies
+    VerificationCache& verification_cache() { return m_verification_cache; }
+    const VerificationCache& verification_cache() const { return m_verification_cache; }
+
+    // Operations
+    // VerifyAll and SignAll can be called from several threads, the batches are run one at a time.
+    // They are not reentrant: the wallet must not call back into the pool while verifying or signing.
+    // Returns whether the signatures of each message are valid, in the same order as msgs.
+    // The signatures of the whole batch, including the embedded ones, are verified as a single set of tasks.
+    std::vector<bool> VerifyAll(const std::vector<std::shared_ptr<const itcoin::fbft::messages::Message>>& msgs);
+    // Signs each message, rethrows the first error after the whole batch has been processed
+    void SignAll(std::vector<std::unique_ptr<itcoin::fbft::messages::Message>>& msgs);
+
+  private:
+    // The messages whose signature makes up the one of msg, i.e. msg itself and, with the BIP340 scheme,
+    // the VIEW_CHANGEs in a NEW_VIEW
+    std::vector<const itcoin::fbft::messages::Message*> SignedParts(const itcoin::fbft::messages::Message& msg) const;
+    // Calls task(i) for each i < num_tasks, and returns once all the calls have returned.
+    // The caller holds m_batch_mutex.
+    void ParallelFor(size_t num_tasks, const std::function<void(size_t)>& task);
+    void RunTasks(const std::function<void(size_t)>& task, size_t num_tasks);
+    void WorkerLoop();
+
+    const Wallet& m_wallet;
+    VerificationCache m_verification_cache;
+    std::vector<std::thread> m_workers;
+
+    // Held by VerifyAll and SignAll for the whole batch, there is a single current batch
+    std::mutex m_batch_mutex;
+    // The current batch, workers join it under the mutex and pick the tasks through m_next_task
+    std::mutex m_mutex;
+    std::condition_variable m_batch_cv;
+    std::condition_variable m_done_cv;
+    const std::function<void(size_t)>* m_task;
+    size_t m_num_tasks;
+    uint64_t m_batch_id;
+    uint32_t m_busy_workers;
+    bool m_stopping;
+    std::atomic<size_t> m_next_task;
+    std::atomic<size_t> m_done_tasks;
+};
+
+class RoastWalletImpl: public NativeWallet, public RoastWallet
 {
   public:
     RoastWalletImpl(const itcoin::FbftConfig& conf, transport::BtcClient& bitcoind);
@@ -71,7 +258,7 @@ class RoastWalletImpl: public BitcoinRpcWallet, public RoastWallet
     std::string GetSignatureShare(std::vector<uint32_t> signers, std::string pre_signature, const CBlock& block) override;
 
   private:
-    secp256k1_frost_keypair *InitializeKeyPair(const itcoin::FbftConfig &conf, transport::BtcClient &bitcoind) const;
+    secp256k1_frost_keypair *InitializeKeyPair(const itcoin::FbftConfig &conf) const;
     std::vector<std::string> SplitPreSignatures(std::string serializedList) const;
     void AggregateSignatureShares(unsigned char *signature64,
                                                    const unsigned char *message32,